@@ -0,0 +1,674 @@
+/**********************************************************//**
+ * @file benchmark.c
+ * @brief Headless benchmarks of the CREATURE simulation.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdio.h>          // printf
+#include <stdlib.h>         // malloc, atoi
+#include <string.h>         // memcpy, strcmp
+#include <time.h>           // clock_gettime
+#include <unistd.h>         // getopt
+#include <math.h>           // fabs, isfinite
+
+// This project
+#include "debug.h"          // eprintf
+#include "rng.h"            // RNG
+#include "genome.h"         // GENOME
+#include "creature.h"       // CREATURE
+#include "fitness.h"        // fitness_Walk, fitness_Statistics
+#include "muscle.h"         // muscle_Forces
+#include "genetic.h"        // GENETIC, SELECTION
+
+//**************************************************************
+#define DEFAULT_CREATURES 1024  ///< Creatures evaluated per repeat.
+#define DEFAULT_REPEATS 3       ///< Timings to take the best of.
+#define KERNEL_CALLS 2000       ///< Force computations per creature.
+#define SELECTION_ENTITIES (1 << 20)    ///< Population the selection is timed on.
+#define SELECTION_GENERATIONS 10        ///< Generations timed per strategy.
+
+/**********************************************************//**
+ * @struct BENCHMARK
+ * @brief Stores the random creatures shared by every run of
+ * a benchmark.
+ **************************************************************/
+typedef struct {
+    int nCreatures;         ///< The number of creatures.
+    int nRepeats;           ///< Timings to take the best of.
+    CREATURE *original;     ///< The creatures as generated.
+    CREATURE *creatures;    ///< Working copies of the creatures.
+    CREATURE **pointers;    ///< Pointers to the working copies.
+} BENCHMARK;
+
+/**********************************************************//**
+ * @brief Gets the current time.
+ * @return Seconds since some fixed point.
+ **************************************************************/
+static inline double Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+/**********************************************************//**
+ * @brief Restores the working copies to the creatures as
+ * generated, reset and ready to evaluate.
+ * @param bench: The benchmark to reset.
+ **************************************************************/
+static void Restore(BENCHMARK *bench) {
+    memcpy(bench->creatures, bench->original, sizeof(CREATURE)*bench->nCreatures);
+    for (int i = 0; i < bench->nCreatures; i++) {
+        creature_Reset(&bench->creatures[i]);
+    }
+}
+
+/**********************************************************//**
+ * @brief Times fitness_Walk on every creature one at a time.
+ * @param bench: The creatures to evaluate.
+ * @param fitness: Location to store the fitness of each one.
+ * @return The fastest time taken in seconds.
+ **************************************************************/
+static double TimeScalar(BENCHMARK *bench, float *fitness) {
+    double best = INFINITY;
+    for (int r = 0; r < bench->nRepeats; r++) {
+        Restore(bench);
+        double start = Now();
+        for (int i = 0; i < bench->nCreatures; i++) {
+            fitness[i] = fitness_Walk(&bench->creatures[i]);
+        }
+        double elapsed = Now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**********************************************************//**
+ * @brief Times fitness_WalkBatch on all the creatures.
+ * @param bench: The creatures to evaluate.
+ * @param fitness: Location to store the fitness of each one.
+ * @return The fastest time taken in seconds.
+ **************************************************************/
+static double TimeLockstep(BENCHMARK *bench, float *fitness) {
+    double best = INFINITY;
+    for (int r = 0; r < bench->nRepeats; r++) {
+        Restore(bench);
+        double start = Now();
+        fitness_WalkBatch(bench->pointers, bench->nCreatures, fitness);
+        double elapsed = Now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**********************************************************//**
+ * @brief Prints the throughput of one timed run.
+ * @param name: What was timed.
+ * @param bench: The creatures that were evaluated.
+ * @param seconds: The time taken.
+ **************************************************************/
+static void PrintRate(const char *name, const BENCHMARK *bench, double seconds) {
+    // Creature-steps assume no creature runs out of energy
+    double steps = (double)bench->nCreatures*FITNESS_TRIALS*(BEHAVIOR_TIME / TIME_STEP);
+    printf("%-12s %8.3f s %12.0f creatures/s %14.0f creature-steps/s\n",
+        name, seconds, bench->nCreatures / seconds, steps / seconds);
+}
+
+/**********************************************************//**
+ * @brief Compares the lockstep simulator with the scalar one.
+ * @param bench: The creatures to evaluate.
+ * @return Whether every fitness matched exactly.
+ **************************************************************/
+static bool Lockstep(BENCHMARK *bench) {
+    float *scalar = malloc(sizeof(float)*bench->nCreatures);
+    float *lockstep = malloc(sizeof(float)*bench->nCreatures);
+    if (!scalar || !lockstep) {
+        eprintf("Failed to allocate fitness.\n");
+        free(scalar);
+        free(lockstep);
+        return false;
+    }
+    fitness_ResetStatistics();
+    double scalarTime = TimeScalar(bench, scalar);
+    FITNESS_STATISTICS trials;
+    fitness_Statistics(&trials);
+    double lockstepTime = TimeLockstep(bench, lockstep);
+    
+    // The lockstep simulator is meant to be exact
+    int nExact = 0;
+    double maxError = 0.0;
+    for (int i = 0; i < bench->nCreatures; i++) {
+        if (!memcmp(&scalar[i], &lockstep[i], sizeof(float))) {
+            nExact++;
+        }
+        double error = fabs(scalar[i] - lockstep[i]);
+        if (error > maxError) {
+            maxError = error;
+        }
+    }
+    PrintRate("scalar", bench, scalarTime);
+    PrintRate("lockstep", bench, lockstepTime);
+    printf("Speedup %0.2fx, %d of %d identical, max error %g\n",
+        scalarTime / lockstepTime, nExact, bench->nCreatures, maxError);
+    printf("Skipped %ld of %ld trials of settled creatures, %ld steps saved\n",
+        trials.skipped / bench->nRepeats, (trials.trials + trials.skipped) / bench->nRepeats,
+        trials.stepsSaved / bench->nRepeats);
+    free(scalar);
+    free(lockstep);
+    return nExact == bench->nCreatures;
+}
+
+/**********************************************************//**
+ * @brief Times one muscle kernel on its own, computing the
+ * forces of every creature many times over.
+ * @param bench: The creatures to use, in motion.
+ * @return The fastest time taken in seconds.
+ **************************************************************/
+static double TimeKernel(const BENCHMARK *bench) {
+    MUSCLE_FORCES forces;
+    double best = INFINITY;
+    for (int r = 0; r < bench->nRepeats; r++) {
+        double start = Now();
+        for (int i = 0; i < bench->nCreatures; i++) {
+            const CREATURE *creature = &bench->creatures[i];
+            for (int j = 0; j < KERNEL_CALLS; j++) {
+                muscle_Forces(creature->nodes, creature->muscles, creature->nMuscles, &forces);
+            }
+        }
+        double elapsed = Now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**********************************************************//**
+ * @brief Compares every muscle kernel the CPU supports with
+ * the scalar one, both on its own and within fitness_Walk.
+ * @param bench: The creatures to evaluate.
+ * @return Whether every kernel matched exactly.
+ **************************************************************/
+static bool Muscles(BENCHMARK *bench) {
+    float *reference = malloc(sizeof(float)*bench->nCreatures);
+    float *fitness = malloc(sizeof(float)*bench->nCreatures);
+    if (!reference || !fitness) {
+        eprintf("Failed to allocate fitness.\n");
+        free(reference);
+        free(fitness);
+        return false;
+    }
+    
+    // Count every muscle the kernel timing computes
+    double muscles = 0.0;
+    for (int i = 0; i < bench->nCreatures; i++) {
+        muscles += (double)bench->original[i].nMuscles*KERNEL_CALLS;
+    }
+    
+    bool success = true;
+    MUSCLE_KERNEL automatic = muscle_Selected();
+    double scalarKernel = 0.0;
+    double scalarWalk = 0.0;
+    for (int kernel = KERNEL_SCALAR; kernel < N_KERNELS; kernel++) {
+        if (!muscle_Select(kernel)) {
+            printf("%-8s unsupported\n", muscle_KernelName(kernel));
+            continue;
+        }
+        
+        // The whole walk must not change at all
+        double walk = TimeScalar(bench, (kernel == KERNEL_SCALAR)? reference: fitness);
+        int nExact = bench->nCreatures;
+        if (kernel != KERNEL_SCALAR) {
+            nExact = 0;
+            for (int i = 0; i < bench->nCreatures; i++) {
+                if (!memcmp(&reference[i], &fitness[i], sizeof(float))) {
+                    nExact++;
+                }
+            }
+        }
+        
+        // Time the kernel on the creatures as the walk left them
+        double time = TimeKernel(bench);
+        if (kernel == KERNEL_SCALAR) {
+            scalarKernel = time;
+            scalarWalk = walk;
+        }
+        printf("%-8s %12.0f muscles/s %6.2fx kernel %6.2fx walk, %d of %d identical%s\n",
+            muscle_KernelName(kernel), muscles / time, scalarKernel / time, scalarWalk / walk,
+            nExact, bench->nCreatures, (kernel == (int)automatic)? " (selected)": "");
+        success = success && (nExact == bench->nCreatures);
+    }
+    muscle_Select(automatic);
+    free(reference);
+    free(fitness);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Times fitness_Walk with every integrator, and checks
+ * the inlined midpoint method against the same method called
+ * through a function pointer.
+ * @param bench: The creatures to evaluate.
+ * @return Whether the two midpoint methods matched exactly.
+ **************************************************************/
+static bool Integrators(BENCHMARK *bench) {
+    float *pointer = malloc(sizeof(float)*bench->nCreatures);
+    float *fitness = malloc(sizeof(float)*bench->nCreatures);
+    if (!pointer || !fitness) {
+        eprintf("Failed to allocate fitness.\n");
+        free(pointer);
+        free(fitness);
+        return false;
+    }
+    
+    // Everything is compared with the function pointer
+    INTEGRATOR selected = creature_Integrator();
+    creature_SetIntegrator(INTEGRATOR_POINTER);
+    double pointerTime = TimeScalar(bench, pointer);
+    PrintRate(creature_IntegratorName(INTEGRATOR_POINTER), bench, pointerTime);
+    
+    bool success = true;
+    for (int integrator = 0; integrator < N_INTEGRATORS; integrator++) {
+        if (integrator == INTEGRATOR_POINTER) {
+            continue;
+        }
+        creature_SetIntegrator(integrator);
+        double time = TimeScalar(bench, fitness);
+        PrintRate(creature_IntegratorName(integrator), bench, time);
+        
+        // Only the midpoint method should match exactly
+        int nExact = 0;
+        for (int i = 0; i < bench->nCreatures; i++) {
+            if (!memcmp(&pointer[i], &fitness[i], sizeof(float))) {
+                nExact++;
+            }
+        }
+        printf("%12s %0.2fx the pointer, %d of %d identical\n",
+            "", pointerTime / time, nExact, bench->nCreatures);
+        if (integrator == INTEGRATOR_MIDPOINT) {
+            success = (nExact == bench->nCreatures);
+        }
+    }
+    creature_SetIntegrator(selected);
+    free(pointer);
+    free(fitness);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Measures how far the fitness drifts from the
+ * explicit reference, the midpoint method at TIME_STEP, as the
+ * time step grows, with both the implicit integrator and the
+ * midpoint method. Unstable runs show up as non-finite fitness.
+ * @param bench: The creatures to evaluate.
+ * @return Whether the implicit integrator stayed finite.
+ **************************************************************/
+static bool Drift(BENCHMARK *bench) {
+    static const double multiples[] = {1.0, 2.0, 3.0, 4.0, 10.0};
+    static const INTEGRATOR integrators[] = {INTEGRATOR_IMPLICIT, INTEGRATOR_MIDPOINT};
+    float *reference = malloc(sizeof(float)*bench->nCreatures);
+    float *fitness = malloc(sizeof(float)*bench->nCreatures);
+    if (!reference || !fitness) {
+        eprintf("Failed to allocate fitness.\n");
+        free(reference);
+        free(fitness);
+        return false;
+    }
+    INTEGRATOR integrator = creature_Integrator();
+    double step = creature_TimeStep();
+    creature_SetIntegrator(INTEGRATOR_MIDPOINT);
+    creature_SetTimeStep(TIME_STEP);
+    double referenceTime = TimeScalar(bench, reference);
+    printf("reference    %8.3f s\n", referenceTime);
+    
+    bool success = true;
+    for (int i = 0; i < (int)(sizeof(integrators)/sizeof(integrators[0])); i++) {
+        for (int j = 0; j < (int)(sizeof(multiples)/sizeof(multiples[0])); j++) {
+            creature_SetIntegrator(integrators[i]);
+            creature_SetTimeStep(multiples[j]*TIME_STEP);
+            double time = TimeScalar(bench, fitness);
+            
+            // Drift of the finite results, relative to the
+            // spread of the reference fitness
+            int nFinite = 0;
+            double drift = 0.0;
+            double maxDrift = 0.0;
+            double spread = 0.0;
+            for (int k = 0; k < bench->nCreatures; k++) {
+                spread += fabs(reference[k]);
+                if (!isfinite(fitness[k]) || fabs(fitness[k]) > 1e6) {
+                    continue;
+                }
+                double error = fabs(fitness[k] - reference[k]);
+                drift += error;
+                if (error > maxDrift) {
+                    maxDrift = error;
+                }
+                nFinite++;
+            }
+            spread /= bench->nCreatures;
+            drift /= (nFinite > 0)? nFinite: 1;
+            printf("%-8s %4.1fx %8.3f s %5.2fx, %4d of %d stable, drift %0.4f (%0.1f%%), max %0.4f\n",
+                creature_IntegratorName(integrators[i]), multiples[j], time, referenceTime / time,
+                nFinite, bench->nCreatures, drift, 100.0*drift/spread, maxDrift);
+            if (integrators[i] == INTEGRATOR_IMPLICIT && nFinite < bench->nCreatures) {
+                success = false;
+            }
+        }
+    }
+    creature_SetIntegrator(integrator);
+    creature_SetTimeStep(step);
+    free(reference);
+    free(fitness);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Compares the steps and force evaluations of the
+ * adaptive integrator with the fixed-step midpoint method, and
+ * how far each drifts from the midpoint method at TIME_STEP.
+ * The midpoint method at half the step shows how much of the
+ * drift is the reference's own truncation error.
+ * @param bench: The creatures to evaluate.
+ * @return Whether the adaptive results were all finite.
+ **************************************************************/
+static bool Adaptive(BENCHMARK *bench) {
+    static const INTEGRATOR integrators[] = {INTEGRATOR_MIDPOINT, INTEGRATOR_MIDPOINT, INTEGRATOR_ADAPTIVE};
+    static const double steps[] = {TIME_STEP, TIME_STEP/2, TIME_STEP};
+    float *reference = malloc(sizeof(float)*bench->nCreatures);
+    float *fitness = malloc(sizeof(float)*bench->nCreatures);
+    if (!reference || !fitness) {
+        eprintf("Failed to allocate fitness.\n");
+        free(reference);
+        free(fitness);
+        return false;
+    }
+    INTEGRATOR integrator = creature_Integrator();
+    double step = creature_TimeStep();
+    
+    bool success = true;
+    for (int i = 0; i < (int)(sizeof(integrators)/sizeof(integrators[0])); i++) {
+        creature_SetIntegrator(integrators[i]);
+        creature_SetTimeStep(steps[i]);
+        creature_ResetStatistics();
+        double time = TimeScalar(bench, (i == 0)? reference: fitness);
+        STEP_STATISTICS stats;
+        creature_Statistics(&stats);
+        printf("%-8s %0.4f s %8.3f s, %9ld steps, %9ld rejected, %9ld evaluations\n",
+            creature_IntegratorName(integrators[i]), steps[i], time, stats.steps / bench->nRepeats,
+            stats.rejected / bench->nRepeats, stats.evaluations / bench->nRepeats);
+        if (i == 0) {
+            continue;
+        }
+        
+        // Drift relative to the spread of the reference
+        int nFinite = 0;
+        double drift = 0.0;
+        double maxDrift = 0.0;
+        double spread = 0.0;
+        for (int k = 0; k < bench->nCreatures; k++) {
+            spread += fabs(reference[k]);
+            if (!isfinite(fitness[k])) {
+                continue;
+            }
+            double error = fabs(fitness[k] - reference[k]);
+            drift += error;
+            if (error > maxDrift) {
+                maxDrift = error;
+            }
+            nFinite++;
+        }
+        spread /= bench->nCreatures;
+        drift /= (nFinite > 0)? nFinite: 1;
+        printf("%19s %0.2fx the fixed steps, %4d of %d finite, drift %0.4f (%0.1f%%), max %0.4f\n",
+            "", (double)stats.steps / stats.baseline, nFinite, bench->nCreatures,
+            drift, 100.0*drift/spread, maxDrift);
+        if (nFinite < bench->nCreatures) {
+            success = false;
+        }
+    }
+    creature_SetIntegrator(integrator);
+    creature_SetTimeStep(step);
+    free(reference);
+    free(fitness);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Measures how far extrapolating repeating gaits moves
+ * the fitness away from simulating every trial, at several
+ * cycle tolerances, and checks the lockstep walk still matches.
+ * @param bench: The creatures to evaluate.
+ * @return Whether the lockstep walk matched at every tolerance.
+ **************************************************************/
+static bool Cycles(BENCHMARK *bench) {
+    static const double tolerances[] = {0.5, 0.2, 0.1, 0.05, 0.01, 0.001};
+    float *reference = malloc(sizeof(float)*bench->nCreatures);
+    float *fitness = malloc(sizeof(float)*bench->nCreatures);
+    float *lockstep = malloc(sizeof(float)*bench->nCreatures);
+    if (!reference || !fitness || !lockstep) {
+        eprintf("Failed to allocate fitness.\n");
+        free(reference);
+        free(fitness);
+        free(lockstep);
+        return false;
+    }
+    double tolerance = fitness_CycleTolerance();
+    fitness_SetCycleTolerance(0.0);
+    double referenceTime = TimeScalar(bench, reference);
+    printf("every trial %8.3f s\n", referenceTime);
+    
+    bool success = true;
+    for (int i = 0; i < (int)(sizeof(tolerances)/sizeof(tolerances[0])); i++) {
+        fitness_SetCycleTolerance(tolerances[i]);
+        fitness_ResetStatistics();
+        double time = TimeScalar(bench, fitness);
+        FITNESS_STATISTICS trials;
+        fitness_Statistics(&trials);
+        TimeLockstep(bench, lockstep);
+        
+        // Error relative to the spread of the reference fitness
+        int nExact = 0;
+        int nMatched = 0;
+        double error = 0.0;
+        double maxError = 0.0;
+        double spread = 0.0;
+        int nFinite = 0;
+        for (int k = 0; k < bench->nCreatures; k++) {
+            nExact += !memcmp(&fitness[k], &reference[k], sizeof(float));
+            nMatched += !memcmp(&fitness[k], &lockstep[k], sizeof(float));
+            if (!isfinite(reference[k])) {
+                continue;
+            }
+            double difference = fabs(fitness[k] - reference[k]);
+            spread += fabs(reference[k]);
+            error += difference;
+            if (difference > maxError) {
+                maxError = difference;
+            }
+            nFinite++;
+        }
+        spread /= (nFinite > 0)? nFinite: 1;
+        error /= (nFinite > 0)? nFinite: 1;
+        printf("tolerance %-6g %8.3f s %5.2fx, %ld of %ld trials extrapolated, ",
+            tolerances[i], time, referenceTime / time, trials.extrapolated / bench->nRepeats,
+            (trials.trials + trials.skipped + trials.extrapolated) / bench->nRepeats);
+        printf("error %0.5f (%0.2f%%), max %0.5f, %d exact, lockstep %d of %d identical\n",
+            error, 100.0*error/spread, maxError, nExact, nMatched, bench->nCreatures);
+        if (nMatched < bench->nCreatures) {
+            success = false;
+        }
+    }
+    fitness_SetCycleTolerance(tolerance);
+    free(reference);
+    free(fitness);
+    free(lockstep);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Generates a random number for the selection benchmark.
+ * @param entity: Location to store the number.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void RandomNumber(void *entity, RNG *rng) {
+    *(float *)entity = rng_Uniform(rng, -1.0, 1.0);
+}
+
+/**********************************************************//**
+ * @brief Breeds two numbers into two numbers between them.
+ * @param mother, father: The parents.
+ * @param son, daughter: Locations to store the children.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void BreedNumbers(const void *mother, const void *father, void *son, void *daughter, RNG *rng) {
+    float a = *(const float *)mother;
+    float b = *(const float *)father;
+    float t = rng_Uniform(rng, 0.0, 1.0);
+    *(float *)son = a + t*(b - a);
+    *(float *)daughter = b + t*(a - b);
+}
+
+/**********************************************************//**
+ * @brief Gets the fitness of a number, which is best near 0.
+ * @param entity: The number.
+ * @return Its square.
+ **************************************************************/
+static float NumberFitness(void *entity) {
+    float x = *(float *)entity;
+    return x*x;
+}
+
+/**********************************************************//**
+ * @brief Times a generation of each selection strategy on a
+ * population so large that selection dominates, since the
+ * entities are single numbers and cost nothing to evaluate.
+ * @param seed: The seed of the population.
+ * @return Whether every strategy ran.
+ **************************************************************/
+static bool Selection(int seed) {
+    GENETIC_REQUEST request = {
+        .entitySize = sizeof(float),
+        .populationSize = SELECTION_ENTITIES,
+        .nThreads = 1,
+        .seed = seed,
+        .random = &RandomNumber,
+        .breed = &BreedNumbers,
+        .fitness = &NumberFitness,
+    };
+    printf("%d entities, %d generations\n", SELECTION_ENTITIES, SELECTION_GENERATIONS);
+    for (int i = 0; i < N_SELECTIONS; i++) {
+        request.selection = (SELECTION)i;
+        GENETIC data;
+        if (!genetic_Create(&data, &request)) {
+            return false;
+        }
+        double start = Now();
+        for (int g = 0; g < SELECTION_GENERATIONS; g++) {
+            genetic_Generation(&data);
+        }
+        double time = (Now() - start) / SELECTION_GENERATIONS;
+        printf("%-10s %8.2f ms per generation, %d elites, best %g\n",
+            genetic_SelectionName(request.selection), 1000.0*time,
+            data.elitism, genetic_BestFitness(&data));
+        genetic_Destroy(&data);
+    }
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Benchmark driver function.
+ * @param argc: Number of command-line arguments.
+ * @param argv: Values for command line arguments.
+ * @return Exit code, nonzero if a benchmark failed.
+ **************************************************************/
+int main(int argc, char **argv) {
+    BENCHMARK bench = {
+        .nCreatures = DEFAULT_CREATURES,
+        .nRepeats = DEFAULT_REPEATS,
+    };
+    int seed = 0;
+    
+    // Option reading
+    int option;
+    while ((option = getopt(argc, argv, "n:s:r:")) != -1) {
+        switch (option) {
+        case 'n':
+            // Number of creatures
+            bench.nCreatures = atoi(optarg);
+            break;
+        
+        case 's':
+            // Seed of the random creatures
+            seed = atoi(optarg);
+            break;
+        
+        case 'r':
+            // Timings to take the best of
+            bench.nRepeats = atoi(optarg);
+            break;
+        
+        default:
+            printf("Usage: %s [-n creatures] [-s seed] [-r repeats] ", argv[0]);
+            printf("[lockstep | muscles | integrators | drift | adaptive | cycles | selection]\n");
+            exit(-1);
+        }
+    }
+    if (bench.nCreatures < 1 || bench.nRepeats < 1) {
+        printf("Error: Need at least one creature and repeat.\n");
+        exit(-1);
+    }
+    const char *mode = (optind < argc)? argv[optind]: "lockstep";
+    
+    // Generate the creatures the same way evolution does
+    bench.original = malloc(sizeof(CREATURE)*bench.nCreatures);
+    bench.creatures = malloc(sizeof(CREATURE)*bench.nCreatures);
+    bench.pointers = malloc(sizeof(CREATURE *)*bench.nCreatures);
+    if (!bench.original || !bench.creatures || !bench.pointers) {
+        eprintf("Failed to allocate creatures.\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < bench.nCreatures; i++) {
+        RNG rng;
+        GENOME genome;
+        rng_Derive(&rng, seed, 0, i);
+        genome_CreateRandom(&genome, &rng);
+        creature_Create(&bench.original[i], &genome);
+        bench.pointers[i] = &bench.creatures[i];
+    }
+    printf("%d creatures, seed %d, best of %d\n", bench.nCreatures, seed, bench.nRepeats);
+    
+    // Mode
+    bool success;
+    if (!strcmp(mode, "lockstep")) {
+        success = Lockstep(&bench);
+    } else if (!strcmp(mode, "muscles")) {
+        success = Muscles(&bench);
+    } else if (!strcmp(mode, "integrators")) {
+        success = Integrators(&bench);
+    } else if (!strcmp(mode, "drift")) {
+        success = Drift(&bench);
+    } else if (!strcmp(mode, "adaptive")) {
+        success = Adaptive(&bench);
+    } else if (!strcmp(mode, "cycles")) {
+        success = Cycles(&bench);
+    } else if (!strcmp(mode, "selection")) {
+        success = Selection(seed);
+    } else {
+        printf("Error: No benchmark \"%s\".\n", mode);
+        exit(-1);
+    }
+    free(bench.original);
+    free(bench.creatures);
+    free(bench.pointers);
+    return success? EXIT_SUCCESS: EXIT_FAILURE;
+}
+
+/*============================================================*/
@@ -10,6 +10,8 @@
 #include <stdbool.h>        // bool
 #include <time.h>           // time
 #include <string.h>         // strcpy, strcmp
+#include <unistd.h>         // getopt
+#include <math.h>           // INFINITY
 
 // External libraries
 #ifdef WINDOWS
@@ -21,8 +23,15 @@
 // This project
 #include "debug.h"          // eprintf, assert
 #include "frame_rate.h"     // FrameRate
+#include "pool.h"           // pool_Processors
 #include "genetic.h"        // GENETIC
+#include "island.h"         // ISLAND_REQUEST
+#include "farm.h"           // FARM
+#include "genome.h"         // GENOME, PACKED_GENOME, GENE_ARENA
 #include "creature.h"       // CREATURE
+#include "batch.h"          // BATCH_LANES
+#include "fitness.h"        // fitness_Walk, fitness_Race
+#include "cache.h"          // CACHE
 
 //**************************************************************
 #define FRUSTUM_SIZE 0.1    ///< The scale of the projection frustum.
@@ -30,7 +39,8 @@
 #define CLIP_FAR 100.0      ///< Location of the far clipping plane.
 #define WINDOW_WIDTH 800    ///< The width of the screen.
 #define WINDOW_HEIGHT 600   ///< The height of the screen.
-#define FITNESS_TRIALS 10   ///< Number of trials to evaluate fitness.
+#define LOCKSTEP_BATCH (4*BATCH_LANES)  ///< Creatures simulated together.
+#define DEFAULT_CACHE (1 << 20)         ///< Fitnesses remembered by genome.
 
 //**************************************************************
 static GENETIC Population;  ///< Genetic algorithm data.
@@ -41,6 +51,10 @@ static CREATURE Test;       ///< Test creature.
 static float CameraX;       ///< Camera X position.
 static float CameraY;       ///< Camera Y position.
 static bool Rest;           ///< Whether the creature is at rest.
+static FARM Farm;           ///< Worker processes for fitness evaluation.
+static float Cutoff;        ///< Fitness racing creatures must beat.
+static CACHE Cache;         ///< Fitness of recently evaluated genomes.
+static GENE_ARENA Genes;    ///< Node and muscle genes of the population.
 
 /// Interchangeable fitness function.
 static float (*Fitness)(CREATURE *creature);
@@ -204,9 +218,8 @@ static double timer(void) {
  * @return Whether the initialization succeeded.
  **************************************************************/
 static bool setup(int argc, char **argv) {
-    // Random number initialization
+    // Default seed, which may be overridden on the command line
     Seed = time(NULL);
-    srand(Seed);
     
     // Initialize glut window
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
@@ -251,113 +264,309 @@ static bool setup(int argc, char **argv) {
 }
 
 /**********************************************************//**
- * @brief Computes the average NODE position.
- * @param creature: The creature to inspect.
- * @return The average position of the creature's NODEs.
+ * @brief Looks for the fitness of an identical genome in the
+ * cache, memoizing it if found. Breeding often makes exact
+ * clones, which need not be simulated again.
+ * @param packed: The genome to evaluate.
+ * @return Whether the fitness was found.
  **************************************************************/
-static inline VECTOR AveragePosition(const CREATURE *creature) {
-    VECTOR total = {0.0, 0.0, 0.0};
-    for (int i = 0; i < creature->nNodes; i++) {
-        vector_Add(&total, &creature->nodes[i].position);
+static bool Recall(PACKED_GENOME *packed) {
+    float fitness;
+    if (Cache.slots && cache_Find(&Cache, genome_Hash(packed, &Genes), &fitness)) {
+        packed->fitness = fitness;
+        return true;
     }
-    vector_Multiply(&total, 1.0 / creature->nNodes);
-    return total;
+    return false;
 }
 
 /**********************************************************//**
- * @brief Models the creature walking forward using its
- * MOTION. This is repeated FITNESS_TRIALS times for
- * an averaging effect. The fitness is based on the total
- * distance travelled in the X-direction (positive), and is
- * negatively impacted by significant motion in the Y and Z
- * directions.
- * @param creature: The creature to inspect.
- * @return The fitness of the walk animation.
+ * @brief Stores a simulated fitness in the cache. A creature
+ * that lost a race may have been given a bound instead of its
+ * fitness, so raced fitness is only kept if it beat the cutoff.
+ * @param packed: The genome evaluated.
+ * @param fitness: Its fitness.
  **************************************************************/
-static float WalkFitness(CREATURE *creature) {
-    // Evaluate the creature's walking fitness. To do this we
-    // will loop the walking animation ten times
-    VECTOR start = AveragePosition(creature);
-    VECTOR end;
-    
-    // Count all positive x motions. However, penalize if there
-    // is tons of variance in the Y and Z directions: we only
-    // want to go forwards (and repeatably so).
-    float xMotionTotal = 0.0;
-    float yMotionMagnitudeTotal = 0.0;
-    float zMotionMagnitudeTotal = 0.0;
-    
-    // Do the given number of trials subsequently without
-    // resetting the creature.
-    for (int trial = 0; trial < FITNESS_TRIALS; trial++) {
-        // Perform a whole cycle of the animation
-        creature_Animate(creature, BEHAVIOR_TIME);
-        
-        // Sample the difference again
-        end = AveragePosition(creature);
-        VECTOR delta = end;
-        vector_Subtract(&delta, &start);
-        xMotionTotal += delta.x;
-        yMotionMagnitudeTotal += fabs(delta.y);
-        zMotionMagnitudeTotal += fabs(delta.z);
-        start = end;
+static void Remember(const PACKED_GENOME *packed, float fitness) {
+    if (Cache.slots && !isnan(fitness) && (Cutoff == INFINITY || fitness < Cutoff)) {
+        cache_Insert(&Cache, genome_Hash(packed, &Genes), fitness);
     }
-    
-    // Get the final fitness
-    float totalFitness = xMotionTotal - yMotionMagnitudeTotal - zMotionMagnitudeTotal;
-    return -totalFitness / FITNESS_TRIALS;
 }
 
 /**********************************************************//**
  * @brief Computes the fitness.
- * @param entity: The creature to evaluate.
+ * @param entity: The genome to evaluate.
  * @return The fitness, with smaller values being better.
  **************************************************************/
 static float EvaluateFitness(void *entity) {
-    // Creature cast
-    CREATURE *creature = (CREATURE *)entity;
-    
-    // Reset the creature for evaluation purposes, so the
-    // creature always begins at rest and there are no weird
-    // initial spasms.
-    creature_Reset(creature);
+    // Genome cast
+    PACKED_GENOME *packed = (PACKED_GENOME *)entity;
     
     // Check memoized fitness table
-    float fitness = creature->fitness;
+    float fitness = packed->fitness;
     if (fitness != FITNESS_INVALID) {
         return fitness;
     }
+    if (Recall(packed)) {
+        return packed->fitness;
+    }
+    
+    // Grow the creature in this worker's scratch space, so it
+    // always begins at rest and there are no weird initial
+    // spasms.
+    GENOME genome;
+    CREATURE creature;
+    genome_Unpack(&genome, packed, &Genes);
+    creature_Create(&creature, &genome);
     
-    // We actually need to evaluate the fitness
+    // We actually need to evaluate the fitness, racing it
+    // against the survivors if there are any to beat.
     // Store the fitness in the memo table
-    fitness = Fitness(creature);
-    creature->fitness = fitness;
+    fitness = (Cutoff < INFINITY)? fitness_Race(&creature, Cutoff): Fitness(&creature);
+    packed->fitness = fitness;
+    Remember(packed, fitness);
+    return fitness;
+}
+
+/**********************************************************//**
+ * @brief Computes a cheap estimate of the fitness, which is
+ * not memoized. A genome whose fitness is memoized skips the
+ * screen. The cache is left to the full evaluation, since what
+ * it holds depends on how the threads ran, and the screen must
+ * not.
+ * @param entity: The genome to evaluate.
+ * @param rung: The rung of the screening ladder.
+ * @return The estimated fitness, with smaller values being
+ * better, or -INFINITY if it is memoized.
+ **************************************************************/
+static float ScreenFitness(void *entity, int rung) {
+    PACKED_GENOME *packed = (PACKED_GENOME *)entity;
+    if (packed->fitness != FITNESS_INVALID) {
+        return -INFINITY;
+    }
+    GENOME genome;
+    CREATURE creature;
+    genome_Unpack(&genome, packed, &Genes);
+    creature_Create(&creature, &genome);
+    return fitness_Screen(&creature, rung);
+}
+
+/**********************************************************//**
+ * @brief Estimates the cost of evaluating the fitness.
+ * @param entity: The genome to evaluate.
+ * @return The relative cost, or zero if already memoized.
+ **************************************************************/
+static float EvaluationCost(const void *entity) {
+    const PACKED_GENOME *packed = (const PACKED_GENOME *)entity;
+    if (packed->fitness != FITNESS_INVALID) {
+        return 0.0;
+    }
+    return genome_Cost(packed);
+}
+
+/**********************************************************//**
+ * @brief Genome encoding adapter function.
+ * @param entity: The PACKED_GENOME to encode.
+ * @param buffer: Location to store the bytes.
+ * @return The number of bytes written.
+ **************************************************************/
+static size_t encode(const void *entity, unsigned char *buffer) {
+    return genome_Encode((const PACKED_GENOME *)entity, buffer, &Genes);
+}
+
+/**********************************************************//**
+ * @brief Genome decoding adapter function.
+ * @param entity: Location to store the PACKED_GENOME.
+ * @param buffer: The encoded bytes.
+ * @param size: The number of bytes available.
+ * @return Whether the bytes held a valid genome.
+ **************************************************************/
+static bool decode(void *entity, const unsigned char *buffer, size_t size) {
+    return genome_Decode((PACKED_GENOME *)entity, buffer, size, &Genes);
+}
+
+/**********************************************************//**
+ * @brief Computes the fitness of a genome a farm worker has
+ * decoded. Nothing else a worker decodes is kept, so its genes
+ * are reclaimed right away.
+ * @param entity: The genome to evaluate.
+ * @return The fitness, with smaller values being better.
+ **************************************************************/
+static float ServeFitness(void *entity) {
+    float fitness = EvaluateFitness(entity);
+    genome_Compact(&Genes, NULL, 0);
     return fitness;
 }
 
 /**********************************************************//**
- * @brief Random creature generation adapter function.
- * @param entity: The CREATURE to generate.
+ * @brief Computes the fitness of a batch of genomes using
+ * the worker farm. Only genomes without a memoized or cached
+ * fitness are sent out, and anything the farm cannot evaluate is
+ * evaluated here instead.
+ * @param entities: The genomes to evaluate.
+ * @param count: The number of genomes.
+ * @param fitness: Location to store the fitness of each one.
  **************************************************************/
-static void create(void *entity) {
-    CREATURE *creature = (CREATURE *)entity;
-    creature_CreateRandom(creature);
+static void FarmFitness(void *const *entities, int count, float *fitness) {
+    // Gather the genomes we have not seen before
+    int nFresh = 0;
+    PACKED_GENOME **fresh = malloc(sizeof(PACKED_GENOME *)*count);
+    float *results = malloc(sizeof(float)*count);
+    for (int i = 0; fresh && i < count; i++) {
+        PACKED_GENOME *packed = (PACKED_GENOME *)entities[i];
+        if (packed->fitness == FITNESS_INVALID && !Recall(packed)) {
+            fresh[nFresh++] = packed;
+        }
+    }
+    
+    // Store the farm results in the memo table
+    if (fresh && results && farm_Evaluate(&Farm, (void *const *)fresh, nFresh, results)) {
+        for (int i = 0; i < nFresh; i++) {
+            fresh[i]->fitness = results[i];
+            Remember(fresh[i], results[i]);
+        }
+    } else {
+        eprintf("Evaluation farm failed, evaluating locally.\n");
+    }
+    free(fresh);
+    free(results);
+    for (int i = 0; i < count; i++) {
+        fitness[i] = EvaluateFitness(entities[i]);
+    }
 }
 
 /**********************************************************//**
- * @brief Creature breeding adapter function.
+ * @brief Computes the fitness of a batch of genomes by
+ * simulating them in lockstep. Only genomes without a
+ * memoized or cached fitness are simulated.
+ * @param entities: The genomes to evaluate.
+ * @param count: The number of genomes.
+ * @param fitness: Location to store the fitness of each one.
+ **************************************************************/
+static void LockstepFitness(void *const *entities, int count, float *fitness) {
+    // Gather the genomes we have not seen before, growing
+    // each into this worker's scratch creatures.
+    int nFresh = 0;
+    PACKED_GENOME *fresh[LOCKSTEP_BATCH];
+    CREATURE scratch[LOCKSTEP_BATCH];
+    CREATURE *creatures[LOCKSTEP_BATCH];
+    float results[LOCKSTEP_BATCH];
+    for (int i = 0; i < count; i++) {
+        PACKED_GENOME *packed = (PACKED_GENOME *)entities[i];
+        if (packed->fitness == FITNESS_INVALID && !Recall(packed)) {
+            GENOME genome;
+            genome_Unpack(&genome, packed, &Genes);
+            creature_Create(&scratch[nFresh], &genome);
+            creatures[nFresh] = &scratch[nFresh];
+            fresh[nFresh++] = packed;
+        }
+        
+        // Simulate whenever the lanes are full
+        if (nFresh == LOCKSTEP_BATCH || (i == count - 1 && nFresh > 0)) {
+            fitness_RaceBatch(creatures, nFresh, Cutoff, results);
+            for (int j = 0; j < nFresh; j++) {
+                fresh[j]->fitness = results[j];
+                Remember(fresh[j], results[j]);
+            }
+            nFresh = 0;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        fitness[i] = ((PACKED_GENOME *)entities[i])->fitness;
+    }
+}
+
+/**********************************************************//**
+ * @brief Prints how well the fitness evaluation was spread
+ * across the worker threads.
+ * @param pool: The workers to inspect.
+ * @param detailed: Whether to print every worker separately.
+ **************************************************************/
+static void PrintWorkers(const POOL *pool, bool detailed) {
+    double busy = 0.0;
+    double idle = 0.0;
+    for (int i = 0; i < pool->nThreads; i++) {
+        const POOL_STATISTICS *stats = pool_Statistics(pool, i);
+        busy += stats->busy;
+        idle += stats->idle;
+        if (detailed) {
+            printf("  Worker %d: ", i);
+            printf("busy %0.2lf s, ", stats->busy);
+            printf("idle %0.2lf s, ", stats->idle);
+            printf("%ld tasks, ", stats->tasks);
+            printf("%ld stolen\n", stats->steals);
+        }
+    }
+    if (busy + idle > 0.0) {
+        printf("Utilization %0.1lf%%", 100.0*busy/(busy + idle));
+    }
+}
+
+/**********************************************************//**
+ * @brief Island progress reporting function.
+ * @param island: The island index.
+ * @param generation: The generation just finished.
+ * @param fitness: The best fitness on the island.
+ **************************************************************/
+static void ReportIsland(int island, int generation, float fitness) {
+    printf("Island %d, Generation %d: Fitness %0.2f\n", island, generation, fitness);
+    fflush(stdout);
+}
+
+/**********************************************************//**
+ * @brief Saves the evolved creature to a file named after the
+ * seed and generation.
+ * @param creature: The creature to save.
+ * @param filename: Location to store the file name.
+ * @param generation: The generation reached.
+ **************************************************************/
+static void SaveCreature(const CREATURE *creature, char *filename, int generation) {
+    sprintf(filename, "%d_%d.creature", Seed, generation);
+    FILE *file = fopen(filename, "wb");
+    if (file) {
+        printf("Writing best creature to \"%s\".\n", filename);
+        fwrite(creature, CREATURE_FILE_SIZE, 1, file);
+        fclose(file);
+    }
+}
+
+/**********************************************************//**
+ * @brief Random genome generation adapter function.
+ * @param entity: The PACKED_GENOME to generate.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void create(void *entity, RNG *rng) {
+    GENOME genome;
+    genome_CreateRandom(&genome, rng);
+    genome_Pack(&genome, (PACKED_GENOME *)entity, &Genes);
+}
+
+/**********************************************************//**
+ * @brief Genome breeding adapter function.
  * @param mother: The first parent.
  * @param father: The second parent.
  * @param son: The first childn.
  * @param daughter: The second child.
+ * @param rng: The random stream to draw from.
  **************************************************************/
-static void breed(const void *mother, const void *father, void *son, void *daughter) {
-    const CREATURE *cMother = (const CREATURE *)mother;
-    const CREATURE *cFather = (const CREATURE *)father;
-    CREATURE *cSon = (CREATURE *)son;
-    CREATURE *cDaughter = (CREATURE *)daughter;
-    creature_Breed(cMother, cFather, cSon);
-    creature_Breed(cMother, cFather, cDaughter);
+static void breed(const void *mother, const void *father, void *son, void *daughter, RNG *rng) {
+    GENOME gMother;
+    GENOME gFather;
+    GENOME gChild;
+    genome_Unpack(&gMother, (const PACKED_GENOME *)mother, &Genes);
+    genome_Unpack(&gFather, (const PACKED_GENOME *)father, &Genes);
+    genome_Breed(&gMother, &gFather, &gChild, rng);
+    genome_Pack(&gChild, (PACKED_GENOME *)son, &Genes);
+    genome_Breed(&gMother, &gFather, &gChild, rng);
+    genome_Pack(&gChild, (PACKED_GENOME *)daughter, &Genes);
+}
+
+/**********************************************************//**
+ * @brief Gene reclaiming adapter function.
+ * @param entities: The PACKED_GENOMEs still in use.
+ * @param count: The number of genomes.
+ **************************************************************/
+static void compact(void **entities, int count) {
+    genome_Compact(&Genes, (PACKED_GENOME **)entities, count);
 }
 
 /**********************************************************//**
@@ -378,33 +587,235 @@ int main(int argc, char** argv) {
     CameraX = 0.0;
     CameraY = 1.5;
     Rest = true;
+    Cutoff = INFINITY;
     
     // Command-line variables
     char filename[256];
     enum {
         MODE_EVOLVE,
+        MODE_STEADY,
+        MODE_ISLANDS,
         MODE_PLAYBACK,
     } mode = MODE_EVOLVE;
+    float target = -INFINITY;
+    int cacheSize = DEFAULT_CACHE;
+    
+    // Island model configuration, filled in later.
+    ISLAND_REQUEST islands = {
+        .nIslands = 4,
+        .interval = 5,
+        .nMigrants = 5,
+        .topology = TOPOLOGY_RING,
+        .wireSize = GENOME_WIRE_SIZE,
+        .encode = &encode,
+        .decode = &decode,
+        .report = &ReportIsland,
+    };
     
     // The GENETIC algorithm configuration data.
     GENETIC_REQUEST request = {
-        .entitySize = sizeof(CREATURE),
+        .entitySize = sizeof(PACKED_GENOME),
         .populationSize = 1000,
+        .nThreads = pool_Processors(),
         .random = &create,
         .breed = &breed,
         .fitness = EvaluateFitness,
+        .cost = &EvaluationCost,
+        .compact = &compact,
+    };
+    
+    // Out of process evaluation configuration, off by default.
+    FARM_REQUEST farm = {
+        .entitySize = sizeof(PACKED_GENOME),
+        .wireSize = GENOME_WIRE_SIZE,
+        .nWorkers = 0,
+        .batchSize = 16,
+        .encode = &encode,
+        .decode = &decode,
+        .fitness = &ServeFitness,
     };
     
+    // Option reading
+    int option;
+    while ((option = getopt(argc, argv, "j:s:f:i:m:n:t:w:b:le:d:c:r:p:g:k:a:")) != -1) {
+        switch (option) {
+        case 'j':
+            // Number of fitness evaluation threads
+            request.nThreads = atoi(optarg);
+            break;
+            
+        case 's':
+            // Reproduce an earlier run
+            Seed = atoi(optarg);
+            break;
+            
+        case 'f':
+            // Stop evolving once this fitness is reached
+            target = atof(optarg);
+            break;
+            
+        case 'i':
+            // Number of island processes
+            islands.nIslands = atoi(optarg);
+            break;
+            
+        case 'm':
+            // Generations between migrations
+            islands.interval = atoi(optarg);
+            break;
+            
+        case 'n':
+            // Migrants per connection
+            islands.nMigrants = atoi(optarg);
+            break;
+            
+        case 't':
+            // Migration topology
+            if (!strcmp(optarg, "full")) {
+                islands.topology = TOPOLOGY_FULL;
+            } else {
+                islands.topology = TOPOLOGY_RING;
+            }
+            break;
+            
+        case 'w':
+            // Number of fitness evaluation processes
+            farm.nWorkers = atoi(optarg);
+            break;
+            
+        case 'b':
+            // Creatures sent to a process at a time
+            farm.batchSize = atoi(optarg);
+            break;
+            
+        case 'l':
+            // Simulate several creatures at once per thread
+            request.batchFitness = &LockstepFitness;
+            request.batchSize = LOCKSTEP_BATCH;
+            break;
+            
+        case 'e': {
+                // Integration method
+                INTEGRATOR integrator;
+                if (!creature_FindIntegrator(optarg, &integrator)) {
+                    printf("Error: No integrator \"%s\".\n", optarg);
+                    exit(-1);
+                }
+                creature_SetIntegrator(integrator);
+                break;
+            }
+            
+        case 'd':
+            // Simulation time step
+            if (!creature_SetTimeStep(atof(optarg))) {
+                printf("Error: Time step must be positive.\n");
+                exit(-1);
+            }
+            break;
+            
+        case 'c':
+            // Extrapolate gaits repeating within this tolerance
+            if (!fitness_SetCycleTolerance(atof(optarg))) {
+                printf("Error: Cycle tolerance must not be negative.\n");
+                exit(-1);
+            }
+            break;
+            
+        case 'r':
+            // Cut newborn that cannot beat the survivors
+            if (!fitness_SetRaceGain(atof(optarg))) {
+                printf("Error: Race gain must not be negative.\n");
+                exit(-1);
+            }
+            break;
+            
+        case 'p': {
+                // Screen newborn with a ladder of cheaper walks first
+                const char *rung = optarg;
+                request.nRungs = 0;
+                while (true) {
+                    double step;
+                    int trials;
+                    int length = 0;
+                    if (request.nRungs == MAX_RUNGS
+                        || sscanf(rung, "%lf,%d,%f%n", &step, &trials, &request.promote[request.nRungs], &length) != 3
+                        || !fitness_SetScreening(request.nRungs, step, trials)
+                        || (rung[length] != '\0' && rung[length] != ':')) {
+                        printf("Error: Screening must be up to %d rungs of step,trials,fraction ", MAX_RUNGS);
+                        printf("separated by colons.\n");
+                        exit(-1);
+                    }
+                    request.nRungs++;
+                    rung += length;
+                    if (*rung == '\0') {
+                        break;
+                    }
+                    rung++;
+                }
+                request.screen = &ScreenFitness;
+                break;
+            }
+            
+        case 'g': {
+                // Selection strategy, with the tournament size
+                char name[16];
+                int matched = sscanf(optarg, "%15[a-z],%d", name, &request.tournamentSize);
+                if (matched < 1 || !genetic_FindSelection(name, &request.selection)) {
+                    printf("Error: No selection \"%s\".\n", optarg);
+                    exit(-1);
+                }
+                break;
+            }
+            
+        case 'k':
+            // Fittest creatures kept each generation
+            request.elitism = atoi(optarg);
+            break;
+            
+        case 'a':
+            // Fitnesses remembered by genome, or 0 for none
+            cacheSize = atoi(optarg);
+            break;
+            
+        default:
+            printf("Usage: %s [-j threads] [-s seed] [-f fitness] ", argv[0]);
+            printf("[-i islands] [-m interval] [-n migrants] [-t ring | full] ");
+            printf("[-w workers] [-b batch] [-l] [-d step] [-c tolerance] [-r gain] ");
+            printf("[-p step,trials,fraction[:step,trials,fraction ...]] ");
+            printf("[-g sorted | truncation | tournament[,size] | rank | sus] [-k elites] ");
+            printf("[-a cache] ");
+            printf("[-e euler | verlet | midpoint | rk4 | implicit | adaptive | pointer] ");
+            printf("[forward | steady | islands | play file]\n");
+            exit(-1);
+        }
+    }
+    request.seed = Seed;
+    int nArguments = argc - optind;
+    char **arguments = argv + optind;
+    
     // Mode reading
-    if (argc == 1 || !strcmp(argv[1], "forward")) {
+    if (nArguments == 0 || !strcmp(arguments[0], "forward")) {
         // Forward walking optimization
         mode = MODE_EVOLVE;
-        Fitness = &WalkFitness;
+        Fitness = &fitness_Walk;
         
-    } else if (!strcmp(argv[1], "play")) {
+    } else if (!strcmp(arguments[0], "steady")) {
+        // Forward walking without generation barriers
+        mode = MODE_STEADY;
+        Fitness = &fitness_Walk;
+        
+    } else if (!strcmp(arguments[0], "islands")) {
+        // Forward walking on several islands
+        mode = MODE_ISLANDS;
+        Fitness = &fitness_Walk;
+        if (islands.nIslands < 1) {
+            islands.nIslands = 1;
+        }
+        
+    } else if (!strcmp(arguments[0], "play")) {
         // Creature playback phase
-        if (argc > 2) {
-            strcpy(filename, argv[2]);
+        if (nArguments > 1) {
+            strcpy(filename, arguments[1]);
             mode = MODE_PLAYBACK;
         } else {
             printf("Error: No creature playback file specified.\n");
@@ -413,13 +824,39 @@ int main(int argc, char** argv) {
         
     } else {
         // Error
-        printf("Error: No mode \"%s\".\n", argv[1]);
+        printf("Error: No mode \"%s\".\n", arguments[0]);
         exit(-1);
     }
     
+    // Clones are remembered across generations, but only within
+    // a process, so every island and farm worker has its own.
+    if (mode != MODE_PLAYBACK && cacheSize > 0 && !cache_Create(&Cache, cacheSize)) {
+        eprintf("Failed to create fitness cache.\n");
+        return EXIT_FAILURE;
+    }
+    
+    // Every process forked from here on has its own genes
+    if (mode != MODE_PLAYBACK && !genome_CreateArena(&Genes)) {
+        eprintf("Failed to create gene arena.\n");
+        return EXIT_FAILURE;
+    }
+    
     // Mode
     switch (mode) {
-        case MODE_EVOLVE: {
+        case MODE_EVOLVE:
+        case MODE_STEADY: {
+                // Worker processes must be forked before threads.
+                // The farm gets the whole population in one batch
+                // and splits it up for the workers itself.
+                bool useFarm = (mode == MODE_EVOLVE && farm.nWorkers > 0);
+                if (useFarm && !farm_Create(&Farm, &farm)) {
+                    eprintf("Failed to start evaluation farm.\n");
+                    return EXIT_FAILURE;
+                } else if (useFarm) {
+                    request.batchFitness = &FarmFitness;
+                    request.batchSize = 0;
+                }
+                
                 // Set up the genetic data
                 if (!genetic_Create(&Population, &request)) {
                     eprintf("Failed to initialize genetic algorithm.\n");
@@ -429,24 +866,124 @@ int main(int argc, char** argv) {
                 // Genetic algorithm optimization
                 double startTime = Runtime();
                 printf("Seed %d\n", Seed);
+                printf("Threads %d\n", Population.pool.nThreads);
                 int generation = 1;
                 while (generation < 100) {
-                    genetic_Generation(&Population);
-                    Creature = (CREATURE *)genetic_Best(&Population);
+                    pool_ResetStatistics(&Population.pool);
+                    fitness_ResetStatistics();
+                    if (Cache.slots) {
+                        cache_ResetStatistics(&Cache);
+                    }
+                    if (mode == MODE_STEADY) {
+                        // As many children as one generation breeds
+                        genetic_SteadyState(&Population, target, request.populationSize/2);
+                    } else {
+                        // Only this process knows the cutoff to race against
+                        bool racing = (fitness_RaceGain() > 0.0 && !useFarm);
+                        Cutoff = racing? genetic_Cutoff(&Population): INFINITY;
+                        genetic_Generation(&Population);
+                    }
                     printf("Generation %d: ", generation);
                     printf("Fitness %0.2f, ", genetic_BestFitness(&Population));
-                    printf("Time %0.2lf\n", Runtime() - startTime);
+                    printf("Time %0.2lf, ", Runtime() - startTime);
+                    printf("Genes %0.1lf MB, ", genome_ArenaSize(&Genes)/1048576.0);
+                    if (Cache.slots) {
+                        // Clones found in the cache were not simulated
+                        CACHE_STATISTICS cached;
+                        cache_Statistics(&Cache, &cached);
+                        printf("Cache hits %0.1f%%, ", 100.0*cached.hits/(cached.lookups? cached.lookups: 1));
+                        printf("%ld evaluations saved, ", cached.hits);
+                    }
+                    if (!useFarm) {
+                        // Farm workers count their trials in their own process
+                        FITNESS_STATISTICS trials;
+                        fitness_Statistics(&trials);
+                        printf("Skipped %ld trials, ", trials.skipped);
+                        printf("Extrapolated %ld, ", trials.extrapolated);
+                        printf("%ld steps saved, ", trials.stepsSaved);
+                        if (request.screen && mode == MODE_EVOLVE) {
+                            printf("Correlation");
+                            for (int rung = 0; rung < request.nRungs; rung++) {
+                                printf(" %0.2f", genetic_Correlation(&Population, rung));
+                            }
+                            printf(", ");
+                        }
+                        if (fitness_RaceGain() > 0.0 && mode == MODE_EVOLVE) {
+                            // Audited cuts that would have beaten the last survivor
+                            float threshold = -INFINITY;
+                            genetic_Survivor(&Population, Population.nSurvivors - 1, &threshold);
+                            printf("Cut %ld, %ld trials, ", trials.cut, trials.cutTrials);
+                            printf("%ld of %ld audited changed the selection, ",
+                                fitness_Overturned(threshold), trials.audited);
+                        }
+                    }
+                    PrintWorkers(&Population.pool, false);
+                    printf("\n");
                     generation++;
+                    
+                    // Time-to-fitness comparison
+                    if (genetic_BestFitness(&Population) <= target) {
+                        printf("Reached fitness %0.2f\n", target);
+                        break;
+                    }
                 }
                 
-                // Save best creature
-                sprintf(filename, "%d_%d.creature", Seed, generation);
-                FILE *file = fopen(filename, "wb");
-                if (file) {
-                    printf("Writing best creature to \"%s\".\n", filename);
-                    fwrite(Creature, sizeof(CREATURE), 1, file);
-                    fclose(file);
+                // Show the load balance of the final generation
+                printf("Workers:\n");
+                PrintWorkers(&Population.pool, true);
+                printf("\n");
+                if (useFarm) {
+                    printf("Farm: %d workers, ", farm.nWorkers);
+                    printf("%ld respawned, ", Farm.respawns);
+                    printf("%ld abandoned\n", Farm.failures);
+                    farm_Destroy(&Farm);
+                } else {
+                    // Farm workers count their steps in their own process
+                    STEP_STATISTICS steps;
+                    creature_Statistics(&steps);
+                    printf("Steps: %ld taken, ", steps.steps);
+                    printf("%ld rejected, ", steps.rejected);
+                    printf("%ld evaluations, ", steps.evaluations);
+                    printf("%0.2fx the fixed steps\n", (double)steps.steps / (steps.baseline? steps.baseline: 1));
+                }
+                cache_Destroy(&Cache);
+                
+                // Grow and save the best creature
+                GENOME best;
+                genome_Unpack(&best, genetic_Best(&Population), &Genes);
+                genome_DestroyArena(&Genes);
+                creature_Create(&Test, &best);
+                Creature = &Test;
+                SaveCreature(Creature, filename, generation);
+                break;
+        }
+        
+        case MODE_ISLANDS: {
+                // Split the threads between the island processes
+                islands.genetic = request;
+                islands.genetic.nThreads = request.nThreads / islands.nIslands;
+                printf("Seed %d\n", Seed);
+                printf("Islands %d\n", islands.nIslands);
+                
+                // Island model optimization
+                double startTime = Runtime();
+                float fitness;
+                PACKED_GENOME packed;
+                if (!island_Run(&islands, target, 99, &packed, &fitness)) {
+                    eprintf("Failed to run the island model.\n");
+                    return EXIT_FAILURE;
                 }
+                cache_Destroy(&Cache);
+                GENOME best;
+                genome_Unpack(&best, &packed, &Genes);
+                genome_DestroyArena(&Genes);
+                creature_Create(&Test, &best);
+                Creature = &Test;
+                printf("Fitness %0.2f, ", fitness);
+                printf("Time %0.2lf\n", Runtime() - startTime);
+                
+                // Save best creature
+                SaveCreature(Creature, filename, 100);
                 break;
         }
             
@@ -454,12 +991,14 @@ int main(int argc, char** argv) {
             // Load the file
             FILE *file = fopen(filename, "rb");
             if (!file) {
-                printf("Failed to open \"%s\".\n", argv[1]);
+                printf("Failed to open \"%s\".\n", filename);
                 exit(-1);
             }
-            size_t nRead = fread(&Test, sizeof(CREATURE), 1, file);
+            size_t nRead = fread(&Test, CREATURE_FILE_SIZE, 1, file);
             (void)nRead;
             fclose(file);
+            creature_Color(&Test);
+            creature_Schedule(&Test, &Test.schedule);
             Creature = &Test;
         }
         
@@ -0,0 +1,176 @@
+/**********************************************************//**
+ * @file test_batch.c
+ * @brief Tests that the lockstep simulator matches the scalar
+ * one bit for bit.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdio.h>          // printf
+#include <stdlib.h>         // malloc, free, EXIT_SUCCESS, EXIT_FAILURE
+#include <string.h>         // memcmp
+
+// This project
+#include "rng.h"            // RNG
+#include "genome.h"         // GENOME
+#include "creature.h"       // CREATURE
+#include "fitness.h"        // fitness_Walk, fitness_WalkBatch
+#include "batch.h"          // BATCH
+
+//**************************************************************
+#define TEST_CREATURES 61   ///< Creatures walked, not a whole number of batches.
+#define TEST_SEED 2017      ///< Seed of the random creatures.
+
+/// Number of checks that failed.
+static int Failures = 0;
+
+/**********************************************************//**
+ * @brief Records the outcome of one check.
+ * @param passed: Whether the check passed.
+ * @param what: What was checked.
+ **************************************************************/
+static void Check(bool passed, const char *what) {
+    if (!passed) {
+        printf("FAILED: %s\n", what);
+        Failures++;
+    }
+}
+
+/**********************************************************//**
+ * @brief Grows random creatures, every other one from a bred
+ * genome so that mutated genomes are covered too.
+ * @param creatures: Location to store the creatures.
+ * @param count: The number of creatures.
+ * @param seed: The seed of the random stream.
+ **************************************************************/
+static void Grow(CREATURE *creatures, int count, uint64_t seed) {
+    RNG rng;
+    rng_Seed(&rng, seed);
+    for (int i = 0; i < count; i++) {
+        GENOME genome;
+        genome_CreateRandom(&genome, &rng);
+        if (i % 2) {
+            GENOME mother = genome;
+            GENOME father;
+            genome_CreateRandom(&father, &rng);
+            genome_Breed(&mother, &father, &genome, &rng);
+        }
+        creature_Create(&creatures[i], &genome);
+    }
+}
+
+/**********************************************************//**
+ * @brief Checks that two creatures are in exactly the same
+ * simulation state.
+ * @param a: The first creature.
+ * @param b: The second creature.
+ * @return Whether every node and the clock match bit for bit.
+ **************************************************************/
+static bool Same(const CREATURE *a, const CREATURE *b) {
+    bool same = (a->slot == b->slot);
+    same = same && !memcmp(&a->clock, &b->clock, sizeof(float));
+    same = same && !memcmp(&a->phase, &b->phase, sizeof(float));
+    same = same && !memcmp(&a->energy, &b->energy, sizeof(float));
+    for (int i = 0; same && i < a->nNodes; i++) {
+        same = !memcmp(&a->nodes[i].position, &b->nodes[i].position, sizeof(VECTOR))
+            && !memcmp(&a->nodes[i].velocity, &b->nodes[i].velocity, sizeof(VECTOR));
+    }
+    for (int i = 0; same && i < a->nMuscles; i++) {
+        same = (a->muscles[i].isContracted == b->muscles[i].isContracted);
+    }
+    return same;
+}
+
+/**********************************************************//**
+ * @brief Tests that walking creatures in lockstep gives every
+ * one of them exactly the fitness of walking it alone.
+ **************************************************************/
+static void TestWalk(void) {
+    CREATURE *scalar = malloc(sizeof(CREATURE)*TEST_CREATURES);
+    CREATURE *lockstep = malloc(sizeof(CREATURE)*TEST_CREATURES);
+    CREATURE **pointers = malloc(sizeof(CREATURE *)*TEST_CREATURES);
+    float *expected = malloc(sizeof(float)*TEST_CREATURES);
+    float *fitness = malloc(sizeof(float)*TEST_CREATURES);
+    if (!scalar || !lockstep || !pointers || !expected || !fitness) {
+        Check(false, "the creatures can be allocated");
+    } else {
+        Grow(scalar, TEST_CREATURES, TEST_SEED);
+        for (int i = 0; i < TEST_CREATURES; i++) {
+            lockstep[i] = scalar[i];
+            pointers[i] = &lockstep[i];
+            expected[i] = fitness_Walk(&scalar[i]);
+        }
+        fitness_WalkBatch(pointers, TEST_CREATURES, fitness);
+        int nSame = 0;
+        for (int i = 0; i < TEST_CREATURES; i++) {
+            nSame += !memcmp(&expected[i], &fitness[i], sizeof(float));
+        }
+        Check(nSame == TEST_CREATURES, "every lockstep fitness matches the scalar one bit for bit");
+    }
+    free(scalar);
+    free(lockstep);
+    free(pointers);
+    free(expected);
+    free(fitness);
+}
+
+/**********************************************************//**
+ * @brief Tests that a batch animated in lockstep ends up in
+ * exactly the state of its creatures animated alone, over
+ * calls that end between steps and between toggle points,
+ * and with a creature that has run out of energy.
+ **************************************************************/
+static void TestAnimate(void) {
+    static const float calls[] = {BEHAVIOR_TIME, 0.0123, 0.5, ACTION_TIME, 1.7};
+    CREATURE scalar[BATCH_LANES];
+    CREATURE lockstep[BATCH_LANES];
+    const CREATURE *loaded[BATCH_LANES];
+    CREATURE *stored[BATCH_LANES];
+    Grow(scalar, BATCH_LANES, TEST_SEED + 1);
+    scalar[BATCH_LANES - 1].energy = MAX_ENERGY + 1.0;
+    for (int i = 0; i < BATCH_LANES; i++) {
+        lockstep[i] = scalar[i];
+        loaded[i] = &lockstep[i];
+        stored[i] = &lockstep[i];
+    }
+    
+    BATCH *batch = malloc(sizeof(BATCH));
+    if (!batch) {
+        Check(false, "the batch can be allocated");
+        return;
+    }
+    batch_Load(batch, loaded, BATCH_LANES);
+    for (int c = 0; c < (int)(sizeof(calls)/sizeof(calls[0])); c++) {
+        batch_Animate(batch, calls[c]);
+        for (int i = 0; i < BATCH_LANES; i++) {
+            creature_Animate(&scalar[i], calls[c]);
+        }
+    }
+    batch_Store(batch, stored);
+    int nSame = 0;
+    for (int i = 0; i < BATCH_LANES; i++) {
+        nSame += Same(&scalar[i], &lockstep[i]);
+    }
+    Check(nSame == BATCH_LANES, "every lane ends in the scalar state bit for bit");
+    free(batch);
+}
+
+/**********************************************************//**
+ * @brief Runs every check of the lockstep simulator.
+ * @return Exit code, nonzero if a check failed.
+ **************************************************************/
+int main(void) {
+    TestWalk();
+    TestAnimate();
+    if (Failures) {
+        printf("%d checks failed.\n", Failures);
+        return EXIT_FAILURE;
+    }
+    printf("All lockstep checks passed.\n");
+    return EXIT_SUCCESS;
+}
+
+/*============================================================*/
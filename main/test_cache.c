@@ -0,0 +1,137 @@
+/**********************************************************//**
+ * @file test_cache.c
+ * @brief Tests that the fitness cache never confuses keys.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdio.h>          // printf
+#include <stdlib.h>         // EXIT_SUCCESS, EXIT_FAILURE
+#include <stdint.h>         // uint64_t
+
+// This project
+#include "cache.h"          // CACHE
+
+//**************************************************************
+#define TEST_CAPACITY 1024  ///< Slots in the cache under test.
+
+/// Number of checks that failed.
+static int Failures = 0;
+
+/**********************************************************//**
+ * @brief Records the outcome of one check.
+ * @param passed: Whether the check passed.
+ * @param what: What was checked.
+ **************************************************************/
+static void Check(bool passed, const char *what) {
+    if (!passed) {
+        printf("FAILED: %s\n", what);
+        Failures++;
+    }
+}
+
+/**********************************************************//**
+ * @brief Checks that a key has a fitness, or none.
+ * @param cache: The cache to search.
+ * @param key: The key to look up.
+ * @param found: Whether the key should be found.
+ * @param expected: The fitness it should have if found.
+ * @param what: What was checked.
+ **************************************************************/
+static void CheckFind(CACHE *cache, uint64_t key, bool found, float expected, const char *what) {
+    float fitness = -1.0;
+    bool hit = cache_Find(cache, key, &fitness);
+    Check(hit == found && (!found || fitness == expected), what);
+}
+
+/**********************************************************//**
+ * @brief Tests keys that share the upper half with a stored
+ * key and reach its slot, either from the same home or by
+ * probing past the other keys stored before it.
+ **************************************************************/
+static void TestAliasing(void) {
+    CACHE cache;
+    cache_Create(&cache, TEST_CAPACITY);
+    uint64_t key = 0xABCD123400000010ull;
+    for (int probe = 1; probe < CACHE_PROBES; probe++) {
+        cache_Insert(&cache, 0x5555000000000010ull - probe, 0.5);
+    }
+    cache_Insert(&cache, key, 1.5);
+    CheckFind(&cache, key, true, 1.5, "an inserted key is found");
+    for (int probe = 1; probe < CACHE_PROBES; probe++) {
+        CheckFind(&cache, key - probe, false, 0.0, "a key probing through it with the same upper half is not found");
+    }
+    CheckFind(&cache, key + TEST_CAPACITY, false, 0.0, "a key with the same home is not found");
+    
+    // Neighbours fill the probe sequence without replacing it
+    cache_Insert(&cache, key + 1, 2.5);
+    cache_Insert(&cache, key + TEST_CAPACITY, 3.5);
+    CheckFind(&cache, key, true, 1.5, "a key keeps its fitness beside others");
+    CheckFind(&cache, key + 1, true, 2.5, "a neighbouring key has its own fitness");
+    CheckFind(&cache, key + TEST_CAPACITY, true, 3.5, "a key with the same home has its own fitness");
+    cache_Insert(&cache, key, -4.0);
+    CheckFind(&cache, key, true, -4.0, "inserting a key again replaces its fitness");
+    cache_Destroy(&cache);
+}
+
+/**********************************************************//**
+ * @brief Tests the keys whose halves are zero, which must not
+ * be taken for an empty slot or for each other.
+ **************************************************************/
+static void TestZero(void) {
+    CACHE cache;
+    cache_Create(&cache, TEST_CAPACITY);
+    CheckFind(&cache, 0, false, 0.0, "the zero key is not found in an empty cache");
+    cache_Insert(&cache, 0, 0.0);
+    CheckFind(&cache, 0, true, 0.0, "the zero key is found");
+    CheckFind(&cache, 1ull << 32, false, 0.0, "a key with a zero lower half is not the zero key");
+    cache_Insert(&cache, 1ull << 32, 7.0);
+    CheckFind(&cache, 0, true, 0.0, "the zero key keeps its fitness");
+    CheckFind(&cache, 1ull << 32, true, 7.0, "a key with a zero lower half has its own fitness");
+    cache_Destroy(&cache);
+}
+
+/**********************************************************//**
+ * @brief Tests that a full neighbourhood evicts the key in the
+ * home slot, and that the statistics count each call once.
+ **************************************************************/
+static void TestEviction(void) {
+    CACHE cache;
+    cache_Create(&cache, TEST_CAPACITY);
+    for (int i = 0; i < CACHE_PROBES; i++) {
+        cache_Insert(&cache, 100 + i*TEST_CAPACITY, i);
+    }
+    cache_Insert(&cache, 100 + CACHE_PROBES*TEST_CAPACITY, 42.0);
+    CheckFind(&cache, 100, false, 0.0, "the key in the home slot is evicted");
+    CheckFind(&cache, 100 + CACHE_PROBES*TEST_CAPACITY, true, 42.0, "the new key takes the home slot");
+    CheckFind(&cache, 100 + TEST_CAPACITY, true, 1.0, "the other keys are kept");
+    
+    CACHE_STATISTICS stats;
+    cache_Statistics(&cache, &stats);
+    Check(stats.lookups == 3, "every lookup is counted once");
+    Check(stats.hits == 2, "every hit is counted once");
+    Check(stats.inserts == CACHE_PROBES + 1, "every insert is counted once");
+    Check(stats.evictions == 1, "the eviction is counted");
+    cache_Destroy(&cache);
+}
+
+/**********************************************************//**
+ * @brief Runs every check of the cache.
+ * @return Exit code, nonzero if a check failed.
+ **************************************************************/
+int main(void) {
+    TestAliasing();
+    TestZero();
+    TestEviction();
+    if (Failures) {
+        printf("%d checks failed.\n", Failures);
+        return EXIT_FAILURE;
+    }
+    printf("All cache checks passed.\n");
+    return EXIT_SUCCESS;
+}
+
+/*============================================================*/
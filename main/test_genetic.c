@@ -0,0 +1,184 @@
+/**********************************************************//**
+ * @file test_genetic.c
+ * @brief Tests how the genetic algorithm ranks entities of
+ * equal fitness.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdio.h>          // printf
+#include <stdlib.h>         // EXIT_SUCCESS, EXIT_FAILURE
+
+// This project
+#include "rng.h"            // RNG
+#include "genetic.h"        // GENETIC
+
+//**************************************************************
+#define TEST_POPULATION 64  ///< Entities in the population.
+#define TEST_ELITES 24      ///< Survivors of each generation.
+#define TEST_VALUES 4       ///< Distinct fitness values an entity can have.
+#define TEST_GENERATIONS 8  ///< Generations run.
+#define TEST_SEED 99        ///< Seed of the algorithm.
+
+/// Number of checks that failed.
+static int Failures = 0;
+
+/**********************************************************//**
+ * @brief Records the outcome of one check.
+ * @param passed: Whether the check passed.
+ * @param what: What was checked.
+ **************************************************************/
+static void Check(bool passed, const char *what) {
+    if (!passed) {
+        printf("FAILED: %s\n", what);
+        Failures++;
+    }
+}
+
+/**********************************************************//**
+ * @brief Creates an entity with one of a few values, so that
+ * many entities share a fitness.
+ * @param entity: Location to store the entity.
+ * @param rng: The random stream.
+ **************************************************************/
+static void Random(void *entity, RNG *rng) {
+    *(int *)entity = rng_Randint(rng, 0, TEST_VALUES - 1);
+}
+
+/**********************************************************//**
+ * @brief Breeds clones of the parents, now and then nudged to
+ * a neighbouring value.
+ * @param mother, father: The parents.
+ * @param son, daughter: Location to store the children.
+ * @param rng: The random stream.
+ **************************************************************/
+static void Breed(const void *mother, const void *father, void *son, void *daughter, RNG *rng) {
+    int nudge = rng_Randint(rng, -1, 1);
+    *(int *)son = *(const int *)mother;
+    *(int *)daughter = (*(const int *)father + nudge + TEST_VALUES) % TEST_VALUES;
+}
+
+/**********************************************************//**
+ * @brief Gets the fitness of an entity, which is its value.
+ * @param entity: The entity.
+ * @return The fitness.
+ **************************************************************/
+static float Fitness(void *entity) {
+    return *(int *)entity;
+}
+
+/**********************************************************//**
+ * @brief Creates the algorithm under test.
+ * @param data: Storage location for algorithm data.
+ * @param nThreads: Worker threads to use.
+ * @return Whether the creation succeeded.
+ **************************************************************/
+static bool Create(GENETIC *data, int nThreads) {
+    GENETIC_REQUEST request = {
+        .entitySize = sizeof(int),
+        .populationSize = TEST_POPULATION,
+        .nThreads = nThreads,
+        .seed = TEST_SEED,
+        .random = &Random,
+        .breed = &Breed,
+        .fitness = &Fitness,
+        .selection = SELECTION_SORTED,
+        .elitism = TEST_ELITES,
+    };
+    return genetic_Create(data, &request);
+}
+
+/**********************************************************//**
+ * @brief Gets the place of a survivor in the population.
+ * @param data: Genetic algorithm data.
+ * @param rank: The rank of the survivor.
+ * @param fitness: Location to store its fitness.
+ * @return Its index, or -1 if there is none with that rank.
+ **************************************************************/
+static int SurvivorIndex(const GENETIC *data, int rank, float *fitness) {
+    const int *survivor = genetic_Survivor(data, rank, fitness);
+    return survivor? (int)(survivor - (const int *)data->entities): -1;
+}
+
+/**********************************************************//**
+ * @brief Tests that tied survivors are ranked by their index
+ * in every generation. Most of the entities are tied, and the
+ * survivors of one generation are tied with newborn placed
+ * before and after them, so the survivors are reranked and
+ * merged with the newborn on ties too.
+ **************************************************************/
+static void TestTies(void) {
+    GENETIC data;
+    if (!Create(&data, 1)) {
+        Check(false, "the algorithm can be created");
+        return;
+    }
+    for (int g = 0; g < TEST_GENERATIONS; g++) {
+        genetic_Generation(&data);
+        bool ordered = true;
+        bool consistent = true;
+        float previousFitness = 0.0;
+        int previous = SurvivorIndex(&data, 0, &previousFitness);
+        for (int r = 1; r < TEST_ELITES; r++) {
+            float fitness = 0.0;
+            int index = SurvivorIndex(&data, r, &fitness);
+            ordered = ordered && (previousFitness < fitness || (previousFitness == fitness && previous < index));
+            consistent = consistent && index >= 0 && fitness == ((int *)data.entities)[index];
+            previous = index;
+            previousFitness = fitness;
+        }
+        Check(ordered, "survivors of equal fitness are ranked by index");
+        Check(consistent, "every survivor has the fitness of its entity");
+    }
+    genetic_Destroy(&data);
+}
+
+/**********************************************************//**
+ * @brief Tests that the survivors are the same entities in
+ * the same order however many threads evaluate them.
+ **************************************************************/
+static void TestThreads(void) {
+    GENETIC single;
+    GENETIC parallel;
+    if (!Create(&single, 1)) {
+        Check(false, "the algorithm can be created");
+        return;
+    }
+    if (!Create(&parallel, 4)) {
+        Check(false, "the algorithm can be created");
+        genetic_Destroy(&single);
+        return;
+    }
+    bool same = true;
+    for (int g = 0; g < TEST_GENERATIONS; g++) {
+        genetic_Generation(&single);
+        genetic_Generation(&parallel);
+        for (int r = 0; r < TEST_ELITES; r++) {
+            float a, b;
+            same = same && SurvivorIndex(&single, r, &a) == SurvivorIndex(&parallel, r, &b);
+        }
+    }
+    Check(same, "the survivors do not depend on the number of threads");
+    genetic_Destroy(&single);
+    genetic_Destroy(&parallel);
+}
+
+/**********************************************************//**
+ * @brief Runs every check of the ranking.
+ * @return Exit code, nonzero if a check failed.
+ **************************************************************/
+int main(void) {
+    TestTies();
+    TestThreads();
+    if (Failures) {
+        printf("%d checks failed.\n", Failures);
+        return EXIT_FAILURE;
+    }
+    printf("All ranking checks passed.\n");
+    return EXIT_SUCCESS;
+}
+
+/*============================================================*/
@@ -0,0 +1,309 @@
+/**********************************************************//**
+ * @file test_genome.c
+ * @brief Tests packing, hashing and the wire format of genomes.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdio.h>          // printf
+#include <stdlib.h>         // EXIT_SUCCESS, EXIT_FAILURE
+#include <string.h>         // memcpy, memmove, memcmp, memset
+#include <math.h>           // fabs
+
+// This project
+#include "rng.h"            // RNG
+#include "genome.h"         // GENOME, PACKED_GENOME
+
+//**************************************************************
+#define TEST_GENOMES 500    ///< Random genomes each test runs on.
+#define TEST_SEED 12345     ///< Seed of the random genomes.
+
+/// Number of checks that failed.
+static int Failures = 0;
+
+/// The arena every test stores genes in.
+static GENE_ARENA Arena;
+
+/**********************************************************//**
+ * @brief Records the outcome of one check.
+ * @param passed: Whether the check passed.
+ * @param what: What was checked.
+ **************************************************************/
+static void Check(bool passed, const char *what) {
+    if (!passed) {
+        printf("FAILED: %s\n", what);
+        Failures++;
+    }
+}
+
+/**********************************************************//**
+ * @brief Checks that a gene survived quantization, which may
+ * move it by half a level.
+ * @param original: The gene before packing.
+ * @param unpacked: The gene after unpacking.
+ * @param low: The smallest value of the gene.
+ * @param high: The largest value of the gene.
+ * @return Whether the gene is within a level of the original.
+ **************************************************************/
+static bool Near(float original, float unpacked, double low, double high) {
+    return fabs(original - unpacked) <= (high - low)/GENE_LEVELS;
+}
+
+/**********************************************************//**
+ * @brief Makes a random genome, bred from two random parents
+ * every other time so that mutated genomes are covered too.
+ * @param genome: Location to store the genome.
+ * @param rng: The random stream.
+ * @param i: The number of the genome.
+ **************************************************************/
+static void Random(GENOME *genome, RNG *rng, int i) {
+    if (i % 2) {
+        GENOME mother;
+        GENOME father;
+        genome_CreateRandom(&mother, rng);
+        genome_CreateRandom(&father, rng);
+        genome_Breed(&mother, &father, genome, rng);
+    } else {
+        genome_CreateRandom(genome, rng);
+    }
+}
+
+/**********************************************************//**
+ * @brief Tests that unpacking gives back every gene to within
+ * its quantization, and that packing again changes nothing.
+ **************************************************************/
+static void TestPacking(void) {
+    RNG rng;
+    rng_Seed(&rng, TEST_SEED);
+    for (int n = 0; n < TEST_GENOMES; n++) {
+        GENOME genome;
+        Random(&genome, &rng, n);
+        genome.fitness = 0.25;
+        PACKED_GENOME packed;
+        genome_Pack(&genome, &packed, &Arena);
+        GENOME unpacked;
+        genome_Unpack(&unpacked, &packed, &Arena);
+        
+        bool same = (unpacked.nNodes == genome.nNodes && unpacked.nMuscles == genome.nMuscles);
+        same = same && unpacked.fitness == genome.fitness;
+        for (int i = 0; same && i < genome.nNodes; i++) {
+            const NODE_GENE *a = &genome.nodes[i];
+            const NODE_GENE *b = &unpacked.nodes[i];
+            same = Near(a->initial.x, b->initial.x, MIN_POSITION, MAX_POSITION)
+                && Near(a->initial.y, b->initial.y, 0.0, MAX_POSITION)
+                && Near(a->initial.z, b->initial.z, MIN_POSITION, MAX_POSITION)
+                && Near(a->friction, b->friction, MIN_FRICTION, MAX_FRICTION);
+        }
+        for (int i = 0; same && i < genome.nMuscles; i++) {
+            const MUSCLE_GENE *a = &genome.muscles[i];
+            const MUSCLE_GENE *b = &unpacked.muscles[i];
+            same = a->first == b->first && a->second == b->second
+                && Near(a->extended, b->extended, 0.0, MAX_INITIAL_LENGTH)
+                && Near(a->contracted, b->contracted, 0.0, MAX_INITIAL_LENGTH)
+                && Near(a->strength, b->strength, MIN_STRENGTH, MAX_STRENGTH);
+        }
+        same = same && !memcmp(&unpacked.behavior, &genome.behavior, sizeof(MOTION));
+        Check(same, "unpacking gives back the genes packed");
+        
+        // The unpacked genes are all on quantization levels
+        PACKED_GENOME repacked;
+        genome_Pack(&unpacked, &repacked, &Arena);
+        GENOME again;
+        genome_Unpack(&again, &repacked, &Arena);
+        same = (again.nNodes == unpacked.nNodes && again.nMuscles == unpacked.nMuscles);
+        for (int i = 0; same && i < unpacked.nNodes; i++) {
+            same = !memcmp(&again.nodes[i], &unpacked.nodes[i], sizeof(NODE_GENE));
+        }
+        for (int i = 0; same && i < unpacked.nMuscles; i++) {
+            same = !memcmp(&again.muscles[i], &unpacked.muscles[i], sizeof(MUSCLE_GENE));
+        }
+        Check(same, "packing an unpacked genome loses nothing");
+        Check(genome_Hash(&packed, &Arena) == genome_Hash(&repacked, &Arena), "repacked genomes hash the same");
+    }
+}
+
+/**********************************************************//**
+ * @brief Tests that decoding an encoded genome gives back the
+ * same genome without its fitness.
+ **************************************************************/
+static void TestWire(void) {
+    RNG rng;
+    rng_Seed(&rng, TEST_SEED + 1);
+    unsigned char wire[GENOME_WIRE_SIZE];
+    unsigned char again[GENOME_WIRE_SIZE];
+    for (int n = 0; n < TEST_GENOMES; n++) {
+        GENOME genome;
+        Random(&genome, &rng, n);
+        genome.fitness = 0.5;
+        PACKED_GENOME packed;
+        genome_Pack(&genome, &packed, &Arena);
+        size_t size = genome_Encode(&packed, wire, &Arena);
+        Check(size <= GENOME_WIRE_SIZE, "an encoding fits in GENOME_WIRE_SIZE");
+        
+        PACKED_GENOME decoded;
+        bool valid = genome_Decode(&decoded, wire, size, &Arena);
+        Check(valid, "an encoded genome decodes");
+        if (!valid) {
+            continue;
+        }
+        Check(decoded.fitness == FITNESS_INVALID, "a decoded genome has no fitness");
+        Check(genome_Hash(&decoded, &Arena) == genome_Hash(&packed, &Arena), "a decoded genome hashes the same");
+        Check(genome_Encode(&decoded, again, &Arena) == size && !memcmp(wire, again, size),
+            "a decoded genome encodes the same");
+    }
+}
+
+/**********************************************************//**
+ * @brief Checks that some bytes are rejected without touching
+ * the genome or the arena.
+ * @param wire: The bytes to decode.
+ * @param size: The number of bytes.
+ * @param what: What was checked.
+ **************************************************************/
+static void CheckRejected(const unsigned char *wire, size_t size, const char *what) {
+    PACKED_GENOME packed;
+    PACKED_GENOME before;
+    memset(&packed, 0xA5, sizeof(packed));
+    before = packed;
+    uint64_t used = genome_ArenaSize(&Arena);
+    bool valid = genome_Decode(&packed, wire, size, &Arena);
+    Check(!valid && !memcmp(&packed, &before, sizeof(packed)) && genome_ArenaSize(&Arena) == used, what);
+}
+
+/**********************************************************//**
+ * @brief Tests that malformed encodings are rejected. Each one
+ * is a valid encoding with a single fault.
+ **************************************************************/
+static void TestMalformed(void) {
+    // A genome with every muscle used by the behavior
+    RNG rng;
+    rng_Seed(&rng, TEST_SEED + 2);
+    GENOME genome;
+    genome_CreateRandom(&genome, &rng);
+    for (int i = 0; i < MAX_ACTIONS; i++) {
+        genome.behavior.action[i] = i % genome.nMuscles;
+    }
+    PACKED_GENOME packed;
+    genome_Pack(&genome, &packed, &Arena);
+    unsigned char wire[GENOME_WIRE_SIZE + 1];
+    size_t size = genome_Encode(&packed, wire, &Arena);
+    int nNodes = genome.nNodes;
+    int nMuscles = genome.nMuscles;
+    size_t muscles = 4 + 8*nNodes;
+    size_t actions = muscles + 8*nMuscles;
+    
+    unsigned char bad[GENOME_WIRE_SIZE + 1];
+    CheckRejected(wire, 0, "an empty encoding is rejected");
+    CheckRejected(wire, 3, "a partial header is rejected");
+    CheckRejected(wire, size - 1, "a truncated encoding is rejected");
+    wire[size] = 0;
+    CheckRejected(wire, size + 1, "an encoding with trailing bytes is rejected");
+    
+    memcpy(bad, wire, size);
+    bad[0] = GENOME_WIRE_VERSION + 1;
+    CheckRejected(bad, size, "another version is rejected");
+    memcpy(bad, wire, size);
+    bad[1] = MIN_NODES - 1;
+    CheckRejected(bad, size, "too few nodes are rejected");
+    memcpy(bad, wire, size);
+    bad[1] = MAX_NODES + 1;
+    CheckRejected(bad, size, "too many nodes are rejected");
+    
+    // Dropping the last muscle leaves a consistent encoding
+    // of a genome with one muscle too few
+    GENOME few = genome;
+    few.nMuscles = MIN_MUSCLES;
+    memset(&few.behavior, MUSCLE_NONE, sizeof(MOTION));
+    PACKED_GENOME packedFew;
+    genome_Pack(&few, &packedFew, &Arena);
+    size_t sizeFew = genome_Encode(&packedFew, bad, &Arena);
+    size_t last = 4 + 8*nNodes + 8*(MIN_MUSCLES - 1);
+    memmove(bad + last, bad + last + 8, MAX_ACTIONS);
+    bad[2] = MIN_MUSCLES - 1;
+    CheckRejected(bad, sizeFew - 8, "too few muscles are rejected");
+    memcpy(bad, wire, size);
+    bad[2] = MAX_MUSCLES + 1;
+    CheckRejected(bad, size, "too many muscles are rejected");
+    
+    memcpy(bad, wire, size);
+    bad[muscles + 8*(nMuscles - 1)] = nNodes;
+    CheckRejected(bad, size, "a muscle on a missing node is rejected");
+    memcpy(bad, wire, size);
+    bad[muscles + 1] = bad[muscles];
+    CheckRejected(bad, size, "a muscle joining a node to itself is rejected");
+    memcpy(bad, wire, size);
+    bad[actions + MAX_ACTIONS - 1] = nMuscles;
+    CheckRejected(bad, size, "an action on a missing muscle is rejected");
+    memcpy(bad, wire, size);
+    bad[actions + MAX_ACTIONS - 1] = MAX_MUSCLES;
+    CheckRejected(bad, size, "an action past every muscle is rejected");
+    
+    // The faults are all that made them invalid
+    PACKED_GENOME decoded;
+    Check(genome_Decode(&decoded, wire, size, &Arena), "the unaltered encoding decodes");
+    memcpy(bad, wire, size);
+    bad[actions] = MUSCLE_NONE;
+    Check(genome_Decode(&decoded, bad, size, &Arena), "an action can be MUSCLE_NONE");
+}
+
+/**********************************************************//**
+ * @brief Tests that actions on muscles a genome does not have,
+ * which do nothing, are treated as MUSCLE_NONE.
+ **************************************************************/
+static void TestDeadActions(void) {
+    RNG rng;
+    rng_Seed(&rng, TEST_SEED + 3);
+    GENOME genome;
+    genome_CreateRandom(&genome, &rng);
+    genome.nMuscles = MIN_MUSCLES;
+    genome.behavior.action[0] = MUSCLE_NONE;
+    GENOME dead = genome;
+    dead.behavior.action[0] = MIN_MUSCLES + 1;
+    GENOME live = genome;
+    live.behavior.action[0] = MIN_MUSCLES - 1;
+    
+    PACKED_GENOME packed;
+    PACKED_GENOME packedDead;
+    PACKED_GENOME packedLive;
+    genome_Pack(&genome, &packed, &Arena);
+    genome_Pack(&dead, &packedDead, &Arena);
+    genome_Pack(&live, &packedLive, &Arena);
+    uint64_t hash = genome_Hash(&packed, &Arena);
+    Check(genome_Hash(&packedDead, &Arena) == hash, "an action on a missing muscle hashes as MUSCLE_NONE");
+    Check(genome_Hash(&packedLive, &Arena) != hash, "an action on a live muscle changes the hash");
+    
+    unsigned char wire[GENOME_WIRE_SIZE];
+    unsigned char wireDead[GENOME_WIRE_SIZE];
+    size_t size = genome_Encode(&packed, wire, &Arena);
+    Check(genome_Encode(&packedDead, wireDead, &Arena) == size && !memcmp(wire, wireDead, size),
+        "an action on a missing muscle is encoded as MUSCLE_NONE");
+    PACKED_GENOME decoded;
+    Check(genome_Decode(&decoded, wireDead, size, &Arena), "a genome with an action on a missing muscle decodes");
+}
+
+/**********************************************************//**
+ * @brief Runs every check of the genomes.
+ * @return Exit code, nonzero if a check failed.
+ **************************************************************/
+int main(void) {
+    if (!genome_CreateArena(&Arena)) {
+        printf("Failed to create the gene arena.\n");
+        return EXIT_FAILURE;
+    }
+    TestPacking();
+    TestWire();
+    TestMalformed();
+    TestDeadActions();
+    genome_DestroyArena(&Arena);
+    if (Failures) {
+        printf("%d checks failed.\n", Failures);
+        return EXIT_FAILURE;
+    }
+    printf("All genome checks passed.\n");
+    return EXIT_SUCCESS;
+}
+
+/*============================================================*/
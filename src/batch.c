@@ -0,0 +1,457 @@
+/**********************************************************//**
+ * @file batch.c
+ * @brief Implementation of a lockstep simulator that advances
+ * several creatures at once.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <math.h>           // fmod, sqrtf
+
+// This project
+#include "debug.h"          // assert
+#include "vector.h"         // iszero
+#include "creature.h"       // CREATURE
+#include "batch.h"          // BATCH
+
+//**************************************************************
+/// @brief Compiles a function once per instruction set and
+/// picks the best one when the program loads. AVX2 gives real
+/// gathers and twice the lanes per instruction. FMA is left
+/// out on purpose: fusing multiplies and adds changes the
+/// rounding, and the simulation is chaotic enough that the
+/// lanes would drift away from creature_Animate.
+#if defined(__GNUC__) && !defined(WINDOWS)
+#define BATCH_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH_CLONES
+#endif
+
+/**********************************************************//**
+ * @brief Computes the force one muscle exerts in every lane.
+ * The rows are passed as separate restrict pointers and the
+ * lane loop is kept rolled so the compiler vectorizes it
+ * across lanes, gathering each lane's own two nodes.
+ * @param x, y, z: The node position rows.
+ * @param vx, vy, vz: The node velocity rows.
+ * @param first, second: The node indices of this muscle.
+ * @param extended, contracted, strength: The muscle lengths
+ * and stiffness.
+ * @param active: Whether the muscle exerts force.
+ * @param isContracted: Whether the muscle is contracting.
+ * @param mask: Whether each lane takes part in the update.
+ * @param fx, fy, fz: Location to store the force on the first
+ * node. The second node gets the opposite force.
+ * @param energy: The energy spent by each lane.
+ * @param dt: The time step of each lane in seconds.
+ **************************************************************/
+static inline void MuscleRow(
+        const float *restrict x, const float *restrict y, const float *restrict z,
+        const float *restrict vx, const float *restrict vy, const float *restrict vz,
+        const int *restrict first, const int *restrict second,
+        const float *restrict extended, const float *restrict contracted, const float *restrict strength,
+        const int *restrict active, const int *restrict isContracted, const int *restrict mask,
+        float *restrict fx, float *restrict fy, float *restrict fz, float *restrict energy,
+        const float *restrict dt) {
+    _Pragma("GCC unroll 1")
+    for (int l = 0; l < BATCH_LANES; l++) {
+        int a = first[l]*BATCH_LANES + l;
+        int b = second[l]*BATCH_LANES + l;
+
+        // Normalized muscle direction
+        float dx = x[b] - x[a];
+        float dy = y[b] - y[a];
+        float dz = z[b] - z[a];
+        float length = sqrtf(dx*dx + dy*dy + dz*dz);
+        float inverse = 1.0 / length;
+        dx *= inverse;
+        dy *= inverse;
+        dz *= inverse;
+
+        // Spring force per unit of target length
+        float contractedLength = contracted[l];
+        float extendedLength = extended[l];
+        float targetLength = isContracted[l]? contractedLength: extendedLength;
+        float forceMagnitude = -(strength[l]/targetLength)*(targetLength - length);
+
+        // Velocity damping along the muscle
+        float firstVelocity = dx*vx[a] + dy*vy[a] + dz*vz[a];
+        float secondVelocity = dx*vx[b] + dy*vy[b] + dz*vz[b];
+        forceMagnitude -= DAMPING*(firstVelocity-secondVelocity);
+        forceMagnitude = active[l]? forceMagnitude: 0.0;
+        fx[l] = dx*forceMagnitude;
+        fy[l] = dy*forceMagnitude;
+        fz[l] = dz*forceMagnitude;
+
+        // Energy expenditure from the muscular force
+        float spent = energy[l] + dt[l]*fabs(forceMagnitude);
+        energy[l] = (isContracted[l] & mask[l])? spent: energy[l];
+    }
+}
+
+/**********************************************************//**
+ * @brief Applies drag and ground friction to one node in
+ * every lane.
+ * @param y: The node heights.
+ * @param vx, vy, vz: The node velocities.
+ * @param friction: The node friction coefficients.
+ * @param ax, ay, az: The node accelerations to add to.
+ **************************************************************/
+static inline void FrictionRow(
+        const float *restrict y, const float *restrict vx, const float *restrict vy, const float *restrict vz,
+        const float *restrict friction, float *restrict ax, float *restrict ay, float *restrict az) {
+    const float drag = -DRAG;
+    _Pragma("GCC unroll 1")
+    for (int l = 0; l < BATCH_LANES; l++) {
+        ax[l] += vx[l]*drag;
+        ay[l] += vy[l]*drag;
+        az[l] += vz[l]*drag;
+
+        // Frictional force projected onto the XZ plane, with the
+        // conditions combined without branching.
+        bool still = iszero(vx[l]) & iszero(vy[l]) & iszero(vz[l]);
+        bool grounded = iszero(y[l]) & !iszero(friction[l]);
+        float scale = -FRICTION*friction[l];
+        scale = (grounded & !still)? scale: 0.0;
+        ax[l] += vx[l]*scale;
+        az[l] += vz[l]*scale;
+    }
+}
+
+/**********************************************************//**
+ * @brief Integrates one node in every lane with a midpoint
+ * step and bounces it off the ground. Only the lanes in the
+ * mask are written back.
+ * @param x, y, z: The node positions.
+ * @param vx, vy, vz: The node velocities.
+ * @param ax, ay, az: The node accelerations to store.
+ * @param nx, ny, nz: The new accelerations.
+ * @param mask: Whether each lane takes part in the update.
+ * @param dt: The time step of each lane in seconds.
+ **************************************************************/
+static inline void IntegrateRow(
+        float *restrict x, float *restrict y, float *restrict z,
+        float *restrict vx, float *restrict vy, float *restrict vz,
+        float *restrict ax, float *restrict ay, float *restrict az,
+        const float *restrict nx, const float *restrict ny, const float *restrict nz,
+        const int *restrict mask, const float *restrict dt) {
+    _Pragma("GCC unroll 1")
+    for (int l = 0; l < BATCH_LANES; l++) {
+        float h = dt[l];
+        float px = x[l] + h*(vx[l] + 0.5*h*nx[l]);
+        float py = y[l] + h*(vy[l] + 0.5*h*ny[l]);
+        float pz = z[l] + h*(vz[l] + 0.5*h*nz[l]);
+        float qx = vx[l] + h*nx[l];
+        float qy = vy[l] + h*ny[l];
+        float qz = vz[l] + h*nz[l];
+
+        // Collision check
+        bool bounce = iszero(py) | (py < 0.0);
+        float rebound = qy*-RESTITUTION;
+        py = bounce? 0.0: py;
+        qy = bounce? rebound: qy;
+
+        // Commit the lanes being updated
+        bool keep = mask[l];
+        x[l] = keep? px: x[l];
+        y[l] = keep? py: y[l];
+        z[l] = keep? pz: z[l];
+        vx[l] = keep? qx: vx[l];
+        vy[l] = keep? qy: vy[l];
+        vz[l] = keep? qz: vz[l];
+        ax[l] = keep? nx[l]: ax[l];
+        ay[l] = keep? ny[l]: ay[l];
+        az[l] = keep? nz[l]: az[l];
+    }
+}
+
+/**********************************************************//**
+ * @brief Updates the lanes selected by the mask by one step,
+ * exactly like creature_UpdateFull does for one creature.
+ * Lanes outside the mask are computed but never written back.
+ * @param batch: The creatures to update.
+ * @param mask: Whether each lane takes part in the update.
+ * @param dt: The time step of each lane in seconds.
+ **************************************************************/
+BATCH_CLONES static void UpdateFull(BATCH *batch, const int *mask, const float *dt) {
+    // Accelerations are built up here and only kept for the
+    // lanes in the mask.
+    LANES(float, ax, MAX_NODES);
+    LANES(float, ay, MAX_NODES);
+    LANES(float, az, MAX_NODES);
+    for (int i = 0; i < batch->nNodes; i++) {
+        for (int l = 0; l < BATCH_LANES; l++) {
+            ax[i][l] = 0.0;
+            ay[i][l] = GRAVITY;
+            az[i][l] = 0.0;
+        }
+    }
+
+    // Compute all the muscle forces, with padding muscles
+    // masked out rather than skipped.
+    LANES(float, fx, MAX_MUSCLES);
+    LANES(float, fy, MAX_MUSCLES);
+    LANES(float, fz, MAX_MUSCLES);
+    for (int i = 0; i < batch->nMuscles; i++) {
+        MuscleRow(batch->x[0], batch->y[0], batch->z[0],
+            batch->vx[0], batch->vy[0], batch->vz[0],
+            batch->first[i], batch->second[i],
+            batch->extended[i], batch->contracted[i], batch->strength[i],
+            batch->active[i], batch->isContracted[i], mask,
+            fx[i], fy[i], fz[i], batch->energy, dt);
+    }
+
+    // Apply the muscle forces to their endpoints. Each lane
+    // only touches its own column, so this is the same
+    // sequence of additions as for one creature.
+    for (int i = 0; i < batch->nMuscles; i++) {
+        for (int l = 0; l < BATCH_LANES; l++) {
+            int first = batch->first[i][l];
+            int second = batch->second[i][l];
+            ax[first][l] += fx[i][l];
+            ay[first][l] += fy[i][l];
+            az[first][l] += fz[i][l];
+            ax[second][l] -= fx[i][l];
+            ay[second][l] -= fy[i][l];
+            az[second][l] -= fz[i][l];
+        }
+    }
+
+    // Drag, friction and integration, one node at a time
+    for (int i = 0; i < batch->nNodes; i++) {
+        FrictionRow(batch->y[i], batch->vx[i], batch->vy[i], batch->vz[i],
+            batch->friction[i], ax[i], ay[i], az[i]);
+    }
+    for (int i = 0; i < batch->nNodes; i++) {
+        IntegrateRow(batch->x[i], batch->y[i], batch->z[i],
+            batch->vx[i], batch->vy[i], batch->vz[i],
+            batch->ax[i], batch->ay[i], batch->az[i],
+            ax[i], ay[i], az[i], mask, dt);
+    }
+}
+
+/**********************************************************//**
+ * @brief Updates the lanes selected by the mask with the same
+ * forced time step as creature_Update.
+ * @param batch: The creatures to update.
+ * @param mask: Whether each lane takes part in the update.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+static void Update(BATCH *batch, const int *mask, float dt) {
+    int fullSteps = (int)(dt / TIME_STEP);
+    float fullStep[BATCH_LANES] __attribute__((aligned(BATCH_ALIGN)));
+    float partialStep[BATCH_LANES] __attribute__((aligned(BATCH_ALIGN)));
+    for (int l = 0; l < BATCH_LANES; l++) {
+        fullStep[l] = TIME_STEP;
+        partialStep[l] = fmod(dt, TIME_STEP);
+    }
+    for (int i = 0; i < fullSteps; i++) {
+        UpdateFull(batch, mask, fullStep);
+    }
+    UpdateFull(batch, mask, partialStep);
+}
+
+/**********************************************************//**
+ * @brief Finds the next span of one lane that takes any
+ * steps, toggling the muscles of the spans that take none.
+ * @param batch: The creatures being animated.
+ * @param animation: The plan of the lane.
+ * @param lane: The lane to advance.
+ * @param steps: Location to store the number of steps in the
+ * span, counting the partial step.
+ * @param partial: Location to store the partial step.
+ * @param muscle: Location to store the muscle to toggle at
+ * the end of the span.
+ * @return Whether the lane has another span.
+ **************************************************************/
+static bool NextSpan(BATCH *batch, ANIMATION *animation, int lane, int *steps, float *partial, int *muscle) {
+    float span;
+    while (creature_NextSpan(animation, &batch->schedule[lane], &span, muscle)) {
+        if (!iszero(span)) {
+            *steps = (int)(span / TIME_STEP) + 1;
+            *partial = fmod(span, TIME_STEP);
+            return true;
+        }
+        if (*muscle != MUSCLE_NONE) {
+            batch->isContracted[*muscle][lane] = !batch->isContracted[*muscle][lane];
+        }
+    }
+    return false;
+}
+
+/*============================================================*
+ * Transposing creatures in
+ *============================================================*/
+void batch_Load(BATCH *batch, const CREATURE *const *creatures, int count) {
+    assert(count >= 1 && count <= BATCH_LANES);
+    batch->nCreatures = count;
+    batch->nNodes = 0;
+    batch->nMuscles = 0;
+    for (int l = 0; l < count; l++) {
+        if (creatures[l]->nNodes > batch->nNodes) {
+            batch->nNodes = creatures[l]->nNodes;
+        }
+        if (creatures[l]->nMuscles > batch->nMuscles) {
+            batch->nMuscles = creatures[l]->nMuscles;
+        }
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        const CREATURE *creature = creatures[(l < count)? l: 0];
+        batch->nodeCount[l] = creature->nNodes;
+        batch->clock[l] = creature->clock;
+        batch->slot[l] = creature->slot;
+        batch->phase[l] = creature->phase;
+        batch->energy[l] = creature->energy;
+
+        // Padding nodes rest on the ground with no friction
+        for (int i = 0; i < batch->nNodes; i++) {
+            if (i < creature->nNodes) {
+                const NODE *node = &creature->nodes[i];
+                batch->x[i][l] = node->position.x;
+                batch->y[i][l] = node->position.y;
+                batch->z[i][l] = node->position.z;
+                batch->vx[i][l] = node->velocity.x;
+                batch->vy[i][l] = node->velocity.y;
+                batch->vz[i][l] = node->velocity.z;
+                batch->ax[i][l] = node->acceleration.x;
+                batch->ay[i][l] = node->acceleration.y;
+                batch->az[i][l] = node->acceleration.z;
+                batch->friction[i][l] = node->friction;
+            } else {
+                batch->x[i][l] = batch->y[i][l] = batch->z[i][l] = 0.0;
+                batch->vx[i][l] = batch->vy[i][l] = batch->vz[i][l] = 0.0;
+                batch->ax[i][l] = batch->ay[i][l] = batch->az[i][l] = 0.0;
+                batch->friction[i][l] = 0.0;
+            }
+        }
+
+        // Padding muscles join the first two nodes, which every
+        // creature has, but exert no force. Muscles without
+        // strength are skipped by creature_UpdateFull too.
+        for (int i = 0; i < batch->nMuscles; i++) {
+            if (i < creature->nMuscles) {
+                const MUSCLE *muscle = &creature->muscles[i];
+                batch->first[i][l] = muscle->first;
+                batch->second[i][l] = muscle->second;
+                batch->extended[i][l] = muscle->extended;
+                batch->contracted[i][l] = muscle->contracted;
+                batch->strength[i][l] = muscle->strength;
+                batch->active[i][l] = !iszero(muscle->strength);
+            } else {
+                batch->first[i][l] = 0;
+                batch->second[i][l] = 1;
+                batch->extended[i][l] = 1.0;
+                batch->contracted[i][l] = 1.0;
+                batch->strength[i][l] = 0.0;
+                batch->active[i][l] = false;
+            }
+        }
+
+        // Actions may toggle any muscle, used or not
+        for (int i = 0; i < MAX_MUSCLES; i++) {
+            batch->isContracted[i][l] = creature->muscles[i].isContracted;
+        }
+        if (creature->schedule.nEvents != SCHEDULE_INVALID) {
+            batch->schedule[l] = creature->schedule;
+        } else {
+            creature_Schedule(creature, &batch->schedule[l]);
+        }
+    }
+}
+
+/*============================================================*
+ * Transposing creatures out
+ *============================================================*/
+void batch_Store(const BATCH *batch, CREATURE *const *creatures) {
+    for (int l = 0; l < batch->nCreatures; l++) {
+        CREATURE *creature = creatures[l];
+        creature->clock = batch->clock[l];
+        creature->slot = batch->slot[l];
+        creature->phase = batch->phase[l];
+        creature->energy = batch->energy[l];
+        for (int i = 0; i < creature->nNodes; i++) {
+            NODE *node = &creature->nodes[i];
+            vector_Set(&node->position, batch->x[i][l], batch->y[i][l], batch->z[i][l]);
+            vector_Set(&node->velocity, batch->vx[i][l], batch->vy[i][l], batch->vz[i][l]);
+            vector_Set(&node->acceleration, batch->ax[i][l], batch->ay[i][l], batch->az[i][l]);
+        }
+        for (int i = 0; i < MAX_MUSCLES; i++) {
+            creature->muscles[i].isContracted = batch->isContracted[i][l];
+        }
+    }
+}
+
+/*============================================================*
+ * Lockstep evaluation
+ *============================================================*/
+void batch_Animate(BATCH *batch, float dt) {
+    // Energy death. Dead creatures relax every muscle and take
+    // the whole time step at once, without advancing the clock.
+    int live[BATCH_LANES];
+    int dead[BATCH_LANES];
+    bool anyDead = false;
+    for (int l = 0; l < BATCH_LANES; l++) {
+        dead[l] = (batch->energy[l] > MAX_ENERGY);
+        live[l] = !dead[l];
+        anyDead = anyDead || dead[l];
+    }
+    if (anyDead) {
+        for (int i = 0; i < MAX_MUSCLES; i++) {
+            for (int l = 0; l < BATCH_LANES; l++) {
+                batch->isContracted[i][l] = dead[l]? false: batch->isContracted[i][l];
+            }
+        }
+        Update(batch, dead, dt);
+    }
+
+    // Plan every living lane and find its first span
+    ANIMATION animation[BATCH_LANES];
+    int active[BATCH_LANES] = {0};
+    int steps[BATCH_LANES] = {0};
+    float partial[BATCH_LANES] = {0.0};
+    int muscle[BATCH_LANES];
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (live[l]) {
+            creature_Plan(&animation[l], &batch->schedule[l], batch->slot[l], batch->phase[l], dt);
+            active[l] = NextSpan(batch, &animation[l], l, &steps[l], &partial[l], &muscle[l]);
+        }
+    }
+
+    // Step every lane with spans left, each with its own step
+    // size, and toggle its muscle at the end of each span.
+    float step[BATCH_LANES] __attribute__((aligned(BATCH_ALIGN)));
+    while (true) {
+        bool anyActive = false;
+        for (int l = 0; l < BATCH_LANES; l++) {
+            step[l] = (steps[l] > 1)? TIME_STEP: partial[l];
+            anyActive = anyActive || active[l];
+        }
+        if (!anyActive) {
+            break;
+        }
+        UpdateFull(batch, active, step);
+        for (int l = 0; l < BATCH_LANES; l++) {
+            if (!active[l] || --steps[l] > 0) {
+                continue;
+            }
+            if (muscle[l] != MUSCLE_NONE) {
+                batch->isContracted[muscle[l]][l] = !batch->isContracted[muscle[l]][l];
+            }
+            active[l] = NextSpan(batch, &animation[l], l, &steps[l], &partial[l], &muscle[l]);
+        }
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (live[l]) {
+            batch->slot[l] = animation[l].slot;
+            batch->phase[l] = animation[l].phase;
+            batch->clock[l] += animation[l].elapsed;
+        }
+    }
+}
+
+/*============================================================*/
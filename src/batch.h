@@ -0,0 +1,147 @@
+/**********************************************************//**
+ * @file batch.h
+ * @brief Declaration of a lockstep simulator that advances
+ * several creatures at once.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+// Standard library
+#include <stdbool.h>        // bool
+
+// This project
+#include "vector.h"         // VECTOR
+#include "creature.h"       // CREATURE, SCHEDULE, MAX_NODES, MAX_MUSCLES
+
+//**************************************************************
+/// Number of creatures simulated together, one per SIMD lane.
+#define BATCH_LANES 8
+
+/// Alignment of every lane array, enough for any vector width.
+#define BATCH_ALIGN 64
+
+/// Declares an array with one column per lane.
+#define LANES(type, name, rows) type name[rows][BATCH_LANES] __attribute__((aligned(BATCH_ALIGN)))
+
+/**********************************************************//**
+ * @struct BATCH
+ * @brief Stores the simulation state of up to BATCH_LANES
+ * creatures transposed into structure-of-arrays form. Every
+ * array is indexed [node or muscle][lane], so one row holds
+ * the same part of every creature and the inner loops run
+ * across creatures. Creatures with fewer parts are padded
+ * with nodes that nothing is attached to and muscles that
+ * exert no force.
+ **************************************************************/
+typedef struct {
+    int nCreatures;         ///< The number of lanes in use.
+    int nNodes;             ///< The most nodes of any creature.
+    int nMuscles;           ///< The most muscles of any creature.
+    int nodeCount[BATCH_LANES];     ///< Real nodes in each lane.
+    float clock[BATCH_LANES];       ///< The biological clock of each lane.
+    int slot[BATCH_LANES];          ///< The action slot of each lane.
+    float phase[BATCH_LANES];       ///< The time each lane is into its slot.
+    float energy[BATCH_LANES];      ///< The energy spent by each lane.
+
+    // Nodes
+    LANES(float, x, MAX_NODES);     ///< Node X positions.
+    LANES(float, y, MAX_NODES);     ///< Node Y positions.
+    LANES(float, z, MAX_NODES);     ///< Node Z positions.
+    LANES(float, vx, MAX_NODES);    ///< Node X velocities.
+    LANES(float, vy, MAX_NODES);    ///< Node Y velocities.
+    LANES(float, vz, MAX_NODES);    ///< Node Z velocities.
+    LANES(float, ax, MAX_NODES);    ///< Node X accelerations.
+    LANES(float, ay, MAX_NODES);    ///< Node Y accelerations.
+    LANES(float, az, MAX_NODES);    ///< Node Z accelerations.
+    LANES(float, friction, MAX_NODES);  ///< Node friction coefficients.
+
+    // Muscles
+    LANES(int, first, MAX_MUSCLES);     ///< Index of the first node.
+    LANES(int, second, MAX_MUSCLES);    ///< Index of the second node.
+    LANES(float, extended, MAX_MUSCLES);    ///< Extended muscle lengths.
+    LANES(float, contracted, MAX_MUSCLES);  ///< Contracted muscle lengths.
+    LANES(float, strength, MAX_MUSCLES);    ///< Muscle stiffnesses.
+    LANES(int, active, MAX_MUSCLES);        ///< Whether the muscle exerts force.
+    LANES(int, isContracted, MAX_MUSCLES);  ///< Whether the muscle is contracting.
+
+    // Behavior, walked lane by lane
+    SCHEDULE schedule[BATCH_LANES]; ///< The toggle events of each lane.
+} BATCH;
+
+/**********************************************************//**
+ * @brief Transposes creatures into a batch. The creatures
+ * should have been reset, or at least animated in step so
+ * their clocks agree.
+ * @param batch: Storage location for the batch.
+ * @param creatures: The creatures to simulate.
+ * @param count: The number of creatures, from 1 to
+ * BATCH_LANES. Unused lanes simulate a copy of the first.
+ **************************************************************/
+extern void batch_Load(BATCH *batch, const CREATURE *const *creatures, int count);
+
+/**********************************************************//**
+ * @brief Copies the simulation state of a batch back into
+ * the creatures it was loaded from.
+ * @param batch: The batch to read.
+ * @param creatures: The creatures to update, in the same
+ * order they were loaded.
+ **************************************************************/
+extern void batch_Store(const BATCH *batch, CREATURE *const *creatures);
+
+/**********************************************************//**
+ * @brief Plays back the animation of every creature in the
+ * batch with the midpoint method and TIME_STEP, regardless of
+ * the integrator creatures are otherwise updated with. Each lane
+ * follows exactly the steps creature_Animate
+ * takes, including energy death, and evaluates the same
+ * expressions in the same order, so the results are identical
+ * as long as the compiler does not contract them. Lanes reach
+ * their toggle events at different steps, so each lane has its
+ * own step size and lanes that finish early sit out the rest.
+ * @param batch: The creatures to animate.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+extern void batch_Animate(BATCH *batch, float dt);
+
+/**********************************************************//**
+ * @brief Computes the average node position of one creature,
+ * summed in the same order as for a single creature.
+ * @param batch: The batch to inspect.
+ * @param lane: The creature within the batch.
+ * @return The average position of the creature's nodes.
+ **************************************************************/
+static inline VECTOR batch_AveragePosition(const BATCH *batch, int lane) {
+    VECTOR total = {0.0, 0.0, 0.0};
+    for (int i = 0; i < batch->nodeCount[lane]; i++) {
+        VECTOR position = {batch->x[i][lane], batch->y[i][lane], batch->z[i][lane]};
+        vector_Add(&total, &position);
+    }
+    vector_Multiply(&total, 1.0 / batch->nodeCount[lane]);
+    return total;
+}
+
+/**********************************************************//**
+ * @brief Checks whether one creature has run out of energy
+ * and come to rest, the same way as for a single creature.
+ * @param batch: The batch to inspect.
+ * @param lane: The creature within the batch.
+ * @return Whether the creature will not walk any further.
+ **************************************************************/
+static inline bool batch_Settled(const BATCH *batch, int lane) {
+    if (batch->energy[lane] <= MAX_ENERGY) {
+        return false;
+    }
+    for (int i = 0; i < batch->nodeCount[lane]; i++) {
+        if (!iszero(batch->vx[i][lane]) || !iszero(batch->vz[i][lane])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*============================================================*/
+#endif // _BATCH_H_
@@ -0,0 +1,167 @@
+/**********************************************************//**
+ * @file cache.c
+ * @brief Implementation of a bounded fitness cache that many
+ * threads can share without locking.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdint.h>         // uint64_t, uint32_t
+#include <stdlib.h>         // calloc, free
+#include <string.h>         // memcpy
+
+// This project
+#include "debug.h"          // eprintf
+#include "cache.h"          // CACHE
+
+//**************************************************************
+/// Bit of the data word set in every slot that is taken.
+#define SLOT_TAKEN (1ull << 32)
+
+/**********************************************************//**
+ * @brief Reads a slot, which another thread may be writing.
+ * @param slot: The slot to read.
+ * @param key: Location to store the key in the slot.
+ * @return The data word, or 0 if the slot is empty.
+ **************************************************************/
+static inline uint64_t Load(const CACHE_SLOT *slot, uint64_t *key) {
+    uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+    uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+    *key = check ^ data;
+    return data;
+}
+
+/**********************************************************//**
+ * @brief Writes a slot, which other threads may be reading.
+ * @param slot: The slot to write.
+ * @param key: The key.
+ * @param data: The data word.
+ **************************************************************/
+static inline void Store(CACHE_SLOT *slot, uint64_t key, uint64_t data) {
+    __atomic_store_n(&slot->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->data, data, __ATOMIC_RELAXED);
+}
+
+/**********************************************************//**
+ * @brief Gets the slot a key is searched from.
+ * @param cache: The cache to search.
+ * @param key: The key.
+ * @return The index of the home slot.
+ **************************************************************/
+static inline int Home(const CACHE *cache, uint64_t key) {
+    return (int)(key & (uint64_t)(cache->capacity - 1));
+}
+
+/**********************************************************//**
+ * @brief Counts an event in the statistics.
+ * @param counter: The statistic to increment.
+ **************************************************************/
+static inline void Count(long *counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Creation
+ *============================================================*/
+bool cache_Create(CACHE *cache, int capacity) {
+    if (capacity < 1 || capacity > (1 << 30)) {
+        eprintf("Cache capacity must be from 1 to 2^30.\n");
+        return false;
+    }
+    cache->capacity = 1;
+    while (cache->capacity < capacity) {
+        cache->capacity *= 2;
+    }
+    cache->slots = calloc(cache->capacity, sizeof(CACHE_SLOT));
+    if (!cache->slots) {
+        eprintf("Failed to allocate cache slots.\n");
+        return false;
+    }
+    cache_ResetStatistics(cache);
+    return true;
+}
+
+/*============================================================*
+ * Lookup
+ *============================================================*/
+bool cache_Find(CACHE *cache, uint64_t key, float *fitness) {
+    Count(&cache->stats.lookups);
+    int home = Home(cache, key);
+    for (int probe = 0; probe < CACHE_PROBES; probe++) {
+        int slot = (home + probe) & (cache->capacity - 1);
+        uint64_t stored;
+        uint64_t data = Load(&cache->slots[slot], &stored);
+        
+        // Slots are never emptied, so the key is not further on
+        if (!data) {
+            return false;
+        }
+        if (stored == key) {
+            uint32_t bits = (uint32_t)data;
+            memcpy(fitness, &bits, sizeof(float));
+            Count(&cache->stats.hits);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*============================================================*
+ * Insertion
+ *============================================================*/
+void cache_Insert(CACHE *cache, uint64_t key, float fitness) {
+    uint32_t bits;
+    memcpy(&bits, &fitness, sizeof(float));
+    uint64_t data = SLOT_TAKEN | bits;
+    int home = Home(cache, key);
+    Count(&cache->stats.inserts);
+    
+    // Take the key's own slot or the first empty one. Another
+    // thread may take the same empty slot at once, in which
+    // case one of the two entries is lost, which is harmless.
+    for (int probe = 0; probe < CACHE_PROBES; probe++) {
+        int slot = (home + probe) & (cache->capacity - 1);
+        uint64_t stored;
+        if (!Load(&cache->slots[slot], &stored) || stored == key) {
+            Store(&cache->slots[slot], key, data);
+            return;
+        }
+    }
+    
+    // Everything nearby is taken by other keys
+    Store(&cache->slots[home], key, data);
+    Count(&cache->stats.evictions);
+}
+
+/*============================================================*
+ * Statistics
+ *============================================================*/
+void cache_Statistics(const CACHE *cache, CACHE_STATISTICS *stats) {
+    stats->lookups = __atomic_load_n(&cache->stats.lookups, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&cache->stats.hits, __ATOMIC_RELAXED);
+    stats->inserts = __atomic_load_n(&cache->stats.inserts, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&cache->stats.evictions, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Statistics reset
+ *============================================================*/
+void cache_ResetStatistics(CACHE *cache) {
+    __atomic_store_n(&cache->stats.lookups, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->stats.hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->stats.inserts, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache->stats.evictions, 0, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Destruction
+ *============================================================*/
+void cache_Destroy(CACHE *cache) {
+    free(cache->slots);
+    cache->slots = NULL;
+}
+
+/*============================================================*/
@@ -0,0 +1,109 @@
+/**********************************************************//**
+ * @file cache.h
+ * @brief Declaration of a bounded fitness cache that many
+ * threads can share without locking.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdint.h>         // uint64_t
+
+//**************************************************************
+/// @brief Slots searched for a key, starting from its home
+/// slot, before the cache gives up.
+#define CACHE_PROBES 8
+
+/**********************************************************//**
+ * @struct CACHE_STATISTICS
+ * @brief Counts how useful the cache has been.
+ **************************************************************/
+typedef struct {
+    long lookups;           ///< Keys looked up.
+    long hits;              ///< Lookups that found a fitness.
+    long inserts;           ///< Fitnesses stored.
+    long evictions;         ///< Fitnesses overwritten by other keys.
+} CACHE_STATISTICS;
+
+/**********************************************************//**
+ * @struct CACHE_SLOT
+ * @brief One entry of the cache, as two words written one at
+ * a time. The check word is the key mixed with the data word,
+ * so a slot read while another thread is half way through
+ * writing it does not match the key, and the read misses.
+ **************************************************************/
+typedef struct {
+    uint64_t check;         ///< The key exclusive-or the data.
+    uint64_t data;          ///< The fitness and a bit marking the slot taken, or 0 if empty.
+} CACHE_SLOT;
+
+/**********************************************************//**
+ * @struct CACHE
+ * @brief An open-addressing table from 64-bit keys to fitness.
+ * Each slot keeps the whole key, so two keys are never
+ * confused, and no locks are needed. The lower bits of the key
+ * pick the home slot. Once the slots near its home are taken,
+ * a new key overwrites the one in its home slot, so the table
+ * never grows and recent entries are kept.
+ **************************************************************/
+typedef struct {
+    CACHE_SLOT *slots;      ///< Key and fitness of each entry.
+    int capacity;           ///< Number of slots, a power of two.
+    CACHE_STATISTICS stats; ///< Usage since the last reset.
+} CACHE;
+
+/**********************************************************//**
+ * @brief Creates an empty cache.
+ * @param cache: The cache to initialize.
+ * @param capacity: The number of entries to hold, which is
+ * rounded up to a power of two.
+ * @return Whether the cache could be allocated.
+ **************************************************************/
+extern bool cache_Create(CACHE *cache, int capacity);
+
+/**********************************************************//**
+ * @brief Looks up the fitness stored for a key. This may run
+ * concurrently with itself and with cache_Insert.
+ * @param cache: The cache to search.
+ * @param key: The key, such as a genome_Hash.
+ * @param fitness: Location to store the fitness if found.
+ * @return Whether the key was found.
+ **************************************************************/
+extern bool cache_Find(CACHE *cache, uint64_t key, float *fitness);
+
+/**********************************************************//**
+ * @brief Stores the fitness of a key, replacing any fitness
+ * stored for it before. This may run concurrently with itself
+ * and with cache_Find.
+ * @param cache: The cache to store in.
+ * @param key: The key, such as a genome_Hash.
+ * @param fitness: The fitness to store.
+ **************************************************************/
+extern void cache_Insert(CACHE *cache, uint64_t key, float fitness);
+
+/**********************************************************//**
+ * @brief Gets the usage of the cache since the last reset.
+ * @param cache: The cache to inspect.
+ * @param stats: Location to store the statistics.
+ **************************************************************/
+extern void cache_Statistics(const CACHE *cache, CACHE_STATISTICS *stats);
+
+/**********************************************************//**
+ * @brief Zeroes the usage statistics of the cache.
+ * @param cache: The cache to reset.
+ **************************************************************/
+extern void cache_ResetStatistics(CACHE *cache);
+
+/**********************************************************//**
+ * @brief Frees the slots of the cache.
+ * @param cache: The cache to destroy.
+ **************************************************************/
+extern void cache_Destroy(CACHE *cache);
+
+/*============================================================*/
+#endif // _CACHE_H_
@@ -7,6 +7,9 @@
  * @date April 2017
  **************************************************************/
 
+// Standard library
+#include <string.h>         // memcpy, strcmp
+
 // External libraries
 #ifdef WINDOWS
 #include <windows.h>        // OpenGL, GLUT ...
@@ -18,41 +21,56 @@
 #include "debug.h"          // assert, eprintf
 #include "vector.h"         // VECTOR
 #include "integral.h"       // INTEGRAL
-#include "random.h"         // randint
+#include "genome.h"         // GENOME
 #include "creature.h"       // CREATURE
+#include "muscle.h"         // muscle_Forces
 
 //**************************************************************
-/// Forced time step used in discretized updates.
-#define TIME_STEP 0.005
-
-/// @brief Probability that a random action stream will contain
-/// an actual action as opposed to a wait / stop action.
-#define ACTION_DENSITY 0.5
+/// The library integrator, called through a pointer by
+/// INTEGRATOR_POINTER only.
+static INTEGRAL integrate = &MidpointMethod;
 
-/// Bounciness as a node hits the ground.
-#define RESTITUTION 0.6
+/// The integrator every creature is updated with.
+static INTEGRATOR Integrator = INTEGRATOR_MIDPOINT;
 
-/// Gravitational acceleration in the Y direction.
-#define GRAVITY -1.0
+/// @brief The time step every creature is updated with. This is
+/// a double like TIME_STEP so the default rounds the same.
+static double TimeStep = TIME_STEP;
 
-/// Damping force between springs in the creatures.
-#define DAMPING 1.5
+/// Force evaluations each integrator makes per fixed step.
+static const int Evaluations[N_INTEGRATORS] = {
+    [INTEGRATOR_EULER] = 1,
+    [INTEGRATOR_VERLET] = 2,
+    [INTEGRATOR_MIDPOINT] = 1,
+    [INTEGRATOR_RK4] = 4,
+    [INTEGRATOR_IMPLICIT] = 1,
+    [INTEGRATOR_ADAPTIVE] = 4,
+    [INTEGRATOR_POINTER] = 1,
+};
 
-/// Maximum number of mutations per creature.
-#define MAX_MUTATIONS 4
+/// Work done by creature_Update, added to atomically by
+/// creature_Count.
+static STEP_STATISTICS Statistics;
 
-/// Frictional force of the ground.
-#define FRICTION 20.0
+/// Degrees of freedom of the largest creature.
+#define MAX_DOF (3*MAX_NODES)
 
-/// Drag force of the air
-#define DRAG 0.02
+/// Largest error, relative to the state, per adaptive step.
+#define ADAPTIVE_TOLERANCE 1e-2
 
-/// Maximum energy expenditure.
-#define MAX_ENERGY 2048
+/// Smallest step the adaptive integrator takes.
+#define MIN_STEP (TIME_STEP/64)
 
-//**************************************************************
-/// The system integrator
-static INTEGRAL integrate = &MidpointMethod;
+/// Names of the integrators, as accepted on the command line.
+static const char *const IntegratorNames[N_INTEGRATORS] = {
+    [INTEGRATOR_EULER] = "euler",
+    [INTEGRATOR_VERLET] = "verlet",
+    [INTEGRATOR_MIDPOINT] = "midpoint",
+    [INTEGRATOR_RK4] = "rk4",
+    [INTEGRATOR_IMPLICIT] = "implicit",
+    [INTEGRATOR_ADAPTIVE] = "adaptive",
+    [INTEGRATOR_POINTER] = "pointer",
+};
 
 /// Gravity vector.
 static const VECTOR GRAVITY_VECTOR = {0.0, GRAVITY, 0.0};
@@ -88,113 +106,42 @@ void creature_Print(const CREATURE *creature) {
     printf("\n");
 }
 
-/**********************************************************//**
- * @brief Generate a random node. Assume all nodes reside
- * inside the unit hemisphere for simplicity.
- * @param creature: The creature to generate for.
- * @param index: The node to generate.
- **************************************************************/
-static void GenerateNode(CREATURE *creature, int index) {
-    // Node to generate
-    NODE *node = &creature->nodes[index];
-    
-    // Initialize this node's position
-    node->initial.x = uniform(MIN_POSITION, MAX_POSITION);
-    node->initial.y = uniform(0.0, MAX_POSITION);
-    node->initial.z = uniform(MIN_POSITION, MAX_POSITION);
-    
-    // Initial position, velocity, acceleration
-    node->position = node->initial;
-    vector_Set(&node->velocity, 0, 0, 0);
-    vector_Set(&node->acceleration, 0, 0, 0);
-
-    // Random frictionness
-    node->friction = uniform(MIN_FRICTION, MAX_FRICTION);
-}
-
-/**********************************************************//**
- * @brief Generate a random muscle. This must ensure all
- * the nodes are attached to each other so we don't get
- * a weird degenerate creature.
- * @param creature: The creature to generate for.
- * @param index: The muscle to generate.
- **************************************************************/
-static void GenerateMuscle(CREATURE *creature, int index) {
-    // Muscle to generate
-    MUSCLE *muscle = &creature->muscles[index];
-    
-    // Forced muscle connection for each node
-    if (index < creature->nNodes) {
-        muscle->first = index;
-        
-        // Ensure the creature is fully connected. The
-        // proof that this works comes from induction:
-        // if the first n nodes are fully connected and
-        // we must attach node n+1 to one of the previous
-        // n nodes, then the n+1 nodes are fully connected.
-        if (muscle->first > 0) {
-            muscle->second = randint(0, index-1);
-        } else {
-            muscle->second = 0;
-        }
-    } else {
-        muscle->first = randint(0, creature->nNodes-1);
-        muscle->second = randint(0, creature->nNodes-1);
-    }
-    
-    // Ban self-edges from appearing
-    if (muscle->first == muscle->second) {
-        // Jump to next if a self-muscle appears
-        muscle->second = (muscle->second + 1) % creature->nNodes;
-    }
-    
-    // Get the actual muscle length from the initial state.
-    const NODE *first = &creature->nodes[muscle->first];
-    const NODE *second = &creature->nodes[muscle->second];
-    VECTOR delta = second->initial;
-    vector_Subtract(&delta, &first->initial);
-    float length = vector_Length(&delta);
-    
-    // Get random contract or expand lengths
-    muscle->extended = length;
-    muscle->contracted = uniform(length/2.0, length);
-    muscle->isContracted = false;
-    
-    // Random muscle strength
-    muscle->strength = uniform(MIN_STRENGTH, MAX_STRENGTH);
-}
-
 /*============================================================*
- * Random creature generation
+ * Creature from a genome
  *============================================================*/
-void creature_CreateRandom(CREATURE *creature) {
-    // Create random nodes and muscles
-    creature->nNodes = randint(MIN_NODES, MAX_NODES);
-    creature->nMuscles = randint(creature->nNodes, MAX_MUSCLES);
-    creature->clock = 0.0;
-    creature->energy = 0.0;
-    
-    // Generate initial fitness memo.
-    creature->fitness = FITNESS_INVALID;
-    
-    // Generate the creature parts
-    for (int i = 0; i < creature->nNodes; i++) {
-        GenerateNode(creature, i);
+void creature_Create(CREATURE *creature, const GENOME *genome) {
+    // Copy over the genes
+    creature->nNodes = genome->nNodes;
+    creature->nMuscles = genome->nMuscles;
+    for (int i = 0; i < genome->nNodes; i++) {
+        NODE *node = &creature->nodes[i];
+        node->initial = genome->nodes[i].initial;
+        node->friction = genome->nodes[i].friction;
     }
-    for (int i = 0; i < creature->nMuscles; i++) {
-        GenerateMuscle(creature, i);
+    for (int i = 0; i < genome->nMuscles; i++) {
+        MUSCLE *muscle = &creature->muscles[i];
+        const MUSCLE_GENE *gene = &genome->muscles[i];
+        muscle->first = gene->first;
+        muscle->second = gene->second;
+        muscle->extended = gene->extended;
+        muscle->contracted = gene->contracted;
+        muscle->strength = gene->strength;
     }
+    creature->behavior = genome->behavior;
+    creature->fitness = genome->fitness;
     
-    // Make the creature's motion
-    for (int i = 0; i < MAX_ACTIONS; i++) {
-        if (uniform(0.0, 1.0) < ACTION_DENSITY) {
-            // Generate a real action
-            creature->behavior.action[i] = randint(0, creature->nMuscles-1);
-        } else {
-            // Generate a no-op
-            creature->behavior.action[i] = MUSCLE_NONE;
-        }
+    // Relax every muscle, even unused ones, since an energy
+    // death relaxes all of them.
+    for (int i = 0; i < MAX_MUSCLES; i++) {
+        creature->muscles[i].isContracted = false;
     }
+    
+    // Fresh simulation state. The coloring is derived here
+    // rather than stored with the genome, since it is one pass
+    // over the muscles and would only bloat the population.
+    creature_Color(creature);
+    creature_Schedule(creature, &creature->schedule);
+    creature_Reset(creature);
 }
 
 /*============================================================*
@@ -204,6 +151,11 @@ void creature_Reset(CREATURE *creature) {
     // Reset biological clock
     creature->clock = 0.0;
     creature->energy = 0.0;
+    creature->step = 0.0;
+    creature->fixedStep = 0.0;
+    creature->slot = 0;
+    creature->phase = 0.0;
+    creature->work = (STEP_STATISTICS){0};
     
     // Deactivate all muscles
     for (int i = 0; i < creature->nMuscles; i++) {
@@ -220,282 +172,134 @@ void creature_Reset(CREATURE *creature) {
     }
 }
 
-/**********************************************************//**
- * @enum MUTATION
- * @brief Lists all the possible mutations that can occur.
- **************************************************************/
-typedef enum {
-    NODE_ADD,               ///< Add an extra node.
-    NODE_REMOVE,            ///< Delete one of the nodes.
-    NODE_POSITION,          ///< Change the start position of a node.
-    NODE_FRICTION,          ///< Change the friction corfficient of the node.
-    MUSCLE_ANCHOR,          ///< Change where a muscle is attached.
-    MUSCLE_EXTENDED,        ///< Change the muscle extended length.
-    MUSCLE_CONTRACTED,      ///< Change the muscle contract length.
-    MUSCLE_STRENGTH,        ///< Change the muscle power.
-    MUSCLE_ADD,             ///< Add a new muscle.
-    MUSCLE_REMOVE,          ///< Remove one muscle.
-    BEHAVIOR_ADD,           ///< Add an action to the motion.
-    BEHAVIOR_REMOVE,        ///< Remove an action from the motion.
-} MUTATION;
-
-/// The number of unique possible mutations.
-#define N_MUTATIONS 10
-
-/**********************************************************//**
- * @brief Fix all the muscles in the creature, if they point
- * to nodes that no longer exist in the creature.
- * @param creature: The creature to fix.
- **************************************************************/
-static inline void FixMuscles(CREATURE *creature) {
-    for (int i = 0; i < creature->nMuscles; i++) {
-        MUSCLE *muscle = &creature->muscles[i];
-        if (muscle->first >= creature->nNodes || muscle->second >= creature->nNodes) {
-            muscle->first = muscle->first % creature->nNodes;
-            muscle->second = muscle->second % creature->nNodes;
-            if (muscle->first == muscle->second) {
-                muscle->second = (muscle->second + 1) % creature->nNodes;
-            }
-        }
-    }
-}
-    
 /*============================================================*
- * Randomly mutate the creature
+ * Muscle edge coloring
  *============================================================*/
-void creature_Mutate(CREATURE *creature) {
-    // Pick any mutation to occur
-    MUTATION mutation = randint(0, N_MUTATIONS-1);
-    
-    // Pre-generate all the random numbers
-    NODE *node = &creature->nodes[randint(0, creature->nNodes-1)];
-    MUSCLE *muscle = &creature->muscles[randint(0, creature->nMuscles-1)];
-    int action = randint(0, MAX_ACTIONS-1);
-    
-    // Apply the mutations
-    switch (mutation) {
-    case NODE_POSITION:
-        // Change a random node position
-        node->initial.x = uniform(MIN_POSITION, MAX_POSITION);
-        node->initial.y = uniform(0.0, MAX_POSITION);
-        node->initial.z = uniform(MIN_POSITION, MAX_POSITION);
-        break;
-        
-    case NODE_FRICTION:
-        // Change a random node friction
-        node->friction = uniform(MIN_FRICTION, MAX_FRICTION);
-        break;
-    
-    case NODE_ADD:
-        // Add a new node
-        if (creature->nNodes < MAX_NODES) {
-            GenerateNode(creature, creature->nNodes++);
-        }
-        break;
-        
-    case NODE_REMOVE:
-        // Add a new node
-        if (creature->nNodes > MIN_NODES) {
-            creature->nNodes--;
-        }
-        FixMuscles(creature);
-        break;
-    
-    case MUSCLE_ANCHOR:
-        // Changes a random muscle anchor point
-        muscle->second = randint(0, creature->nNodes-1);
-        if (muscle->first == muscle->second) {
-            muscle->second = (muscle->second + 1) % creature->nNodes;
-        }
-        break;
-    
-    case MUSCLE_EXTENDED:
-        // Change a muscle extended length
-        muscle->extended = uniform(muscle->contracted, MAX_MUSCLE_LENGTH);
-        break;
-    
-    case MUSCLE_CONTRACTED:
-        // Change muscle contracted length
-        muscle->contracted = uniform(MIN_CONTRACTED_LENGTH, muscle->extended);
-        break;
-        
-    case MUSCLE_STRENGTH:
-        // Change muscle strength
-        muscle->strength = uniform(MIN_STRENGTH, MAX_STRENGTH);
-        break;
-    
-    case MUSCLE_ADD:
-        // Add a muscle
-        if (creature->nMuscles < MAX_MUSCLES) {
-            GenerateMuscle(creature, creature->nMuscles++);
+void creature_Color(CREATURE *creature) {
+    // Give every muscle the first color free at both nodes
+    // and later than any color already used there.
+    int next[MAX_NODES] = {0};
+    unsigned char color[MAX_MUSCLES];
+    int nColors = 0;
+    for (int i = 0; i < creature->nMuscles; i++) {
+        const MUSCLE *muscle = &creature->muscles[i];
+        int c = next[muscle->first];
+        if (next[muscle->second] > c) {
+            c = next[muscle->second];
         }
-        break;
-    
-    case MUSCLE_REMOVE:
-        // Remove a muscle - but not a base connection
-        // muscle!
-        if (creature->nMuscles > creature->nNodes) {
-            creature->nMuscles--;
+        color[i] = c;
+        next[muscle->first] = c + 1;
+        next[muscle->second] = c + 1;
+        if (c + 1 > nColors) {
+            nColors = c + 1;
         }
-        break;
-    
-    case BEHAVIOR_ADD:
-        // Add  anew action to the stream
-        creature->behavior.action[action] = randint(0, creature->nMuscles-1);
-        break;
-    
-    case BEHAVIOR_REMOVE:
-        // Delete an action from the stream
-        creature->behavior.action[action] = MUSCLE_NONE;
-        break;
+    }
     
-    default:
-        // Should never happen
-        eprintf("Erroneous mutation: %d\n", mutation);
-        break;
+    // Group the muscles by color, keeping index order within
+    // each color.
+    int count[MAX_MUSCLES+1] = {0};
+    for (int i = 0; i < creature->nMuscles; i++) {
+        count[color[i] + 1]++;
+    }
+    for (int c = 0; c < nColors; c++) {
+        count[c + 1] += count[c];
+        creature->colorStart[c] = count[c];
     }
+    creature->colorStart[nColors] = creature->nMuscles;
+    for (int i = 0; i < creature->nMuscles; i++) {
+        creature->colorOrder[count[color[i]]++] = i;
+    }
+    creature->nColors = nColors;
 }
 
 /*============================================================*
- * Creature breeding interchange
+ * Toggle schedule
  *============================================================*/
-void creature_Breed(const CREATURE *mother, const CREATURE *father, CREATURE *child) {
-    // Cross the genetic information of the mother and father to
-    // create child information.
-    
-    // Inherit body structure from either parent
-    if (randint(0, 1)) {
-        child->nNodes = mother->nNodes;
-        child->nMuscles = mother->nMuscles;
-    } else {
-        child->nNodes = father->nNodes;
-        child->nMuscles = father->nMuscles;
-    }
-    child->clock = 0.0;
-    
-    // Generate initial fitness table.
-    child->fitness = FITNESS_INVALID;
-    
-    // Inherit actual node properties.
-    for (int i = 0; i < child->nNodes; i++) {
-        // Inherit this node from either parent
-        const CREATURE *selected;
-        if ((randint(0, 1) == 0 && i < mother->nNodes) || i >= father->nNodes) {
-            selected = mother;
-        } else {
-            selected = father;
+void creature_Schedule(const CREATURE *creature, SCHEDULE *schedule) {
+    int nEvents = 0;
+    for (int i = 0; i < MAX_ACTIONS; i++) {
+        int action = creature->behavior.action[i];
+        if (action < creature->nMuscles) {
+            schedule->slot[nEvents] = i;
+            schedule->muscle[nEvents] = action;
+            nEvents++;
         }
-        
-        // Copy over the node data
-        child->nodes[i] = selected->nodes[i];
     }
-    
-    // Inherit muscles. These guarantee the new child is fully connected
-    // by the proof of either parent's nodes.
-    for (int i = 0; i < child->nMuscles; i++) {
-        // Inherit the muscle from either parent
-        const CREATURE *selected;
-        if ((randint(0, 1) == 0 && i < mother->nMuscles) || i >= father->nMuscles) {
-            selected = mother;
-        } else {
-            selected = father;
+    schedule->nEvents = nEvents;
+}
+
+/**********************************************************//**
+ * @brief Charges the energy the contracting muscles spend over
+ * a step, summed in muscle order.
+ * @param creature: The creature to charge.
+ * @param forces: The muscle forces at the start of the step.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+static inline void Spend(CREATURE *creature, const MUSCLE_FORCES *forces, float dt) {
+    for (int i = 0; i < creature->nMuscles; i++) {
+        const MUSCLE *muscle = &creature->muscles[i];
+        if (muscle->isContracted && !iszero(muscle->strength)) {
+            creature->energy += dt*fabs(forces->magnitude[i]);
         }
-        
-        // Copy over the muscle data, ensuring that the
-        // node indices are actually valid nodes.
-        child->muscles[i] = selected->muscles[i];
-        child->muscles[i].isContracted = false;
-    }
-    
-    // We might need to fix up the muscles if we accidentally inherited a 
-    // muscle that isn't compatible with the child's nodes.
-    FixMuscles(child);
-    
-    // Inherit behaviors: pick a cross-over point within
-    // the action stream and copy.
-    int crossover = randint(0, MAX_ACTIONS-1);
-    for (int j = 0; j < crossover; j++) {
-        child->behavior.action[j] = mother->behavior.action[j];
-    }
-    for (int j = crossover; j < MAX_ACTIONS; j++) {
-        child->behavior.action[j] = father->behavior.action[j];
-    }
-    
-    // Mutate the child at random
-    int nMutations = randint(0, MAX_MUTATIONS);
-    for (int i = 0; i < nMutations; i++) {
-        creature_Mutate(child);
     }
 }
 
- /**********************************************************//**
- * @brief Updates the creature's mass-spring system independent
- * of any discretized time step or animation configuration.
+/**********************************************************//**
+ * @brief Computes the acceleration of every node from the
+ * current state of all of its nodes and muscles. This does not
+ * animate a behavior or change the muscle activation state.
  * @param creature: The creature to update.
- * @param dt: The time step in seconds.
+ * @param forces: Location to store the muscle forces, used to
+ * charge the energy with Spend.
  **************************************************************/
-static void creature_UpdateFull(CREATURE *creature, float dt) {
-    // Updates the creature based on the current state of all
-    // of its nodes and muscles. This update does not attempt
-    // to animate a behavior or make changes to the creature's
-    // muscle activation state.
-    
-    // Zero out all the node accelerations and apply
-    // just the gravitational force.
-    for (int i = 0; i < creature->nNodes; i++) {
-        creature->nodes[i].acceleration = GRAVITY_VECTOR;
-    }
-    
+static inline void Accelerate(CREATURE *creature, MUSCLE_FORCES *forces) {
     // Compute all the muscle forces and apply them
     // as node accelerations. We have already assumed
     // that all nodes have uniform mass for simplicity.
-    for (int i = 0; i < creature->nMuscles; i++) {
-        // Get pointers to all relevant data
-        const MUSCLE *muscle = &creature->muscles[i];
-        NODE *first = &creature->nodes[muscle->first];
-        NODE *second = &creature->nodes[muscle->second];
-        
-        assert(first != second);
-        
-        // No force exterted when muscle has no strength
-        if (iszero(muscle->strength)) {
-            continue;
-        }
-        
-        // Get the current muscle length and normalize the
-        // direction of the muscle.
-        VECTOR delta = second->position;
-        vector_Subtract(&delta, &first->position);
-        float length = vector_Length(&delta);
-        vector_Multiply(&delta, 1.0 / length);
-        
-        // Get the muscle force. The strength is per unit
-        // of target length, so divide that out too.
-        float targetLength = muscle->isContracted? muscle->contracted: muscle->extended;
-        float forceMagnitude = -(muscle->strength/targetLength)*(targetLength - length);
-        
-        // Get the velocity damping force. These velocities are along 
-        // the vector connecting the masses, not in general.
-        float firstVelocity = vector_Dot(&delta, &first->velocity);
-        float secondVelocity = vector_Dot(&delta, &second->velocity);
-        forceMagnitude -= DAMPING*(firstVelocity-secondVelocity);
-
-        // Normalize delta and scale by force magnitude all
-        // in one multiplication step.
-        VECTOR force = delta;
-        vector_Multiply(&force, forceMagnitude);
-        
-        // Apply the force to each of the endpoints, assuming
-        // all the masses are uniform.
-        vector_Add(&first->acceleration, &force);
-        vector_Subtract(&second->acceleration, &force);
-        
-        // Energy expenditure from the muscular force.
-        if (muscle->isContracted) {
-            creature->energy += dt*fabs(forceMagnitude);
+    // The forces are computed several muscles at a time.
+    muscle_Forces(creature->nodes, creature->muscles, creature->nMuscles, forces);
+    if (creature->nColors == COLORS_INVALID) {
+        creature_Color(creature);
+    }
+    
+    // Accumulate the accelerations one color at a time,
+    // starting from just the gravitational force. No two
+    // muscles of a color share a node, so the updates within
+    // a color are independent and may be vectorized.
+    float ax[MAX_NODES];
+    float ay[MAX_NODES];
+    float az[MAX_NODES];
+    for (int i = 0; i < MAX_NODES; i++) {
+        ax[i] = GRAVITY_VECTOR.x;
+        ay[i] = GRAVITY_VECTOR.y;
+        az[i] = GRAVITY_VECTOR.z;
+    }
+    for (int c = 0; c < creature->nColors; c++) {
+        _Pragma("GCC ivdep")
+        for (int k = creature->colorStart[c]; k < creature->colorStart[c+1]; k++) {
+            int i = creature->colorOrder[k];
+            const MUSCLE *muscle = &creature->muscles[i];
+            assert(muscle->first != muscle->second);
+            
+            // No force exterted when muscle has no strength
+            if (iszero(muscle->strength)) {
+                continue;
+            }
+            
+            // Apply the force to each of the endpoints, assuming
+            // all the masses are uniform.
+            ax[muscle->first] += forces->x[i];
+            ay[muscle->first] += forces->y[i];
+            az[muscle->first] += forces->z[i];
+            ax[muscle->second] -= forces->x[i];
+            ay[muscle->second] -= forces->y[i];
+            az[muscle->second] -= forces->z[i];
         }
     }
-
+    for (int i = 0; i < creature->nNodes; i++) {
+        vector_Set(&creature->nodes[i].acceleration, ax[i], ay[i], az[i]);
+    }
+    
     // Apply frictional force based on the contact and
     // current velocity.
     for (int i = 0; i < creature->nNodes; i++) {
@@ -528,32 +332,717 @@ static void creature_UpdateFull(CREATURE *creature, float dt) {
         // Apply the frictional force
         vector_Add(&node->acceleration, &friction);
     }
+}
+
+/**********************************************************//**
+ * @brief Keeps a node above the ground, bouncing it off if it
+ * has gone through.
+ * @param node: The node to check.
+ * @return Whether the node touched the ground.
+ **************************************************************/
+static inline bool Collide(NODE *node) {
+    if (iszero(node->position.y) || node->position.y < 0.0) {
+        node->position.y = 0.0;
+        node->velocity.y *= -RESTITUTION;
+        return true;
+    }
+    return false;
+}
 
-    // Integrate the positions.
-    // TODO time to collision with the ground.
+/**********************************************************//**
+ * @brief Moves the nodes to a trial state part of the way
+ * along a Runge-Kutta or Verlet step.
+ * @param creature: The creature to move.
+ * @param x, v: The state at the start of the step.
+ * @param dx, dv: The position and velocity slopes.
+ * @param h: How far along the step to move.
+ **************************************************************/
+static inline void Trial(CREATURE *creature, const VECTOR *x, const VECTOR *v, const VECTOR *dx, const VECTOR *dv, float h) {
     for (int i = 0; i < creature->nNodes; i++) {
         NODE *node = &creature->nodes[i];
-        integrate(&node->position, &node->velocity, &node->acceleration, dt);
+        node->position = dx[i];
+        vector_Multiply(&node->position, h);
+        vector_Add(&node->position, &x[i]);
+        node->velocity = dv[i];
+        vector_Multiply(&node->velocity, h);
+        vector_Add(&node->velocity, &v[i]);
+    }
+}
+
+/**********************************************************//**
+ * @brief Solves a symmetric positive definite system by
+ * Cholesky factorization, in place.
+ * @param a: The n by n matrix, row major. Its lower triangle
+ * is overwritten by the factor.
+ * @param b: The right hand side, overwritten by the solution.
+ * @param n: The size of the system.
+ * @return Whether the matrix was positive definite.
+ **************************************************************/
+static bool Cholesky(double *a, double *b, int n) {
+    // Factor into L*L^T
+    for (int j = 0; j < n; j++) {
+        double diagonal = a[j*n + j];
+        for (int k = 0; k < j; k++) {
+            diagonal -= a[j*n + k]*a[j*n + k];
+        }
+        if (!(diagonal > 0.0)) {
+            return false;
+        }
+        diagonal = sqrt(diagonal);
+        a[j*n + j] = diagonal;
+        for (int i = j + 1; i < n; i++) {
+            double sum = a[i*n + j];
+            for (int k = 0; k < j; k++) {
+                sum -= a[i*n + k]*a[j*n + k];
+            }
+            a[i*n + j] = sum / diagonal;
+        }
+    }
+    
+    // Forward and back substitution
+    for (int i = 0; i < n; i++) {
+        double sum = b[i];
+        for (int k = 0; k < i; k++) {
+            sum -= a[i*n + k]*b[k];
+        }
+        b[i] = sum / a[i*n + i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        double sum = b[i];
+        for (int k = i + 1; k < n; k++) {
+            sum -= a[k*n + i]*b[k];
+        }
+        b[i] = sum / a[i*n + i];
+    }
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Advances the nodes by one linearly implicit backward
+ * Euler step, given the accelerations at the start of the
+ * step. The forces are linearized about the current state, and
+ * the velocity change dv solves
+ * (I - dt*df/dv - dt^2*df/dx) dv = dt*(f + dt*df/dx*v)
+ * over all 3*nNodes degrees of freedom, which keeps the stiff
+ * muscles stable at several times the explicit time step.
+ * @param creature: The creature to update.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+static void Implicit(CREATURE *creature, float dt) {
+    int n = 3*creature->nNodes;
+    double h = dt;
+    double a[MAX_DOF*MAX_DOF];
+    double b[MAX_DOF];
+    for (int i = 0; i < n*n; i++) {
+        a[i] = 0.0;
+    }
+    for (int i = 0; i < creature->nNodes; i++) {
+        const NODE *node = &creature->nodes[i];
+        b[3*i + 0] = h*node->acceleration.x;
+        b[3*i + 1] = h*node->acceleration.y;
+        b[3*i + 2] = h*node->acceleration.z;
         
-        // Collision check
-        if (iszero(node->position.y) || node->position.y < 0.0) {
-            node->position.y = 0.0;
-            node->velocity.y *= -RESTITUTION;
+        // Air drag and ground friction only depend on the
+        // node's own velocity.
+        double diagonal[3] = {DRAG, DRAG, DRAG};
+        if (iszero(node->position.y) && !iszero(node->friction) && !vector_IsZero(&node->velocity)) {
+            diagonal[0] += FRICTION*node->friction;
+            diagonal[2] += FRICTION*node->friction;
+        }
+        for (int r = 0; r < 3; r++) {
+            a[(3*i + r)*n + 3*i + r] = 1.0 + h*diagonal[r];
         }
     }
+    
+    // Every muscle couples its two nodes. The spring stiffness
+    // across the muscle is dropped while it is compressed, the
+    // usual way to keep the system positive definite.
+    for (int m = 0; m < creature->nMuscles; m++) {
+        const MUSCLE *muscle = &creature->muscles[m];
+        if (iszero(muscle->strength)) {
+            continue;
+        }
+        const NODE *first = &creature->nodes[muscle->first];
+        const NODE *second = &creature->nodes[muscle->second];
+        double d[3] = {
+            second->position.x - first->position.x,
+            second->position.y - first->position.y,
+            second->position.z - first->position.z,
+        };
+        double length = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+        for (int r = 0; r < 3; r++) {
+            d[r] /= length;
+        }
+        double targetLength = muscle->isContracted? muscle->contracted: muscle->extended;
+        double stiffness = muscle->strength/targetLength;
+        double stretch = 1.0 - targetLength/length;
+        if (stretch < 0.0) {
+            stretch = 0.0;
+        }
+        
+        // The block J = df_first/dx_second, and the matching
+        // damping block, fill all four node pairs with signs.
+        double dv[3] = {
+            second->velocity.x - first->velocity.x,
+            second->velocity.y - first->velocity.y,
+            second->velocity.z - first->velocity.z,
+        };
+        int p = 3*muscle->first;
+        int q = 3*muscle->second;
+        for (int r = 0; r < 3; r++) {
+            double jv = 0.0;
+            for (int c = 0; c < 3; c++) {
+                double outer = d[r]*d[c];
+                double spring = stiffness*(outer + stretch*((r == c) - outer));
+                double block = h*DAMPING*outer + h*h*spring;
+                a[(p + r)*n + p + c] += block;
+                a[(q + r)*n + q + c] += block;
+                a[(p + r)*n + q + c] -= block;
+                a[(q + r)*n + p + c] -= block;
+                jv += spring*dv[c];
+            }
+            b[p + r] += h*h*jv;
+            b[q + r] -= h*h*jv;
+        }
+    }
+    
+    // Fall back to an explicit step if the system is singular
+    if (!Cholesky(a, b, n)) {
+        for (int i = 0; i < creature->nNodes; i++) {
+            const VECTOR *acceleration = &creature->nodes[i].acceleration;
+            b[3*i + 0] = h*acceleration->x;
+            b[3*i + 1] = h*acceleration->y;
+            b[3*i + 2] = h*acceleration->z;
+        }
+    }
+    for (int i = 0; i < creature->nNodes; i++) {
+        NODE *node = &creature->nodes[i];
+        VECTOR dv = {b[3*i + 0], b[3*i + 1], b[3*i + 2]};
+        vector_Add(&node->velocity, &dv);
+        VECTOR dx = node->velocity;
+        vector_Multiply(&dx, dt);
+        vector_Add(&node->position, &dx);
+        Collide(node);
+    }
+}
+
+/**********************************************************//**
+ * @brief Advances the mass-spring system by one step with the
+ * given integrator. This is always inlined with a constant
+ * integrator, so every integrator gets its own loops with no
+ * indirect calls, fused with the ground collision.
+ * @param creature: The creature to update.
+ * @param dt: The time step in seconds.
+ * @param integrator: The integration method.
+ **************************************************************/
+__attribute__((always_inline))
+static inline void Step(CREATURE *creature, float dt, INTEGRATOR integrator) {
+    MUSCLE_FORCES forces;
+    Accelerate(creature, &forces);
+    Spend(creature, &forces, dt);
+    switch (integrator) {
+    case INTEGRATOR_EULER:
+        // Semi-implicit Euler, moving with the new velocity
+        for (int i = 0; i < creature->nNodes; i++) {
+            NODE *node = &creature->nodes[i];
+            VECTOR dv = node->acceleration;
+            vector_Multiply(&dv, dt);
+            vector_Add(&node->velocity, &dv);
+            VECTOR dx = node->velocity;
+            vector_Multiply(&dx, dt);
+            vector_Add(&node->position, &dx);
+            Collide(node);
+        }
+        break;
+        
+    case INTEGRATOR_MIDPOINT:
+        // Midpoint method, the same arithmetic as MidpointMethod
+        for (int i = 0; i < creature->nNodes; i++) {
+            NODE *node = &creature->nodes[i];
+            VECTOR *x = &node->position;
+            VECTOR *v = &node->velocity;
+            const VECTOR *a = &node->acceleration;
+            x->x += dt*(v->x + 0.5*dt*a->x);
+            x->y += dt*(v->y + 0.5*dt*a->y);
+            x->z += dt*(v->z + 0.5*dt*a->z);
+            v->x += dt*a->x;
+            v->y += dt*a->y;
+            v->z += dt*a->z;
+            Collide(node);
+        }
+        break;
+        
+    case INTEGRATOR_VERLET: {
+            // Velocity Verlet. The forces at the new positions
+            // are taken with the half step velocity.
+            for (int i = 0; i < creature->nNodes; i++) {
+                NODE *node = &creature->nodes[i];
+                VECTOR dv = node->acceleration;
+                vector_Multiply(&dv, 0.5*dt);
+                vector_Add(&node->velocity, &dv);
+                VECTOR dx = node->velocity;
+                vector_Multiply(&dx, dt);
+                vector_Add(&node->position, &dx);
+            }
+            Accelerate(creature, &forces);
+            for (int i = 0; i < creature->nNodes; i++) {
+                NODE *node = &creature->nodes[i];
+                VECTOR dv = node->acceleration;
+                vector_Multiply(&dv, 0.5*dt);
+                vector_Add(&node->velocity, &dv);
+                Collide(node);
+            }
+            break;
+        }
+        
+    case INTEGRATOR_RK4: {
+            // Classical Runge-Kutta, evaluating the forces at
+            // the start, twice at the middle and at the end.
+            VECTOR x[MAX_NODES];
+            VECTOR v[MAX_NODES];
+            VECTOR kx[4][MAX_NODES];
+            VECTOR kv[4][MAX_NODES];
+            for (int i = 0; i < creature->nNodes; i++) {
+                x[i] = creature->nodes[i].position;
+                v[i] = creature->nodes[i].velocity;
+            }
+            for (int k = 0; k < 4; k++) {
+                if (k > 0) {
+                    Trial(creature, x, v, kx[k-1], kv[k-1], (k < 3)? 0.5*dt: dt);
+                    Accelerate(creature, &forces);
+                }
+                for (int i = 0; i < creature->nNodes; i++) {
+                    kx[k][i] = creature->nodes[i].velocity;
+                    kv[k][i] = creature->nodes[i].acceleration;
+                }
+            }
+            for (int i = 0; i < creature->nNodes; i++) {
+                NODE *node = &creature->nodes[i];
+                VECTOR dx = kx[0][i];
+                VECTOR dv = kv[0][i];
+                for (int k = 1; k < 3; k++) {
+                    vector_Add(&dx, &kx[k][i]);
+                    vector_Add(&dx, &kx[k][i]);
+                    vector_Add(&dv, &kv[k][i]);
+                    vector_Add(&dv, &kv[k][i]);
+                }
+                vector_Add(&dx, &kx[3][i]);
+                vector_Add(&dv, &kv[3][i]);
+                vector_Multiply(&dx, dt/6.0);
+                vector_Multiply(&dv, dt/6.0);
+                node->position = x[i];
+                vector_Add(&node->position, &dx);
+                node->velocity = v[i];
+                vector_Add(&node->velocity, &dv);
+                node->acceleration = kv[0][i];
+                Collide(node);
+            }
+            break;
+        }
+        
+    case INTEGRATOR_IMPLICIT:
+        // Linearly implicit backward Euler
+        Implicit(creature, dt);
+        break;
+        
+    default:
+        // Midpoint method through a function pointer, kept to
+        // compare against.
+        for (int i = 0; i < creature->nNodes; i++) {
+            NODE *node = &creature->nodes[i];
+            integrate(&node->position, &node->velocity, &node->acceleration, dt);
+            Collide(node);
+        }
+        break;
+    }
+}
+
+/**********************************************************//**
+ * @brief Updates the creature's mass-spring system independent
+ * of any discretized time step or animation configuration.
+ * @param creature: The creature to update.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+static void creature_UpdateFull(CREATURE *creature, float dt) {
+    switch (Integrator) {
+    case INTEGRATOR_EULER:
+        Step(creature, dt, INTEGRATOR_EULER);
+        break;
+    case INTEGRATOR_VERLET:
+        Step(creature, dt, INTEGRATOR_VERLET);
+        break;
+    case INTEGRATOR_MIDPOINT:
+        Step(creature, dt, INTEGRATOR_MIDPOINT);
+        break;
+    case INTEGRATOR_RK4:
+        Step(creature, dt, INTEGRATOR_RK4);
+        break;
+    case INTEGRATOR_IMPLICIT:
+        Step(creature, dt, INTEGRATOR_IMPLICIT);
+        break;
+    default:
+        Step(creature, dt, INTEGRATOR_POINTER);
+        break;
+    }
+}
+
+/**********************************************************//**
+ * @brief Moves the nodes to the start of a step plus a
+ * weighted sum of Runge-Kutta stages.
+ * @param creature: The creature to move.
+ * @param x, v: The state at the start of the step.
+ * @param kx, kv: The position and velocity slopes of each
+ * stage.
+ * @param weights: The weight of each stage, times the step.
+ * @param nStages: The number of stages to sum.
+ **************************************************************/
+static inline void Combine(CREATURE *creature, const VECTOR *x, const VECTOR *v,
+        VECTOR kx[][MAX_NODES], VECTOR kv[][MAX_NODES], const double *weights, int nStages) {
+    for (int i = 0; i < creature->nNodes; i++) {
+        double position[3] = {x[i].x, x[i].y, x[i].z};
+        double velocity[3] = {v[i].x, v[i].y, v[i].z};
+        for (int k = 0; k < nStages; k++) {
+            position[0] += weights[k]*kx[k][i].x;
+            position[1] += weights[k]*kx[k][i].y;
+            position[2] += weights[k]*kx[k][i].z;
+            velocity[0] += weights[k]*kv[k][i].x;
+            velocity[1] += weights[k]*kv[k][i].y;
+            velocity[2] += weights[k]*kv[k][i].z;
+        }
+        vector_Set(&creature->nodes[i].position, position[0], position[1], position[2]);
+        vector_Set(&creature->nodes[i].velocity, velocity[0], velocity[1], velocity[2]);
+    }
+}
+
+/**********************************************************//**
+ * @brief Stores the current slopes of the nodes as a stage.
+ * @param creature: The creature to inspect, just accelerated.
+ * @param kx, kv: Location to store the stage.
+ **************************************************************/
+static inline void Slope(const CREATURE *creature, VECTOR *kx, VECTOR *kv) {
+    for (int i = 0; i < creature->nNodes; i++) {
+        kx[i] = creature->nodes[i].velocity;
+        kv[i] = creature->nodes[i].acceleration;
+    }
+}
+
+/**********************************************************//**
+ * @brief Advances the creature by a whole update with the
+ * Bogacki-Shampine 3(2) pair, choosing each step from the
+ * difference between its third and second order solutions.
+ * The last stage of a step is the first of the next, unless a
+ * node touched the ground in between. The step size carries
+ * over to the next update.
+ * @param creature: The creature to update.
+ * @param dt: The time to advance in seconds.
+ * @param stats: Counters to add the work done to.
+ **************************************************************/
+static void Adaptive(CREATURE *creature, float dt, STEP_STATISTICS *stats) {
+    static const double a2[] = {1.0/2.0};
+    static const double a3[] = {0.0, 3.0/4.0};
+    static const double b[] = {2.0/9.0, 1.0/3.0, 4.0/9.0};
+    static const double e[] = {-5.0/72.0, 1.0/12.0, 1.0/9.0, -1.0/8.0};
+    VECTOR x[MAX_NODES];
+    VECTOR v[MAX_NODES];
+    VECTOR kx[4][MAX_NODES];
+    VECTOR kv[4][MAX_NODES];
+    MUSCLE_FORCES forces[2];
+    double weights[4];
+    
+    double h = (creature->step > 0.0)? creature->step: TimeStep;
+    double t = 0.0;
+    bool first = false;
+    while (dt - t > MIN_STEP*1e-3) {
+        double step = (h < dt - t)? h: dt - t;
+        for (int i = 0; i < creature->nNodes; i++) {
+            x[i] = creature->nodes[i].position;
+            v[i] = creature->nodes[i].velocity;
+        }
+        
+        // Stages, reusing the first if it is still valid
+        if (!first) {
+            Accelerate(creature, &forces[0]);
+            Slope(creature, kx[0], kv[0]);
+            stats->evaluations++;
+            first = true;
+        }
+        weights[0] = step*a2[0];
+        Combine(creature, x, v, kx, kv, weights, 1);
+        Accelerate(creature, &forces[1]);
+        Slope(creature, kx[1], kv[1]);
+        weights[0] = step*a3[0];
+        weights[1] = step*a3[1];
+        Combine(creature, x, v, kx, kv, weights, 2);
+        Accelerate(creature, &forces[1]);
+        Slope(creature, kx[2], kv[2]);
+        for (int k = 0; k < 3; k++) {
+            weights[k] = step*b[k];
+        }
+        Combine(creature, x, v, kx, kv, weights, 3);
+        Accelerate(creature, &forces[1]);
+        Slope(creature, kx[3], kv[3]);
+        stats->evaluations += 3;
+        
+        // Error relative to the size of the new state
+        double error = 0.0;
+        for (int i = 0; i < creature->nNodes; i++) {
+            const NODE *node = &creature->nodes[i];
+            const float *position = &node->position.x;
+            const float *velocity = &node->velocity.x;
+            for (int c = 0; c < 3; c++) {
+                double ex = 0.0;
+                double ev = 0.0;
+                for (int k = 0; k < 4; k++) {
+                    ex += step*e[k]*(&kx[k][i].x)[c];
+                    ev += step*e[k]*(&kv[k][i].x)[c];
+                }
+                ex = fabs(ex) / (ADAPTIVE_TOLERANCE*(1.0 + fabs(position[c])));
+                ev = fabs(ev) / (ADAPTIVE_TOLERANCE*(1.0 + fabs(velocity[c])));
+                error = (ex > error)? ex: error;
+                error = (ev > error)? ev: error;
+            }
+        }
+        
+        // Accept the step, or go back and try a smaller one
+        if (error <= 1.0 || step <= MIN_STEP) {
+            Spend(creature, &forces[0], step);
+            t += step;
+            stats->steps++;
+            bool collided = false;
+            for (int i = 0; i < creature->nNodes; i++) {
+                collided |= Collide(&creature->nodes[i]);
+            }
+            
+            // The last stage is the next first stage
+            if (!collided) {
+                memcpy(kx[0], kx[3], sizeof(kx[0]));
+                memcpy(kv[0], kv[3], sizeof(kv[0]));
+                forces[0] = forces[1];
+            }
+            first = !collided;
+        } else {
+            for (int i = 0; i < creature->nNodes; i++) {
+                creature->nodes[i].position = x[i];
+                creature->nodes[i].velocity = v[i];
+            }
+            stats->rejected++;
+        }
+        
+        // Third order steps scale with the cube root of the error
+        double factor = (error > 0.0)? 0.9*pow(error, -1.0/3.0): 5.0;
+        factor = (factor < 0.2)? 0.2: (factor > 5.0)? 5.0: factor;
+        if (step == h || factor < 1.0) {
+            h = step*factor;
+        }
+        h = (h < MIN_STEP)? MIN_STEP: h;
+    }
+    creature->step = h;
+}
+
+/*============================================================*
+ * Integrator selection
+ *============================================================*/
+bool creature_SetIntegrator(INTEGRATOR integrator) {
+    if (integrator < 0 || integrator >= N_INTEGRATORS) {
+        return false;
+    }
+    Integrator = integrator;
+    return true;
+}
+
+/*============================================================*
+ * Selected integrator
+ *============================================================*/
+INTEGRATOR creature_Integrator(void) {
+    return Integrator;
+}
+
+/*============================================================*
+ * Time step selection
+ *============================================================*/
+bool creature_SetTimeStep(double step) {
+    if (!(step > 0.0)) {
+        return false;
+    }
+    TimeStep = step;
+    return true;
+}
+
+/*============================================================*
+ * Selected time step
+ *============================================================*/
+double creature_TimeStep(void) {
+    return TimeStep;
+}
+
+/*============================================================*
+ * Integrator names
+ *============================================================*/
+const char *creature_IntegratorName(INTEGRATOR integrator) {
+    if (integrator < 0 || integrator >= N_INTEGRATORS) {
+        return "unknown";
+    }
+    return IntegratorNames[integrator];
+}
+
+/*============================================================*
+ * Integrator lookup
+ *============================================================*/
+bool creature_FindIntegrator(const char *name, INTEGRATOR *integrator) {
+    for (int i = 0; i < N_INTEGRATORS; i++) {
+        if (!strcmp(name, IntegratorNames[i])) {
+            *integrator = i;
+            return true;
+        }
+    }
+    return false;
 }
 
 /*============================================================*
  * Creature discretized update
  *============================================================*/
 void creature_Update(CREATURE *creature, float dt) {
-    // Forced maximum time step.
-    int fullSteps = (int)(dt / TIME_STEP);
-    float partialStep = fmod(dt, TIME_STEP);
-    for (int i = 0; i < fullSteps; i++) {
-        creature_UpdateFull(creature, TIME_STEP);
+    // The creature's own step replaces the global one
+    double step = (creature->fixedStep > 0.0)? creature->fixedStep: TimeStep;
+    int fullSteps = (int)(dt / step);
+    float partialStep = fmod(dt, step);
+    STEP_STATISTICS stats = {
+        .steps = fullSteps + 1,
+        .evaluations = (fullSteps + 1)*Evaluations[Integrator],
+        .baseline = fullSteps + 1,
+    };
+    if (Integrator == INTEGRATOR_ADAPTIVE) {
+        // Chooses its own steps
+        stats.steps = 0;
+        stats.evaluations = 0;
+        Adaptive(creature, dt, &stats);
+    } else {
+        for (int i = 0; i < fullSteps; i++) {
+            creature_UpdateFull(creature, step);
+        }
+        creature_UpdateFull(creature, partialStep);
+    }
+    
+    // Keep the work until creature_Count
+    creature->work.steps += stats.steps;
+    creature->work.rejected += stats.rejected;
+    creature->work.evaluations += stats.evaluations;
+    creature->work.baseline += stats.baseline;
+}
+
+/*============================================================*
+ * Step counting
+ *============================================================*/
+void creature_Count(CREATURE *creature) {
+    __atomic_fetch_add(&Statistics.steps, creature->work.steps, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.rejected, creature->work.rejected, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.evaluations, creature->work.evaluations, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.baseline, creature->work.baseline, __ATOMIC_RELAXED);
+    creature->work = (STEP_STATISTICS){0};
+}
+
+/*============================================================*
+ * Step statistics
+ *============================================================*/
+void creature_Statistics(STEP_STATISTICS *stats) {
+    stats->steps = __atomic_load_n(&Statistics.steps, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&Statistics.rejected, __ATOMIC_RELAXED);
+    stats->evaluations = __atomic_load_n(&Statistics.evaluations, __ATOMIC_RELAXED);
+    stats->baseline = __atomic_load_n(&Statistics.baseline, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Step statistics reset
+ *============================================================*/
+void creature_ResetStatistics(void) {
+    __atomic_store_n(&Statistics.steps, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.rejected, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.evaluations, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.baseline, 0, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Animation planning
+ *============================================================*/
+void creature_Plan(ANIMATION *animation, const SCHEDULE *schedule, int slot, float phase, float dt) {
+    // Time to the end of this slot, whole slots after it, and
+    // the time into the slot the call ends in. The call always
+    // reaches at least one toggle point and goes on past the
+    // last one, so it may cover more than dt.
+    float before = ACTION_TIME - phase;
+    int last = (int)(dt / ACTION_TIME);
+    float after = fmod(phase+dt, ACTION_TIME);
+    if (dt < before) {
+        // The action still toggles after dt, but the
+        // clock stays within its slot.
+        before = dt;
+        last = 0;
+        after = 0.0;
+        animation->slot = slot;
+        animation->phase = phase + dt;
+    } else {
+        animation->slot = (slot + last + 1) % MAX_ACTIONS;
+        animation->phase = after;
+    }
+    animation->before = before;
+    animation->after = after;
+    animation->last = last;
+    animation->point = -1;
+    animation->done = false;
+    animation->elapsed = before + last*ACTION_TIME + after;
+    
+    // Find the first event at or after this slot, which may
+    // be in the next lap of the behavior.
+    int event = 0;
+    while (event < schedule->nEvents && schedule->slot[event] < slot) {
+        event++;
+    }
+    animation->offset = -slot;
+    if (event == schedule->nEvents) {
+        event = 0;
+        animation->offset += MAX_ACTIONS;
+    }
+    animation->event = event;
+}
+
+/*============================================================*
+ * Animation spans
+ *============================================================*/
+bool creature_NextSpan(ANIMATION *animation, const SCHEDULE *schedule, float *span, int *muscle) {
+    if (animation->done) {
+        return false;
+    }
+    
+    // Toggle point of the next event, if there is one
+    int point = animation->last + 1;
+    if (schedule->nEvents > 0) {
+        point = schedule->slot[animation->event] + animation->offset;
+    }
+    int previous = animation->point;
+    if (point <= animation->last) {
+        // Up to the next event
+        if (previous < 0) {
+            *span = animation->before + point*ACTION_TIME;
+        } else {
+            *span = (point - previous)*ACTION_TIME;
+        }
+        *muscle = schedule->muscle[animation->event];
+        animation->point = point;
+        if (++animation->event == schedule->nEvents) {
+            animation->event = 0;
+            animation->offset += MAX_ACTIONS;
+        }
+    } else {
+        // Up to the end of the call
+        if (previous < 0) {
+            *span = animation->before + animation->last*ACTION_TIME + animation->after;
+        } else {
+            *span = (animation->last - previous)*ACTION_TIME + animation->after;
+        }
+        *muscle = MUSCLE_NONE;
+        animation->done = true;
     }
-    creature_UpdateFull(creature, partialStep);
+    return true;
 }
 
 /*============================================================*
@@ -569,51 +1058,27 @@ void creature_Animate(CREATURE *creature, float dt) {
         creature_Update(creature, dt);
         return;
     }
-    
-    // Get the total number of animation updates within
-    // the given time step.
-    float timeBefore = ACTION_TIME - fmod(creature->clock, ACTION_TIME);
-    int fullActions = (int)(dt / ACTION_TIME);
-    float timeAfter = fmod(creature->clock+dt, ACTION_TIME);
-    if (dt < timeBefore) {
-        timeBefore = dt;
-        fullActions = 0;
-        timeAfter = 0.0;
-    }
-    
-    // Index into the current behavior
-    int animationIndex = (int)(fmod(creature->clock, BEHAVIOR_TIME)/ACTION_TIME);
-    
-    // Animate the current behavior for the remaining "before"
-    // time step, before we flip the action.
-    if (!iszero(timeBefore)) {
-        creature_Update(creature, timeBefore);
-        creature->clock += timeBefore;
+    if (creature->schedule.nEvents == SCHEDULE_INVALID) {
+        creature_Schedule(creature, &creature->schedule);
     }
     
-    // Step all subsequent actions
-    while (fullActions >= 0) {
-        // Animate the next step by flipping the contract flag of the
-        // muscle specified in the action stream.
-        int action = creature->behavior.action[animationIndex];
-        if (action != MUSCLE_NONE) {
-            creature->muscles[action].isContracted = !creature->muscles[action].isContracted;
+    // Integrate without interruption from one muscle toggle
+    // to the next.
+    ANIMATION animation;
+    creature_Plan(&animation, &creature->schedule, creature->slot, creature->phase, dt);
+    float span;
+    int muscle;
+    while (creature_NextSpan(&animation, &creature->schedule, &span, &muscle)) {
+        if (!iszero(span)) {
+            creature_Update(creature, span);
         }
-        
-        // Cycle the action index back around
-        animationIndex = (animationIndex + 1) % MAX_ACTIONS;
-        
-        // Determine if this is a full step or not
-        if (fullActions > 0) {
-            // Doing a full step
-            creature_Update(creature, ACTION_TIME);
-            creature->clock += ACTION_TIME;
-        } else if (!iszero(timeAfter)) {
-            creature_Update(creature, timeAfter);
-            creature->clock += timeAfter;
+        if (muscle != MUSCLE_NONE) {
+            creature->muscles[muscle].isContracted = !creature->muscles[muscle].isContracted;
         }
-        fullActions--;
     }
+    creature->slot = animation.slot;
+    creature->phase = animation.phase;
+    creature->clock += animation.elapsed;
 }
 
 /*============================================================*
@@ -621,6 +1086,13 @@ void creature_Animate(CREATURE *creature, float dt) {
  *============================================================*/
 bool creature_Rest(CREATURE *creature, float dt) {
     creature_Update(creature, dt);
+    return creature_Settled(creature);
+}
+
+/*============================================================*
+ * Rest check
+ *============================================================*/
+bool creature_Settled(const CREATURE *creature) {
     for (int i = 0; i < creature->nNodes; i++) {
         const VECTOR *velocity = &creature->nodes[i].velocity;
         if (!iszero(velocity->x) || !iszero(velocity->z)) {
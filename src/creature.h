@@ -11,10 +11,12 @@
 #define _CREATURE_H_
 
 // Standard library
+#include <stddef.h>         // offsetof
 #include <stdbool.h>        // bool
 
 // This project
 #include "vector.h"         // VECTOR
+#include "genome.h"         // GENOME, MAX_NODES
 
 /**********************************************************//**
  * @struct NODE
@@ -29,17 +31,6 @@ typedef struct {
     float friction;         ///< Coefficient of friction.
 } NODE;
 
-//**************************************************************
-// Node amounts
-#define MIN_NODES 4         ///< Minimum number of NODEs needed per creature.
-#define MAX_NODES 16        ///< Maximum number of NODEs per creature.
-
-// Node properties
-#define MIN_POSITION -1.0   ///< Minimum initial XZ position of a NODE.
-#define MAX_POSITION 1.0    ///< Maximum initial XZ position of a NODE.
-#define MIN_FRICTION 0.1    ///< Minimum friction of a NODE.
-#define MAX_FRICTION 2.0    ///< Maximum friction of a NODE.
-
 /**********************************************************//**
  * @struct MUSCLE
  * @brief Connects two NODE structs together.
@@ -54,47 +45,80 @@ typedef struct {
 } MUSCLE;
 
 //**************************************************************
-/// Maximum number of MUSCLEs per creature.
-#define MAX_MUSCLES 64
-
-/// @brief The maximum number of actions occurring in
-/// one period of a cyclic MOTION.
-#define MAX_ACTIONS 64
-
-// Configurations
-#define MIN_STRENGTH 1.0    ///< The minumum strength of a MUSCLE.
-#define MAX_STRENGTH 20.0   ///< Maximum strength of a MUSCLE.
+/// The actual time spent to perform a BEHAVIOR in seconds.
+#define BEHAVIOR_TIME 1.0
 
-/// The minimum length of a contracted MUSCLE.
-#define MIN_CONTRACTED_LENGTH 0.25
+/// The actual time spent to perform one action.
+#define ACTION_TIME (BEHAVIOR_TIME/MAX_ACTIONS)
 
-/// The minumum length of an extended MUSCLE.
-#define MIN_EXTENDED_LENGTH 0.5
+//**************************************************************
+// Physics, shared by every simulator of the creatures
+#define TIME_STEP 0.005     ///< Default time step used in discretized updates.
+#define RESTITUTION 0.6     ///< Bounciness as a node hits the ground.
+#define GRAVITY -1.0        ///< Gravitational acceleration in the Y direction.
+#define DAMPING 1.5         ///< Damping force between springs in the creatures.
+#define FRICTION 20.0       ///< Frictional force of the ground.
+#define DRAG 0.02           ///< Drag force of the air.
+#define MAX_ENERGY 2048     ///< Maximum energy expenditure.
 
-/// The maximum length of a MUSCLE in any state.
-#define MAX_MUSCLE_LENGTH 2.0
+/**********************************************************//**
+ * @enum INTEGRATOR
+ * @brief Methods of integrating the node motion over a step.
+ **************************************************************/
+typedef enum {
+    INTEGRATOR_EULER,       ///< Semi-implicit Euler, one force evaluation.
+    INTEGRATOR_VERLET,      ///< Velocity Verlet, two force evaluations.
+    INTEGRATOR_MIDPOINT,    ///< Midpoint method, the default.
+    INTEGRATOR_RK4,         ///< Classical Runge-Kutta, four force evaluations.
+    INTEGRATOR_IMPLICIT,    ///< Linearly implicit backward Euler, for long steps.
+    INTEGRATOR_ADAPTIVE,    ///< Bogacki-Shampine 3(2) with error-controlled steps.
+    INTEGRATOR_POINTER,     ///< Midpoint method through an INTEGRAL pointer.
+    N_INTEGRATORS,          ///< Number of integrators.
+} INTEGRATOR;
 
 /**********************************************************//**
- * @struct MOTION
- * @brief Defines a a list of muscle indexes to contract or
- * expand. Each muscle has its state flipped when this occurs.
- * If MUSCLE_NONE is specified, then nothing happens and
- * playback is essentially sustained for that action.
+ * @struct SCHEDULE
+ * @brief Lists the actions of a MOTION that toggle a muscle,
+ * in the order they occur, so playback can skip over the
+ * actions that do nothing.
  **************************************************************/
 typedef struct {
-    /// List of muscle indices to contract or expand.
-    unsigned char action[MAX_ACTIONS];
-} MOTION;
+    int nEvents;            ///< Number of toggling actions, or SCHEDULE_INVALID.
+    unsigned char slot[MAX_ACTIONS];    ///< Action index of each event, ascending.
+    unsigned char muscle[MAX_ACTIONS];  ///< Muscle toggled by each event.
+} SCHEDULE;
 
-//**************************************************************
-/// Signals that no muscle should contract.
-#define MUSCLE_NONE 255
-
-/// The actual time spent to perform a BEHAVIOR in seconds.
-#define BEHAVIOR_TIME 1.0
+/**********************************************************//**
+ * @struct ANIMATION
+ * @brief Walks the toggle events of one creature_Animate call,
+ * as planned by creature_Plan. Actions toggle at the end of
+ * their slot, at the points numbered from 0 to last, and the
+ * time between two points is a whole number of slots.
+ **************************************************************/
+typedef struct {
+    float before;           ///< Time until the first toggle point.
+    float after;            ///< Time after the last toggle point.
+    int last;               ///< Number of the last toggle point.
+    int point;              ///< Point of the previous event, or -1 at the start.
+    int event;              ///< Next event in the schedule.
+    int offset;             ///< Point of the schedule's slot 0 in this lap.
+    bool done;              ///< Whether the last span was returned.
+    int slot;               ///< Slot the creature ends up in.
+    float phase;            ///< Time the creature ends up into its slot.
+    float elapsed;          ///< Time the creature's clock advances.
+} ANIMATION;
 
-/// The actual time spent to perform one action.
-#define ACTION_TIME (BEHAVIOR_TIME/MAX_ACTIONS)
+/**********************************************************//**
+ * @struct STEP_STATISTICS
+ * @brief Counts the work creature_Update has done, for one
+ * creature or across all threads of this process.
+ **************************************************************/
+typedef struct {
+    long steps;             ///< Steps taken.
+    long rejected;          ///< Adaptive steps rejected and retried.
+    long evaluations;       ///< Force evaluations.
+    long baseline;          ///< Steps a fixed creature_TimeStep would take.
+} STEP_STATISTICS;
 
 /**********************************************************//**
  * @struct CREATURE
@@ -110,17 +134,40 @@ typedef struct {
     MUSCLE muscles[MAX_MUSCLES];    ///< MUSCLE data for one creature.
     MOTION behavior;        ///< MOTION data for each distinct hehavior.
     float fitness;          ///< Buffered fitness data.
+    
+    // Cached muscle edge coloring, see creature_Color
+    int nColors;            ///< Number of color classes, or COLORS_INVALID.
+    unsigned char colorStart[MAX_MUSCLES+1];    ///< Where each class begins in colorOrder.
+    unsigned char colorOrder[MAX_MUSCLES];      ///< Muscle indices grouped by color.
+    
+    // Simulation state not saved to files
+    float step;             ///< Last adaptive step size, or 0 if none yet.
+    float fixedStep;        ///< Fixed step used instead of creature_TimeStep, or 0 for none.
+    int slot;               ///< Action slot the clock is in.
+    float phase;            ///< Time the clock is into its slot.
+    SCHEDULE schedule;      ///< Cached toggle events, see creature_Schedule.
+    STEP_STATISTICS work;   ///< Work done but not yet counted, see creature_Count.
 } CREATURE;
 
 //**************************************************************
-/// Invalid fitness amount.
-#define FITNESS_INVALID -1.0
+/// @brief Marks the muscle coloring as out of date. A creature
+/// without muscles has no colors, so this cannot be 0.
+#define COLORS_INVALID -1
+
+/// Marks the toggle schedule as out of date.
+#define SCHEDULE_INVALID -1
+
+/// @brief Bytes of a CREATURE saved to a file. The cached data
+/// at the end is left out, so older files still load.
+#define CREATURE_FILE_SIZE offsetof(CREATURE, nColors)
 
 /**********************************************************//**
- * @brief Generates an entirely random creature.
+ * @brief Grows a creature from its genome, ready to simulate.
  * @param creature: Data is stored at this location.
+ * @param genome: The genes to grow the creature from. The
+ * memoized fitness is copied along with them.
  **************************************************************/
-extern void creature_CreateRandom(CREATURE *creature);
+extern void creature_Create(CREATURE *creature, const GENOME *genome);
 
 /**********************************************************//**
  * @brief Resets the creature state and finds a stable
@@ -130,26 +177,131 @@ extern void creature_CreateRandom(CREATURE *creature);
 extern void creature_Reset(CREATURE *creature);
 
 /**********************************************************//**
- * @brief Applies a random mutation to some aspect of the
- * creature. This can mutate the initial node position,
- * node friction, muscle properties and attachment, and
- * actions found within a behavior.
- * @param creature: The data to mutate.
+ * @brief Colors the muscles so that no two muscles of the
+ * same color share a node. Each muscle takes the first color
+ * after every color already used at either of its nodes, so
+ * a node meets its muscles in the same order by color as by
+ * index and forces summed one color at a time round exactly
+ * as when summed one muscle at a time. This is done when the
+ * creature is created from its genome or loaded, and again on
+ * first use if it is out of date.
+ * @param creature: The creature to color.
+ **************************************************************/
+extern void creature_Color(CREATURE *creature);
+
+/**********************************************************//**
+ * @brief Compiles the behavior of a creature into the sorted
+ * list of actions that toggle a muscle. Actions on muscles
+ * the creature does not have, left behind when a muscle was
+ * removed, do nothing and are dropped. This is done when the
+ * creature is created from its genome or loaded, and again on
+ * first use if it is out of date.
+ * @param creature: The creature whose behavior to compile.
+ * @param schedule: Location to store the events, usually the
+ * creature's own schedule.
+ **************************************************************/
+extern void creature_Schedule(const CREATURE *creature, SCHEDULE *schedule);
+
+/**********************************************************//**
+ * @brief Plans one creature_Animate call: the same toggles at
+ * the same times as when every action slot was stepped on its
+ * own, but found from the slot and phase rather than from the
+ * float clock.
+ * @param animation: Location to store the plan.
+ * @param schedule: The events of the creature's behavior.
+ * @param slot: The action slot the creature is in.
+ * @param phase: The time the creature is into its slot.
+ * @param dt: The time step in seconds.
+ **************************************************************/
+extern void creature_Plan(ANIMATION *animation, const SCHEDULE *schedule, int slot, float phase, float dt);
+
+/**********************************************************//**
+ * @brief Gets the next stretch of time to integrate without
+ * interruption, and the muscle to toggle after it.
+ * @param animation: The plan to advance.
+ * @param schedule: The events the plan was made with.
+ * @param span: Location to store the time in seconds, which
+ * may be zero.
+ * @param muscle: Location to store the muscle to toggle, or
+ * MUSCLE_NONE after the last span.
+ * @return Whether there was another span.
+ **************************************************************/
+extern bool creature_NextSpan(ANIMATION *animation, const SCHEDULE *schedule, float *span, int *muscle);
+
+/**********************************************************//**
+ * @brief Changes the integrator every creature is updated
+ * with. Not thread safe; call it before any creatures are
+ * simulated.
+ * @param integrator: The integrator to use.
+ * @return Whether the integrator exists.
+ **************************************************************/
+extern bool creature_SetIntegrator(INTEGRATOR integrator);
+
+/**********************************************************//**
+ * @brief Gets the integrator creatures are updated with.
+ * @return The selected integrator.
+ **************************************************************/
+extern INTEGRATOR creature_Integrator(void);
+
+/**********************************************************//**
+ * @brief Changes the largest time step creature_Update takes.
+ * Explicit integrators go unstable well before the implicit
+ * one does. Steps longer than ACTION_TIME gain little, since
+ * the muscles may toggle that often. Not thread safe; call it
+ * before any creatures are simulated.
+ * @param step: The time step in seconds.
+ * @return Whether the time step is positive.
+ **************************************************************/
+extern bool creature_SetTimeStep(double step);
+
+/**********************************************************//**
+ * @brief Gets the time step creature_Update takes.
+ * @return The time step in seconds, TIME_STEP by default.
  **************************************************************/
-extern void creature_Mutate(CREATURE *creature);
+extern double creature_TimeStep(void);
 
 /**********************************************************//**
- * @brief Recombines the parent properties to create a child
- * CREATURE.
- * @param mother: The data of one parent.
- * @param father: The data of the other parent.
- * @param child: Location to stor the child data at.
+ * @brief Gets the work creature_Update has done since the
+ * last reset. Work done in other processes is not counted.
+ * @param stats: Location to store the counters.
  **************************************************************/
-extern void creature_Breed(const CREATURE *mother, const CREATURE *father, CREATURE *child);
+extern void creature_Statistics(STEP_STATISTICS *stats);
+
+/**********************************************************//**
+ * @brief Sets the creature_Update work counters to zero.
+ **************************************************************/
+extern void creature_ResetStatistics(void);
+
+/**********************************************************//**
+ * @brief Adds the work a creature has done since it was last
+ * counted to the counters of the process. creature_Update
+ * only keeps the work in the creature, so the shared counters
+ * are written once per walk rather than once per update.
+ * @param creature: The creature whose work to count.
+ **************************************************************/
+extern void creature_Count(CREATURE *creature);
+
+/**********************************************************//**
+ * @brief Gets the name of an integrator.
+ * @param integrator: The integrator to name.
+ * @return The name of the integrator.
+ **************************************************************/
+extern const char *creature_IntegratorName(INTEGRATOR integrator);
+
+/**********************************************************//**
+ * @brief Looks up an integrator by name.
+ * @param name: The name, as from creature_IntegratorName.
+ * @param integrator: Location to store the integrator.
+ * @return Whether there is an integrator with that name.
+ **************************************************************/
+extern bool creature_FindIntegrator(const char *name, INTEGRATOR *integrator);
 
 /**********************************************************//**
  * @brief Updates the creature's mass-spring system. This
- * upsate is discretized to use the given TIME_STEP variable.
+ * upsate is discretized to use the creature_TimeStep step,
+ * or the creature's own fixedStep instead when it has one,
+ * whether it is larger or smaller. The adaptive integrator
+ * chooses its own steps and ignores both.
  * @param creature: The creature to update.
  * @param dt: The time step in seconds.
  **************************************************************/
@@ -171,6 +323,14 @@ extern void creature_Animate(CREATURE *creature, float dt);
  **************************************************************/
 extern bool creature_Rest(CREATURE *creature, float dt);
 
+/**********************************************************//**
+ * @brief Checks whether the creature has stopped moving along
+ * the ground. Bouncing in place is ignored.
+ * @param creature: The creature to inspect.
+ * @return Whether no node moves in the X or Z direction.
+ **************************************************************/
+extern bool creature_Settled(const CREATURE *creature);
+
 /**********************************************************//**
  * @brief Draw the creature on the screen.
  * @param creature: The creature to render.
@@ -0,0 +1,618 @@
+/**********************************************************//**
+ * @file farm.c
+ * @brief Implementation of a farm of worker processes that
+ * evaluate fitness out of the main address space.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdbool.h>        // bool
+#include <stdint.h>         // uint32_t
+#include <stdio.h>          // fflush
+#include <stdlib.h>         // malloc, realloc
+#include <string.h>         // memcpy
+#include <math.h>           // INFINITY
+#include <errno.h>          // errno, EINTR
+
+// External libraries
+#ifndef WINDOWS
+#include <unistd.h>         // fork, read, close, _exit
+#include <signal.h>         // kill, signal, SIGKILL, SIGCHLD
+#include <poll.h>           // poll
+#include <sys/socket.h>     // socketpair, send, sendmsg, recvmsg
+#include <sys/wait.h>       // waitpid, wait
+#endif
+
+// This project
+#include "debug.h"          // eprintf
+#include "farm.h"           // FARM
+
+#ifndef WINDOWS
+//**************************************************************
+/// Deaths a batch may cause before it is split up, and deaths
+/// a single entity may cause before it is given up on.
+#define FARM_RETRIES 2
+
+/// Size of the count and size fields of a message.
+#define HEADER_SIZE sizeof(uint32_t)
+
+/**********************************************************//**
+ * @brief Writes a whole buffer to a socket.
+ * @param fd: The socket.
+ * @param buffer: The bytes to write.
+ * @param size: The number of bytes.
+ * @return Whether everything was written.
+ **************************************************************/
+static bool WriteAll(int fd, const void *buffer, size_t size) {
+    const char *bytes = (const char *)buffer;
+    while (size > 0) {
+        // The peer may be dead, which must not kill us
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Reads a whole buffer from a socket.
+ * @param fd: The socket.
+ * @param buffer: Location to store the bytes.
+ * @param size: The number of bytes.
+ * @return Whether everything was read before end of file.
+ **************************************************************/
+static bool ReadAll(int fd, void *buffer, size_t size) {
+    char *bytes = (char *)buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Serves batches until the coordinator hangs up. A
+ * batch is a count followed by that many (size, bytes)
+ * entities, and the answer is a count followed by that many
+ * floats.
+ * @param request: The farm configuration.
+ * @param fd: The worker end of the socket.
+ * @return Whether the worker shut down cleanly.
+ **************************************************************/
+static bool Serve(const FARM_REQUEST *request, int fd) {
+    void *entity = malloc(request->entitySize);
+    unsigned char *wire = malloc(request->wireSize);
+    float *fitness = malloc(sizeof(float)*request->batchSize);
+    bool success = (entity && wire && fitness);
+
+    uint32_t count;
+    while (success && ReadAll(fd, &count, HEADER_SIZE)) {
+        if (count > (uint32_t)request->batchSize) {
+            success = false;
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t size;
+            if (!ReadAll(fd, &size, HEADER_SIZE) || size > request->wireSize || !ReadAll(fd, wire, size)) {
+                success = false;
+                break;
+            }
+            if (request->decode(entity, wire, size)) {
+                fitness[i] = request->fitness(entity);
+            } else {
+                fitness[i] = INFINITY;
+            }
+        }
+        if (!success || !WriteAll(fd, &count, HEADER_SIZE) || !WriteAll(fd, fitness, sizeof(float)*count)) {
+            success = false;
+        }
+    }
+
+    free(entity);
+    free(wire);
+    free(fitness);
+    return success;
+}
+
+/**********************************************************//**
+ * @brief Passes a socket to another process.
+ * @param fd: The socket to send over.
+ * @param socket: The socket to pass, unless pid is negative.
+ * @param pid: The process at the other end of the socket, or
+ * -1 if it could not be started.
+ * @return Whether the message was sent.
+ **************************************************************/
+static bool SendSocket(int fd, int socket, pid_t pid) {
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct iovec data = {.iov_base = &pid, .iov_len = sizeof(pid)};
+    struct msghdr message = {.msg_iov = &data, .msg_iovlen = 1};
+    if (pid >= 0) {
+        message.msg_control = control.space;
+        message.msg_controllen = sizeof(control.space);
+        struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(header), &socket, sizeof(int));
+    }
+    ssize_t n;
+    while ((n = sendmsg(fd, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    return (n == sizeof(pid));
+}
+
+/**********************************************************//**
+ * @brief Receives a socket passed by SendSocket.
+ * @param fd: The socket to receive from.
+ * @param socket: Location to store the socket.
+ * @param pid: Location to store the process at its other end.
+ * @return Whether a socket arrived.
+ **************************************************************/
+static bool ReceiveSocket(int fd, int *socket, pid_t *pid) {
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct iovec data = {.iov_base = pid, .iov_len = sizeof(*pid)};
+    struct msghdr message = {
+        .msg_iov = &data,
+        .msg_iovlen = 1,
+        .msg_control = control.space,
+        .msg_controllen = sizeof(control.space),
+    };
+    ssize_t n;
+    while ((n = recvmsg(fd, &message, 0)) < 0 && errno == EINTR);
+    if (n != sizeof(*pid) || *pid < 0) {
+        return false;
+    }
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS) {
+        return false;
+    }
+    memcpy(socket, CMSG_DATA(header), sizeof(int));
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Starts workers until the coordinator hangs up. The
+ * spawner is forked before the coordinator starts any threads
+ * and never starts any itself, so every worker is forked from
+ * a single threaded process, however many threads the
+ * coordinator has when it asks for one. Each request is a
+ * worker index, and the answer is the coordinator end of the
+ * worker's socket. The workers are reaped as they exit.
+ * @param request: The farm configuration.
+ * @param fd: The spawner end of the socket.
+ **************************************************************/
+static void Spawner(const FARM_REQUEST *request, int fd) {
+    signal(SIGCHLD, SIG_IGN);
+    uint32_t index;
+    while (ReadAll(fd, &index, HEADER_SIZE)) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+            if (!SendSocket(fd, -1, -1)) {
+                break;
+            }
+            continue;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            // Only keep our own end of our own socket, so a
+            // worker sees end of file as soon as the
+            // coordinator closes it
+            signal(SIGCHLD, SIG_DFL);
+            close(fd);
+            close(sockets[0]);
+            bool success = Serve(request, sockets[1]);
+            _exit(success? EXIT_SUCCESS: EXIT_FAILURE);
+        }
+        close(sockets[1]);
+        bool sent = SendSocket(fd, sockets[0], child);
+        close(sockets[0]);
+        if (!sent) {
+            break;
+        }
+    }
+    
+    // Only exit once every worker has
+    close(fd);
+    while (wait(NULL) >= 0 || errno == EINTR);
+}
+
+/**********************************************************//**
+ * @brief Starts the process that forks the workers.
+ * @param farm: The farm data.
+ * @return Whether the spawner started.
+ **************************************************************/
+static bool StartSpawner(FARM *farm) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+        eprintf("Failed to create socket for the worker spawner.\n");
+        return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child == 0) {
+        close(sockets[0]);
+        Spawner(&farm->request, sockets[1]);
+        _exit(EXIT_SUCCESS);
+    } else if (child < 0) {
+        eprintf("Failed to start the worker spawner.\n");
+        close(sockets[0]);
+        close(sockets[1]);
+        return false;
+    }
+    close(sockets[1]);
+    farm->spawner = child;
+    farm->spawnerSocket = sockets[0];
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Starts a worker process in the given slot, forked by
+ * the spawner, so this is safe with threads running.
+ * @param farm: The farm data.
+ * @param w: The worker index.
+ * @return Whether the worker started.
+ **************************************************************/
+static bool Spawn(FARM *farm, int w) {
+    FARM_WORKER *worker = &farm->workers[w];
+    worker->pid = -1;
+    worker->socket = -1;
+    worker->batch = -1;
+    uint32_t index = w;
+    pid_t pid;
+    int socket;
+    if (!WriteAll(farm->spawnerSocket, &index, HEADER_SIZE) || !ReceiveSocket(farm->spawnerSocket, &socket, &pid)) {
+        eprintf("Failed to start worker %d.\n", w);
+        return false;
+    }
+    worker->pid = pid;
+    worker->socket = socket;
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Kills a worker. The spawner reaps it.
+ * @param worker: The worker to stop.
+ **************************************************************/
+static void Reap(FARM_WORKER *worker) {
+    if (worker->socket >= 0) {
+        close(worker->socket);
+        worker->socket = -1;
+    }
+    if (worker->pid > 0) {
+        kill(worker->pid, SIGKILL);
+        worker->pid = -1;
+    }
+}
+
+/**********************************************************//**
+ * @brief Adds a batch to the current evaluation.
+ * @param farm: The farm data.
+ * @param start: The first entity of the batch.
+ * @param count: The number of entities.
+ * @param failures: Deaths the entities have caused so far.
+ * @return Whether there was memory for the batch.
+ **************************************************************/
+static bool AddBatch(FARM *farm, int start, int count, int failures) {
+    if (farm->nBatches >= farm->batchCapacity) {
+        int capacity = 2*farm->batchCapacity + 16;
+        FARM_BATCH *batches = realloc(farm->batches, sizeof(FARM_BATCH)*capacity);
+        if (!batches) {
+            return false;
+        }
+        farm->batches = batches;
+        int *pending = realloc(farm->pending, sizeof(int)*capacity);
+        if (!pending) {
+            return false;
+        }
+        farm->pending = pending;
+        farm->batchCapacity = capacity;
+    }
+    FARM_BATCH *batch = &farm->batches[farm->nBatches];
+    batch->start = start;
+    batch->count = count;
+    batch->failures = failures;
+    farm->pending[farm->nPending++] = farm->nBatches++;
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Sends a batch to an idle worker.
+ * @param farm: The farm data.
+ * @param w: The worker index.
+ * @param b: The batch index.
+ * @param entities: The entities being evaluated.
+ * @return Whether the whole batch was sent.
+ **************************************************************/
+static bool Dispatch(FARM *farm, int w, int b, void *const *entities) {
+    const FARM_BATCH *batch = &farm->batches[b];
+    unsigned char *buffer = farm->buffer;
+    uint32_t count = batch->count;
+    memcpy(buffer, &count, HEADER_SIZE);
+    size_t offset = HEADER_SIZE;
+    for (int i = 0; i < batch->count; i++) {
+        uint32_t size = farm->request.encode(entities[batch->start + i], buffer + offset + HEADER_SIZE);
+        memcpy(buffer + offset, &size, HEADER_SIZE);
+        offset += HEADER_SIZE + size;
+    }
+    farm->workers[w].batch = b;
+    return WriteAll(farm->workers[w].socket, buffer, offset);
+}
+
+/**********************************************************//**
+ * @brief Reads the answer to a batch from a worker.
+ * @param farm: The farm data.
+ * @param w: The worker index.
+ * @param fitness: The fitness of every entity being evaluated.
+ * @return Whether the whole answer arrived.
+ **************************************************************/
+static bool Collect(FARM *farm, int w, float *fitness) {
+    FARM_WORKER *worker = &farm->workers[w];
+    const FARM_BATCH *batch = &farm->batches[worker->batch];
+    uint32_t count;
+    if (!ReadAll(worker->socket, &count, HEADER_SIZE) || count != (uint32_t)batch->count) {
+        return false;
+    }
+    if (!ReadAll(worker->socket, fitness + batch->start, sizeof(float)*count)) {
+        return false;
+    }
+    worker->batch = -1;
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Replaces a dead worker and reschedules its batch.
+ * A batch that has killed too many workers is split into
+ * single entities, and a single entity that has done so is
+ * given up on with INFINITY fitness.
+ * @param farm: The farm data.
+ * @param w: The worker index.
+ * @param fitness: The fitness of every entity being evaluated.
+ * @return The number of entities given up on, or -1 if out
+ * of memory.
+ **************************************************************/
+static int Recover(FARM *farm, int w, float *fitness) {
+    FARM_WORKER *worker = &farm->workers[w];
+    int b = worker->batch;
+    Reap(worker);
+    farm->respawns++;
+    Spawn(farm, w);
+    if (b < 0) {
+        return 0;
+    }
+
+    FARM_BATCH batch = farm->batches[b];
+    batch.failures++;
+    if (batch.failures < FARM_RETRIES) {
+        return AddBatch(farm, batch.start, batch.count, batch.failures)? 0: -1;
+    } else if (batch.count > 1) {
+        for (int i = 0; i < batch.count; i++) {
+            if (!AddBatch(farm, batch.start + i, 1, 0)) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    eprintf("Entity %d killed %d workers.\n", batch.start, batch.failures);
+    fitness[batch.start] = INFINITY;
+    farm->failures++;
+    return 1;
+}
+
+/*============================================================*
+ * Creation
+ *============================================================*/
+bool farm_Create(FARM *farm, const FARM_REQUEST *request) {
+    if (request->nWorkers < 1 || request->batchSize < 1 || !request->encode || !request->decode || !request->fitness) {
+        eprintf("Invalid farm configuration.\n");
+        return false;
+    }
+    farm->request = *request;
+    farm->batches = NULL;
+    farm->nBatches = 0;
+    farm->batchCapacity = 0;
+    farm->pending = NULL;
+    farm->nPending = 0;
+    farm->respawns = 0;
+    farm->failures = 0;
+    farm->spawner = -1;
+    farm->spawnerSocket = -1;
+
+    // The same buffer carries batches out and answers back
+    size_t size = HEADER_SIZE + request->batchSize*(HEADER_SIZE + request->wireSize);
+    farm->buffer = malloc(size);
+    farm->workers = malloc(sizeof(FARM_WORKER)*request->nWorkers);
+    if (!farm->buffer || !farm->workers) {
+        eprintf("Failed to allocate farm.\n");
+        free(farm->buffer);
+        free(farm->workers);
+        return false;
+    }
+    for (int w = 0; w < request->nWorkers; w++) {
+        farm->workers[w].pid = -1;
+        farm->workers[w].socket = -1;
+        farm->workers[w].batch = -1;
+    }
+
+    // Start every worker
+    if (!StartSpawner(farm)) {
+        farm_Destroy(farm);
+        return false;
+    }
+    for (int w = 0; w < request->nWorkers; w++) {
+        if (!Spawn(farm, w)) {
+            farm_Destroy(farm);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*============================================================*
+ * Evaluation
+ *============================================================*/
+bool farm_Evaluate(FARM *farm, void *const *entities, int count, float *fitness) {
+    const FARM_REQUEST *request = &farm->request;
+
+    // Split the entities into batches. The stack is filled
+    // backwards so batches go out in order.
+    farm->nBatches = 0;
+    farm->nPending = 0;
+    int nBatches = (count + request->batchSize - 1) / request->batchSize;
+    for (int b = nBatches - 1; b >= 0; b--) {
+        int start = b*request->batchSize;
+        int size = (start + request->batchSize < count)? request->batchSize: count - start;
+        if (!AddBatch(farm, start, size, 0)) {
+            eprintf("Failed to allocate farm batches.\n");
+            return false;
+        }
+    }
+
+    struct pollfd *polls = malloc(sizeof(struct pollfd)*request->nWorkers);
+    int *polled = malloc(sizeof(int)*request->nWorkers);
+    if (!polls || !polled) {
+        eprintf("Failed to allocate farm poll list.\n");
+        free(polls);
+        free(polled);
+        return false;
+    }
+
+    int remaining = count;
+    bool success = true;
+    while (success && remaining > 0) {
+        // Hand out work to every idle worker, replacing any
+        // worker that has died in the meantime
+        for (int w = 0; w < request->nWorkers && farm->nPending > 0; w++) {
+            FARM_WORKER *worker = &farm->workers[w];
+            if (worker->pid < 0 && !Spawn(farm, w)) {
+                continue;
+            } else if (worker->batch >= 0) {
+                continue;
+            }
+            int b = farm->pending[--farm->nPending];
+            if (!Dispatch(farm, w, b, entities)) {
+                int lost = Recover(farm, w, fitness);
+                success = (lost >= 0);
+                remaining -= (lost > 0)? lost: 0;
+            }
+        }
+
+        // Wait for answers from the busy workers
+        int nPolled = 0;
+        for (int w = 0; w < request->nWorkers; w++) {
+            if (farm->workers[w].batch >= 0) {
+                polls[nPolled].fd = farm->workers[w].socket;
+                polls[nPolled].events = POLLIN;
+                polls[nPolled].revents = 0;
+                polled[nPolled++] = w;
+            }
+        }
+        if (nPolled == 0) {
+            if (remaining > 0) {
+                eprintf("No farm workers could be started.\n");
+                success = false;
+            }
+            continue;
+        }
+        if (poll(polls, nPolled, -1) < 0) {
+            if (errno != EINTR) {
+                eprintf("Failed to wait for farm workers.\n");
+                success = false;
+            }
+            continue;
+        }
+
+        // Gather results, and recover from anyone who hung up
+        for (int i = 0; i < nPolled; i++) {
+            if (!polls[i].revents) {
+                continue;
+            }
+            int w = polled[i];
+            int size = farm->batches[farm->workers[w].batch].count;
+            if (Collect(farm, w, fitness)) {
+                remaining -= size;
+            } else {
+                int lost = Recover(farm, w, fitness);
+                success = success && (lost >= 0);
+                remaining -= (lost > 0)? lost: 0;
+            }
+        }
+    }
+
+    free(polls);
+    free(polled);
+    return success;
+}
+
+/*============================================================*
+ * Destruction
+ *============================================================*/
+void farm_Destroy(FARM *farm) {
+    // Hanging up tells every worker to exit
+    for (int w = 0; w < farm->request.nWorkers; w++) {
+        if (farm->workers[w].socket >= 0) {
+            close(farm->workers[w].socket);
+            farm->workers[w].socket = -1;
+        }
+    }
+    
+    // The spawner waits for the workers before it exits
+    if (farm->spawnerSocket >= 0) {
+        close(farm->spawnerSocket);
+        farm->spawnerSocket = -1;
+    }
+    if (farm->spawner > 0) {
+        while (waitpid(farm->spawner, NULL, 0) < 0 && errno == EINTR);
+        farm->spawner = -1;
+    }
+    free(farm->workers);
+    free(farm->buffer);
+    free(farm->batches);
+    free(farm->pending);
+}
+
+#else
+/*============================================================*
+ * Farm stub
+ *============================================================*/
+bool farm_Create(FARM *farm, const FARM_REQUEST *request) {
+    (void)farm;
+    (void)request;
+    eprintf("Evaluation farm requires fork and Unix domain sockets.\n");
+    return false;
+}
+
+bool farm_Evaluate(FARM *farm, void *const *entities, int count, float *fitness) {
+    (void)farm;
+    (void)entities;
+    (void)count;
+    (void)fitness;
+    return false;
+}
+
+void farm_Destroy(FARM *farm) {
+    (void)farm;
+}
+#endif
+
+/*============================================================*/
@@ -0,0 +1,136 @@
+/**********************************************************//**
+ * @file farm.h
+ * @brief Declaration of a farm of worker processes that
+ * evaluate fitness out of the main address space.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _FARM_H_
+#define _FARM_H_
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdbool.h>        // bool
+
+// This project
+#include "genetic.h"        // FITNESS_FUNCTION
+
+/**********************************************************//**
+ * @typedef ENCODE_FUNCTION
+ * @brief Serializes an entity for another process.
+ * @param entity: The entity to encode.
+ * @param buffer: Location to store the bytes, which holds
+ * the wire size given in the FARM_REQUEST.
+ * @return The number of bytes written.
+ **************************************************************/
+typedef size_t (*ENCODE_FUNCTION)(const void *entity, unsigned char *buffer);
+
+/**********************************************************//**
+ * @typedef DECODE_FUNCTION
+ * @brief Rebuilds an entity serialized by ENCODE_FUNCTION.
+ * @param entity: Location to store the entity.
+ * @param buffer: The encoded bytes.
+ * @param size: The number of bytes available.
+ * @return Whether the bytes held a valid entity.
+ **************************************************************/
+typedef bool (*DECODE_FUNCTION)(void *entity, const unsigned char *buffer, size_t size);
+
+/**********************************************************//**
+ * @struct FARM_REQUEST
+ * @brief Stores all the information required as user input
+ * to construct a FARM.
+ **************************************************************/
+typedef struct {
+    size_t entitySize;          ///< The size of each organism's data.
+    size_t wireSize;            ///< The largest encoded size of an organism.
+    int nWorkers;               ///< The number of worker processes.
+    int batchSize;              ///< Organisms sent to a worker at a time.
+
+    // Functions
+    ENCODE_FUNCTION encode;     ///< Serializes an entity.
+    DECODE_FUNCTION decode;     ///< Deserializes an entity.
+    FITNESS_FUNCTION fitness;   ///< Run by the workers on decoded entities.
+} FARM_REQUEST;
+
+/**********************************************************//**
+ * @struct FARM_WORKER
+ * @brief Stores the coordinator's view of one worker.
+ **************************************************************/
+typedef struct {
+    int pid;                    ///< The worker process, or -1 if dead.
+    int socket;                 ///< Our end of the worker's socket.
+    int batch;                  ///< The batch in flight, or -1 if idle.
+} FARM_WORKER;
+
+/**********************************************************//**
+ * @struct FARM_BATCH
+ * @brief A contiguous range of the entities being evaluated.
+ **************************************************************/
+typedef struct {
+    int start;                  ///< The first entity in the batch.
+    int count;                  ///< The number of entities.
+    int failures;               ///< Workers that died running it.
+} FARM_BATCH;
+
+/**********************************************************//**
+ * @struct FARM
+ * @brief Stores a coordinator and its worker processes. The
+ * coordinator streams batches of encoded entities over Unix
+ * domain sockets and gathers one float per entity back. The
+ * workers are forked by a spawner process rather than by the
+ * coordinator, so they can be replaced while it runs threads.
+ **************************************************************/
+typedef struct {
+    FARM_REQUEST request;       ///< The farm configuration.
+    FARM_WORKER *workers;       ///< Every worker process.
+    unsigned char *buffer;      ///< Message scratch space.
+
+    // Batches of the current evaluation
+    FARM_BATCH *batches;        ///< Every batch, including split ones.
+    int nBatches;               ///< The number of batches.
+    int batchCapacity;          ///< The allocated number of batches.
+    int *pending;               ///< Stack of batches to be sent.
+    int nPending;               ///< The number of pending batches.
+
+    // Worker spawner
+    int spawner;                ///< The process that forks the workers, or -1.
+    int spawnerSocket;          ///< Our end of the spawner's socket.
+
+    // Statistics
+    long respawns;              ///< Workers restarted after dying.
+    long failures;              ///< Entities that crashed every worker.
+} FARM;
+
+/**********************************************************//**
+ * @brief Starts the worker processes and the spawner that
+ * forks them. This must be called before any threads are
+ * started.
+ * @param farm: Storage location for the farm data.
+ * @param request: User-specified farm parameters.
+ * @return Whether the creation suceeded.
+ **************************************************************/
+extern bool farm_Create(FARM *farm, const FARM_REQUEST *request);
+
+/**********************************************************//**
+ * @brief Evaluates the fitness of many entities using the
+ * workers. Work held by a worker that dies is sent to a fresh
+ * worker. A batch that keeps killing workers is split up, and
+ * a single entity that does so is given INFINITY fitness.
+ * @param farm: The farm data.
+ * @param entities: The entities to evaluate.
+ * @param count: The number of entities.
+ * @param fitness: Location to store the fitness of each entity.
+ * @return Whether the evaluation could be carried out at all.
+ **************************************************************/
+extern bool farm_Evaluate(FARM *farm, void *const *entities, int count, float *fitness);
+
+/**********************************************************//**
+ * @brief Stops all the workers and destroys the farm.
+ * @param farm: The farm to get rid of.
+ **************************************************************/
+extern void farm_Destroy(FARM *farm);
+
+/*============================================================*/
+#endif // _FARM_H_
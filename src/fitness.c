@@ -0,0 +1,606 @@
+/**********************************************************//**
+ * @file fitness.c
+ * @brief Implementation of the fitness functions used to
+ * evolve creatures.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdlib.h>         // malloc, qsort
+#include <stdint.h>         // uint64_t
+#include <math.h>           // fabs, INFINITY
+
+// This project
+#include "debug.h"          // eprintf
+#include "vector.h"         // VECTOR
+#include "creature.h"       // CREATURE
+#include "batch.h"          // BATCH
+#include "fitness.h"        // FITNESS_TRIALS
+
+/**********************************************************//**
+ * @struct BATCH_ITEM
+ * @brief A creature waiting to be put into a batch.
+ **************************************************************/
+typedef struct {
+    CREATURE *creature;     ///< The creature to evaluate.
+    int index;              ///< Where its fitness goes.
+} BATCH_ITEM;
+
+/**********************************************************//**
+ * @struct CYCLE
+ * @brief The state of a creature at the end of a trial, with
+ * the positions taken relative to its centroid so that a gait
+ * repeating as the creature walks along compares equal.
+ **************************************************************/
+typedef struct {
+    VECTOR position[MAX_NODES];     ///< Node positions relative to the centroid.
+    VECTOR velocity[MAX_NODES];     ///< Node velocities.
+    uint64_t contracted;            ///< Bit i is set when muscle i is contracting.
+} CYCLE;
+
+__extension__ _Static_assert(MAX_MUSCLES <= 64, "CYCLE holds one bit per muscle");
+
+/// @brief Longest period, in trials, a gait is checked for.
+/// A muscle toggled an odd number of times per MOTION is only
+/// back in the same state every other trial.
+#define CYCLE_PERIODS 2
+
+/// Number of trial end states kept to compare with.
+#define CYCLE_HISTORY (CYCLE_PERIODS + 1)
+
+/// Trials walked and skipped, added to atomically.
+static FITNESS_STATISTICS Statistics;
+
+/// Largest difference between trials to extrapolate from.
+static double CycleTolerance = 0.0;
+
+/// Most a racing creature is assumed to gain per trial.
+static float RaceGain = 0.0;
+
+/// Real fitness of the audited cuts, in the order audited.
+static float Audits[RACE_LOG];
+
+/// Largest step of each screening walk, or 0 for the usual one.
+static float ScreenStep[SCREEN_RUNGS];
+
+/// Trials of each screening walk.
+static int ScreenTrials[SCREEN_RUNGS] = {
+    FITNESS_TRIALS, FITNESS_TRIALS, FITNESS_TRIALS, FITNESS_TRIALS,
+};
+
+/**********************************************************//**
+ * @brief Counts the trials of some walks.
+ * @param walks: The number of creatures walked.
+ * @param trials: The trials simulated for all of them.
+ * @param skipped: The trials skipped for all of them.
+ * @param extrapolated: The trials extrapolated for all of them.
+ * @param cutTrials: The trials cut short for all of them.
+ **************************************************************/
+static inline void Count(long walks, long trials, long skipped, long extrapolated, long cutTrials) {
+    // A relaxed creature takes the whole trial in one update
+    long steps = (long)(BEHAVIOR_TIME / creature_TimeStep()) + 1;
+    __atomic_fetch_add(&Statistics.walks, walks, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.trials, trials, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.skipped, skipped, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.extrapolated, extrapolated, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.stepsSaved, skipped*steps, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&Statistics.cutTrials, cutTrials, __ATOMIC_RELAXED);
+}
+
+/**********************************************************//**
+ * @brief Finds the best fitness a racing creature can still
+ * reach, assuming every remaining trial gains RaceGain.
+ * @param x, y, z: The motion totals so far.
+ * @param trial: The number of trials done so far.
+ * @param nTrials: The number of trials in the walk.
+ * @return The bound, computed the same way as the fitness.
+ **************************************************************/
+static inline float Bound(float x, float y, float z, int trial, int nTrials) {
+    float remaining = (nTrials - trial)*RaceGain;
+    float totalFitness = x - y - z + remaining;
+    return -totalFitness / nTrials;
+}
+
+/**********************************************************//**
+ * @brief Counts a cut and decides whether it is audited.
+ * @return Whether the creature should be walked to the end
+ * anyway.
+ **************************************************************/
+static inline bool Audit(void) {
+    return __atomic_fetch_add(&Statistics.cut, 1, __ATOMIC_RELAXED) % RACE_AUDIT == 0;
+}
+
+/**********************************************************//**
+ * @brief Keeps the real fitness of an audited cut.
+ * @param fitness: The fitness it would have had.
+ **************************************************************/
+static inline void Log(float fitness) {
+    long n = __atomic_fetch_add(&Statistics.audited, 1, __ATOMIC_RELAXED);
+    if (n < RACE_LOG) {
+        Audits[n] = fitness;
+    }
+}
+
+/**********************************************************//**
+ * @brief Finds the largest difference between two cycles.
+ * @param a: The first cycle.
+ * @param b: The second cycle.
+ * @param nNodes: The number of nodes to compare.
+ * @return The largest difference of any position or velocity
+ * component, or infinity if any muscle differs.
+ **************************************************************/
+static inline float Difference(const CYCLE *a, const CYCLE *b, int nNodes) {
+    if (a->contracted != b->contracted) {
+        return INFINITY;
+    }
+    float difference = 0.0;
+    for (int i = 0; i < nNodes; i++) {
+        difference = fmax(difference, fabs(a->position[i].x - b->position[i].x));
+        difference = fmax(difference, fabs(a->position[i].y - b->position[i].y));
+        difference = fmax(difference, fabs(a->position[i].z - b->position[i].z));
+        difference = fmax(difference, fabs(a->velocity[i].x - b->velocity[i].x));
+        difference = fmax(difference, fabs(a->velocity[i].y - b->velocity[i].y));
+        difference = fmax(difference, fabs(a->velocity[i].z - b->velocity[i].z));
+    }
+    return difference;
+}
+
+/**********************************************************//**
+ * @brief Looks for a trial whose end state the latest trial
+ * ended in again.
+ * @param cycles: The end states, indexed by trial modulo
+ * CYCLE_HISTORY.
+ * @param trial: The number of trials done so far.
+ * @param nNodes: The number of nodes to compare.
+ * @return The number of trials the gait repeats after, or 0
+ * if it does not repeat within the tolerance.
+ **************************************************************/
+static inline int Period(const CYCLE *cycles, int trial, int nNodes) {
+    const CYCLE *latest = &cycles[trial % CYCLE_HISTORY];
+    for (int period = 1; period <= CYCLE_PERIODS && period < trial; period++) {
+        const CYCLE *earlier = &cycles[(trial - period) % CYCLE_HISTORY];
+        if (Difference(latest, earlier, nNodes) <= CycleTolerance) {
+            return period;
+        }
+    }
+    return 0;
+}
+
+/**********************************************************//**
+ * @brief Fills in the remaining trials of a walk by repeating
+ * the displacements of the last period.
+ * @param deltas: The displacement of every trial so far, with
+ * room for all of them.
+ * @param trial: The number of trials done so far.
+ * @param nTrials: The number of trials in the walk.
+ * @param period: The number of trials the gait repeats after.
+ * @param x, y, z: The motion totals to add to.
+ **************************************************************/
+static inline void Extrapolate(VECTOR *deltas, int trial, int nTrials, int period, float *x, float *y, float *z) {
+    for (int t = trial; t < nTrials; t++) {
+        deltas[t] = deltas[t - period];
+        *x += deltas[t].x;
+        *y += fabs(deltas[t].y);
+        *z += fabs(deltas[t].z);
+    }
+}
+
+/**********************************************************//**
+ * @brief Records the state of a creature at the end of a
+ * trial.
+ * @param creature: The creature to inspect.
+ * @param centroid: The average position of its nodes.
+ * @param cycle: Location to store the state.
+ **************************************************************/
+static inline void Record(const CREATURE *creature, const VECTOR *centroid, CYCLE *cycle) {
+    for (int i = 0; i < creature->nNodes; i++) {
+        cycle->position[i] = creature->nodes[i].position;
+        vector_Subtract(&cycle->position[i], centroid);
+        cycle->velocity[i] = creature->nodes[i].velocity;
+    }
+    cycle->contracted = 0;
+    for (int i = 0; i < MAX_MUSCLES; i++) {
+        cycle->contracted |= (uint64_t)creature->muscles[i].isContracted << i;
+    }
+}
+
+/**********************************************************//**
+ * @brief Records the state of one creature of a batch at the
+ * end of a trial, the same way as for a single creature.
+ * @param batch: The batch to inspect.
+ * @param lane: The creature within the batch.
+ * @param centroid: The average position of its nodes.
+ * @param cycle: Location to store the state.
+ **************************************************************/
+static inline void RecordLane(const BATCH *batch, int lane, const VECTOR *centroid, CYCLE *cycle) {
+    for (int i = 0; i < batch->nodeCount[lane]; i++) {
+        vector_Set(&cycle->position[i], batch->x[i][lane], batch->y[i][lane], batch->z[i][lane]);
+        vector_Subtract(&cycle->position[i], centroid);
+        vector_Set(&cycle->velocity[i], batch->vx[i][lane], batch->vy[i][lane], batch->vz[i][lane]);
+    }
+    cycle->contracted = 0;
+    for (int i = 0; i < MAX_MUSCLES; i++) {
+        cycle->contracted |= (uint64_t)(batch->isContracted[i][lane] != 0) << i;
+    }
+}
+
+/**********************************************************//**
+ * @brief Computes the average NODE position.
+ * @param creature: The creature to inspect.
+ * @return The average position of the creature's NODEs.
+ **************************************************************/
+static inline VECTOR AveragePosition(const CREATURE *creature) {
+    VECTOR total = {0.0, 0.0, 0.0};
+    for (int i = 0; i < creature->nNodes; i++) {
+        vector_Add(&total, &creature->nodes[i].position);
+    }
+    vector_Multiply(&total, 1.0 / creature->nNodes);
+    return total;
+}
+
+/**********************************************************//**
+ * @brief Walks a creature the way fitness_Race describes, for
+ * any number of trials.
+ * @param creature: The creature to inspect, which should have
+ * been reset.
+ * @param cutoff: The fitness the creature must beat.
+ * @param nTrials: The number of trials, up to FITNESS_TRIALS.
+ * @return The average fitness per trial, or the bound if the
+ * creature was cut.
+ **************************************************************/
+static float Walk(CREATURE *creature, float cutoff, int nTrials) {
+    // Evaluate the creature's walking fitness. To do this we
+    // will loop the walking animation several times
+    VECTOR start = AveragePosition(creature);
+    VECTOR end;
+    
+    // Count all positive x motions. However, penalize if there
+    // is tons of variance in the Y and Z directions: we only
+    // want to go forwards (and repeatably so).
+    float xMotionTotal = 0.0;
+    float yMotionMagnitudeTotal = 0.0;
+    float zMotionMagnitudeTotal = 0.0;
+    
+    // Do the given number of trials subsequently without
+    // resetting the creature.
+    CYCLE cycles[CYCLE_HISTORY];
+    VECTOR deltas[FITNESS_TRIALS];
+    int trial = 0;
+    int skipped = 0;
+    int extrapolated = 0;
+    int cutTrials = 0;
+    bool cut = false;
+    bool audited = false;
+    float bound = 0.0;
+    while (trial < nTrials) {
+        // Perform a whole cycle of the animation
+        creature_Animate(creature, BEHAVIOR_TIME);
+        trial++;
+        
+        // Sample the difference again
+        end = AveragePosition(creature);
+        VECTOR delta = end;
+        vector_Subtract(&delta, &start);
+        xMotionTotal += delta.x;
+        yMotionMagnitudeTotal += fabs(delta.y);
+        zMotionMagnitudeTotal += fabs(delta.z);
+        deltas[trial-1] = delta;
+        start = end;
+        
+        // A relaxed creature at rest stays where it is
+        if (creature->energy > MAX_ENERGY && creature_Settled(creature)) {
+            skipped = nTrials - trial;
+            break;
+        }
+        
+        // A repeating gait keeps moving the same way
+        if (CycleTolerance > 0.0) {
+            Record(creature, &end, &cycles[trial % CYCLE_HISTORY]);
+            int period = Period(cycles, trial, creature->nNodes);
+            if (period > 0) {
+                Extrapolate(deltas, trial, nTrials, period,
+                    &xMotionTotal, &yMotionMagnitudeTotal, &zMotionMagnitudeTotal);
+                extrapolated = nTrials - trial;
+                break;
+            }
+        }
+        
+        // A creature that cannot catch up is given up on
+        if (RaceGain > 0.0 && !cut && trial < nTrials) {
+            bound = Bound(xMotionTotal, yMotionMagnitudeTotal, zMotionMagnitudeTotal, trial, nTrials);
+            if (bound > cutoff) {
+                cut = true;
+                audited = Audit();
+                if (!audited) {
+                    cutTrials = nTrials - trial;
+                    break;
+                }
+            }
+        }
+    }
+    Count(1, trial, skipped, extrapolated, cutTrials);
+    creature_Count(creature);
+    
+    // Get the final fitness
+    float totalFitness = xMotionTotal - yMotionMagnitudeTotal - zMotionMagnitudeTotal;
+    float fitness = -totalFitness / nTrials;
+    if (audited) {
+        Log(fitness);
+    }
+    return cut? bound: fitness;
+}
+
+/*============================================================*
+ * Walking fitness
+ *============================================================*/
+float fitness_Walk(CREATURE *creature) {
+    return Walk(creature, INFINITY, FITNESS_TRIALS);
+}
+
+/*============================================================*
+ * Racing walking fitness
+ *============================================================*/
+float fitness_Race(CREATURE *creature, float cutoff) {
+    return Walk(creature, cutoff, FITNESS_TRIALS);
+}
+
+/*============================================================*
+ * Screening walking fitness
+ *============================================================*/
+float fitness_Screen(CREATURE *creature, int rung) {
+    creature->fixedStep = ScreenStep[rung];
+    float fitness = Walk(creature, INFINITY, ScreenTrials[rung]);
+    creature->fixedStep = 0.0;
+    return fitness;
+}
+
+/**********************************************************//**
+ * @brief Orders creatures by size, so creatures sharing a
+ * batch need about the same amount of padding.
+ * @param a: The first BATCH_ITEM.
+ * @param b: The second BATCH_ITEM.
+ * @return Negative, zero or positive as in qsort.
+ **************************************************************/
+static int CompareSize(const void *a, const void *b) {
+    const CREATURE *first = ((const BATCH_ITEM *)a)->creature;
+    const CREATURE *second = ((const BATCH_ITEM *)b)->creature;
+    if (first->nMuscles != second->nMuscles) {
+        return first->nMuscles - second->nMuscles;
+    } else if (first->nNodes != second->nNodes) {
+        return first->nNodes - second->nNodes;
+    }
+    return ((const BATCH_ITEM *)a)->index - ((const BATCH_ITEM *)b)->index;
+}
+
+/**********************************************************//**
+ * @brief Runs fitness_Walk on one batch of creatures in
+ * lockstep, following the same arithmetic in every lane.
+ * @param items: The creatures to inspect.
+ * @param count: The number of creatures, up to BATCH_LANES.
+ * @param cutoff: The fitness every creature must beat.
+ * @param fitness: Location to store the fitness of each
+ * creature, indexed as given by the items.
+ **************************************************************/
+static void WalkLockstep(const BATCH_ITEM *items, int count, float cutoff, float *fitness) {
+    const CREATURE *creatures[BATCH_LANES];
+    for (int l = 0; l < count; l++) {
+        creatures[l] = items[l].creature;
+    }
+    BATCH batch;
+    batch_Load(&batch, creatures, count);
+    
+    // Same accumulation as fitness_Walk, one lane at a time
+    VECTOR start[BATCH_LANES];
+    float xMotionTotal[BATCH_LANES];
+    float yMotionMagnitudeTotal[BATCH_LANES];
+    float zMotionMagnitudeTotal[BATCH_LANES];
+    for (int l = 0; l < count; l++) {
+        start[l] = batch_AveragePosition(&batch, l);
+        xMotionTotal[l] = 0.0;
+        yMotionMagnitudeTotal[l] = 0.0;
+        zMotionMagnitudeTotal[l] = 0.0;
+    }
+    
+    // Lanes that settle, repeat or are cut stop counting, but
+    // are only skipped once every lane has.
+    CYCLE cycles[BATCH_LANES][CYCLE_HISTORY];
+    VECTOR deltas[BATCH_LANES][FITNESS_TRIALS];
+    bool settled[BATCH_LANES] = {false};
+    bool repeated[BATCH_LANES] = {false};
+    bool cut[BATCH_LANES] = {false};
+    bool audited[BATCH_LANES] = {false};
+    float bound[BATCH_LANES];
+    int trial = 0;
+    int nFinished = 0;
+    while (trial < FITNESS_TRIALS && nFinished < count) {
+        batch_Animate(&batch, BEHAVIOR_TIME);
+        trial++;
+        for (int l = 0; l < count; l++) {
+            if (settled[l] || repeated[l] || (cut[l] && !audited[l])) {
+                continue;
+            }
+            VECTOR end = batch_AveragePosition(&batch, l);
+            VECTOR delta = end;
+            vector_Subtract(&delta, &start[l]);
+            xMotionTotal[l] += delta.x;
+            yMotionMagnitudeTotal[l] += fabs(delta.y);
+            zMotionMagnitudeTotal[l] += fabs(delta.z);
+            deltas[l][trial-1] = delta;
+            start[l] = end;
+            if (batch_Settled(&batch, l)) {
+                settled[l] = true;
+                nFinished++;
+                continue;
+            }
+            if (CycleTolerance > 0.0) {
+                RecordLane(&batch, l, &end, &cycles[l][trial % CYCLE_HISTORY]);
+                int period = Period(cycles[l], trial, batch.nodeCount[l]);
+                if (period > 0) {
+                    Extrapolate(deltas[l], trial, FITNESS_TRIALS, period,
+                        &xMotionTotal[l], &yMotionMagnitudeTotal[l], &zMotionMagnitudeTotal[l]);
+                    repeated[l] = true;
+                    nFinished++;
+                    continue;
+                }
+            }
+            if (RaceGain > 0.0 && !cut[l] && trial < FITNESS_TRIALS) {
+                bound[l] = Bound(xMotionTotal[l], yMotionMagnitudeTotal[l], zMotionMagnitudeTotal[l], trial, FITNESS_TRIALS);
+                if (bound[l] > cutoff) {
+                    cut[l] = true;
+                    audited[l] = Audit();
+                    nFinished += audited[l]? 0: 1;
+                }
+            }
+        }
+    }
+    
+    // Only the trials after the batch stopped were saved
+    long skipped = 0;
+    long extrapolated = 0;
+    long cutTrials = 0;
+    for (int l = 0; l < count; l++) {
+        skipped += settled[l]? FITNESS_TRIALS - trial: 0;
+        extrapolated += repeated[l]? FITNESS_TRIALS - trial: 0;
+        cutTrials += (cut[l] && !audited[l])? FITNESS_TRIALS - trial: 0;
+    }
+    Count(count, (long)trial*count, skipped, extrapolated, cutTrials);
+    for (int l = 0; l < count; l++) {
+        float totalFitness = xMotionTotal[l] - yMotionMagnitudeTotal[l] - zMotionMagnitudeTotal[l];
+        fitness[items[l].index] = cut[l]? bound[l]: -totalFitness / FITNESS_TRIALS;
+        if (audited[l]) {
+            Log(-totalFitness / FITNESS_TRIALS);
+        }
+    }
+}
+
+/*============================================================*
+ * Lockstep walking fitness
+ *============================================================*/
+void fitness_WalkBatch(CREATURE *const *creatures, int count, float *fitness) {
+    fitness_RaceBatch(creatures, count, INFINITY, fitness);
+}
+
+/*============================================================*
+ * Lockstep racing walking fitness
+ *============================================================*/
+void fitness_RaceBatch(CREATURE *const *creatures, int count, float cutoff, float *fitness) {
+    // The lockstep simulator only knows the midpoint method
+    // at the default time step
+    if (creature_Integrator() != INTEGRATOR_MIDPOINT || creature_TimeStep() != TIME_STEP) {
+        for (int i = 0; i < count; i++) {
+            fitness[i] = fitness_Race(creatures[i], cutoff);
+        }
+        return;
+    }
+    BATCH_ITEM *items = malloc(sizeof(BATCH_ITEM)*count);
+    if (!items) {
+        // Still give correct answers, just slower
+        eprintf("Failed to allocate batch, walking one at a time.\n");
+        for (int i = 0; i < count; i++) {
+            fitness[i] = fitness_Race(creatures[i], cutoff);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        items[i].creature = creatures[i];
+        items[i].index = i;
+    }
+    qsort(items, count, sizeof(BATCH_ITEM), &CompareSize);
+    for (int i = 0; i < count; i += BATCH_LANES) {
+        int size = (count - i < BATCH_LANES)? count - i: BATCH_LANES;
+        WalkLockstep(&items[i], size, cutoff, fitness);
+    }
+    free(items);
+}
+
+/*============================================================*
+ * Cycle tolerance
+ *============================================================*/
+bool fitness_SetCycleTolerance(double tolerance) {
+    if (!(tolerance >= 0.0)) {
+        return false;
+    }
+    CycleTolerance = tolerance;
+    return true;
+}
+
+/*============================================================*
+ * Selected cycle tolerance
+ *============================================================*/
+double fitness_CycleTolerance(void) {
+    return CycleTolerance;
+}
+
+/*============================================================*
+ * Race gain
+ *============================================================*/
+bool fitness_SetRaceGain(double gain) {
+    if (!(gain >= 0.0)) {
+        return false;
+    }
+    RaceGain = gain;
+    return true;
+}
+
+/*============================================================*
+ * Selected race gain
+ *============================================================*/
+double fitness_RaceGain(void) {
+    return RaceGain;
+}
+
+/*============================================================*
+ * Screening walk
+ *============================================================*/
+bool fitness_SetScreening(int rung, double step, int trials) {
+    if (rung < 0 || rung >= SCREEN_RUNGS || !(step >= 0.0) || trials < 1 || trials > FITNESS_TRIALS) {
+        return false;
+    }
+    ScreenStep[rung] = step;
+    ScreenTrials[rung] = trials;
+    return true;
+}
+
+/*============================================================*
+ * Wrong cuts
+ *============================================================*/
+long fitness_Overturned(float threshold) {
+    long nAudits = __atomic_load_n(&Statistics.audited, __ATOMIC_RELAXED);
+    long overturned = 0;
+    for (long i = 0; i < nAudits && i < RACE_LOG; i++) {
+        overturned += (Audits[i] < threshold);
+    }
+    return overturned;
+}
+
+/*============================================================*
+ * Trial statistics
+ *============================================================*/
+void fitness_Statistics(FITNESS_STATISTICS *stats) {
+    stats->walks = __atomic_load_n(&Statistics.walks, __ATOMIC_RELAXED);
+    stats->trials = __atomic_load_n(&Statistics.trials, __ATOMIC_RELAXED);
+    stats->skipped = __atomic_load_n(&Statistics.skipped, __ATOMIC_RELAXED);
+    stats->extrapolated = __atomic_load_n(&Statistics.extrapolated, __ATOMIC_RELAXED);
+    stats->stepsSaved = __atomic_load_n(&Statistics.stepsSaved, __ATOMIC_RELAXED);
+    stats->cut = __atomic_load_n(&Statistics.cut, __ATOMIC_RELAXED);
+    stats->cutTrials = __atomic_load_n(&Statistics.cutTrials, __ATOMIC_RELAXED);
+    stats->audited = __atomic_load_n(&Statistics.audited, __ATOMIC_RELAXED);
+}
+
+/*============================================================*
+ * Trial statistics reset
+ *============================================================*/
+void fitness_ResetStatistics(void) {
+    __atomic_store_n(&Statistics.walks, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.trials, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.skipped, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.extrapolated, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.stepsSaved, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.cut, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.cutTrials, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&Statistics.audited, 0, __ATOMIC_RELAXED);
+}
+
+/*============================================================*/
@@ -0,0 +1,203 @@
+/**********************************************************//**
+ * @file fitness.h
+ * @brief Declaration of the fitness functions used to
+ * evolve creatures.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _FITNESS_H_
+#define _FITNESS_H_
+
+// This project
+#include "creature.h"       // CREATURE
+
+//**************************************************************
+/// Number of trials to evaluate fitness.
+#define FITNESS_TRIALS 10
+
+/// A racing creature cut short is finished anyway once in
+/// this many cuts, to check whether the cut was right.
+#define RACE_AUDIT 8
+
+/// Number of audited cuts kept between statistics resets.
+#define RACE_LOG 4096
+
+/// Rungs of the screening ladder that can be configured.
+#define SCREEN_RUNGS 4
+
+/**********************************************************//**
+ * @struct FITNESS_STATISTICS
+ * @brief Counts the walking trials simulated and the ones
+ * skipped because the creature had run out of energy and come
+ * to rest, across all threads of this process.
+ **************************************************************/
+typedef struct {
+    long walks;             ///< Creatures walked.
+    long trials;            ///< Trials simulated.
+    long skipped;           ///< Trials skipped.
+    long extrapolated;      ///< Trials extrapolated from a repeating gait.
+    long stepsSaved;        ///< Update steps the skipped trials would have taken.
+    long cut;               ///< Racing creatures that could not reach the cutoff.
+    long cutTrials;         ///< Trials not simulated because of the cuts.
+    long audited;           ///< Cut creatures finished anyway.
+} FITNESS_STATISTICS;
+
+/**********************************************************//**
+ * @brief Models the creature walking forward using its
+ * MOTION. This is repeated FITNESS_TRIALS times for
+ * an averaging effect. The fitness is based on the total
+ * distance travelled in the X-direction (positive), and is
+ * negatively impacted by significant motion in the Y and Z
+ * directions. A creature that has run out of energy relaxes
+ * its muscles for good, so once it is also at rest after a
+ * trial the remaining trials are counted as not moving it.
+ * With a cycle tolerance set, a creature whose state relative
+ * to its centroid, velocities and muscles matches the end of
+ * one of the last two trials is taken to repeat the trials
+ * since then for the rest of the walk.
+ * @param creature: The creature to inspect, which should have
+ * been reset.
+ * @return The fitness of the walk animation.
+ **************************************************************/
+extern float fitness_Walk(CREATURE *creature);
+
+/**********************************************************//**
+ * @brief Computes fitness_Walk for many creatures, simulating
+ * BATCH_LANES of them at a time in lockstep. Creatures of
+ * similar size are grouped together to keep the padding down.
+ * The results are identical to fitness_Walk. Creatures are
+ * walked one at a time unless the integrator is the midpoint
+ * method at TIME_STEP, the only one the lockstep simulator
+ * implements.
+ * @param creatures: The creatures to inspect, which should
+ * have been reset.
+ * @param count: The number of creatures.
+ * @param fitness: Location to store the fitness of each one.
+ **************************************************************/
+extern void fitness_WalkBatch(CREATURE *const *creatures, int count, float *fitness);
+
+/**********************************************************//**
+ * @brief Computes fitness_Walk, but gives up on a creature
+ * that can no longer beat a cutoff. After every trial the
+ * best fitness still reachable is found by assuming each
+ * remaining trial gains the race gain, and once even that is
+ * worse than the cutoff the creature is given this bound
+ * instead of its real fitness. The bound is never better than
+ * the real fitness as long as no trial gains more than the
+ * race gain, so the creature still loses to anything at the
+ * cutoff. Every RACE_AUDIT-th cut is walked to the end anyway
+ * and its real fitness kept for fitness_Overturned.
+ * @param creature: The creature to inspect, which should have
+ * been reset.
+ * @param cutoff: The fitness the creature must beat, or
+ * INFINITY to walk it to the end as fitness_Walk does.
+ * @return The fitness of the walk animation, or the bound if
+ * the creature was cut.
+ **************************************************************/
+extern float fitness_Race(CREATURE *creature, float cutoff);
+
+/**********************************************************//**
+ * @brief Computes fitness_Race for many creatures, the same
+ * way fitness_WalkBatch computes fitness_Walk. A batch stops
+ * once every lane is cut or finished.
+ * @param creatures: The creatures to inspect, which should
+ * have been reset.
+ * @param count: The number of creatures.
+ * @param cutoff: The fitness every creature must beat.
+ * @param fitness: Location to store the fitness of each one.
+ **************************************************************/
+extern void fitness_RaceBatch(CREATURE *const *creatures, int count, float cutoff, float *fitness);
+
+/**********************************************************//**
+ * @brief Computes a cheap estimate of fitness_Walk, with the
+ * step and number of trials set for a rung of the screening
+ * ladder by fitness_SetScreening. The fitness is still the
+ * average per trial, so it is on about the same scale as the
+ * full one.
+ * @param creature: The creature to inspect, which should have
+ * been reset.
+ * @param rung: The rung, from 0 to SCREEN_RUNGS - 1.
+ * @return The estimated fitness.
+ **************************************************************/
+extern float fitness_Screen(CREATURE *creature, int rung);
+
+/**********************************************************//**
+ * @brief Changes how fitness_Screen walks creatures at a rung
+ * of the screening ladder. Steps longer than creature_TimeStep
+ * are only stable with the sturdier integrators. Not thread
+ * safe; call it before any creatures are evaluated.
+ * @param rung: The rung, from 0 to SCREEN_RUNGS - 1.
+ * @param step: The largest time step in seconds, or 0 for
+ * creature_TimeStep.
+ * @param trials: The number of trials, from 1 to
+ * FITNESS_TRIALS.
+ * @return Whether the settings are valid.
+ **************************************************************/
+extern bool fitness_SetScreening(int rung, double step, int trials);
+
+/**********************************************************//**
+ * @brief Changes the most a racing creature is assumed to
+ * gain in one trial, counting its X motion less its Y and Z
+ * motion. Too small a gain cuts creatures that would have
+ * caught up; the audit shows how often that happened. Not
+ * thread safe; call it before any creatures are evaluated.
+ * @param gain: The largest gain per trial, or 0 to never cut
+ * a creature.
+ * @return Whether the gain is valid.
+ **************************************************************/
+extern bool fitness_SetRaceGain(double gain);
+
+/**********************************************************//**
+ * @brief Gets the race gain.
+ * @return The gain per trial, 0 by default.
+ **************************************************************/
+extern double fitness_RaceGain(void);
+
+/**********************************************************//**
+ * @brief Counts the audited cuts since the last reset whose
+ * real fitness beats a threshold. Given the fitness of the
+ * last survivor of the generation they were cut in, these are
+ * the creatures the cut wrongly killed. Only the first
+ * RACE_LOG audits are kept.
+ * @param threshold: The fitness to beat.
+ * @return The number of audited creatures beating it.
+ **************************************************************/
+extern long fitness_Overturned(float threshold);
+
+/**********************************************************//**
+ * @brief Changes how closely the end of a trial must match
+ * the end of an earlier one for the rest of the walk to be
+ * extrapolated. Each trial starts one action later in the
+ * MOTION than the last, so a match means a settled gait
+ * rather than an exact repeat; use the cycles benchmark to
+ * see what a tolerance costs in accuracy. Not thread safe;
+ * call it before any creatures are evaluated.
+ * @param tolerance: The largest difference of any relative
+ * position or velocity component, or 0 to always simulate
+ * every trial.
+ * @return Whether the tolerance is valid.
+ **************************************************************/
+extern bool fitness_SetCycleTolerance(double tolerance);
+
+/**********************************************************//**
+ * @brief Gets the cycle tolerance.
+ * @return The tolerance, 0 by default.
+ **************************************************************/
+extern double fitness_CycleTolerance(void);
+
+/**********************************************************//**
+ * @brief Gets the trials walked and skipped since the last
+ * reset. Trials walked in other processes are not counted.
+ * @param stats: Location to store the counters.
+ **************************************************************/
+extern void fitness_Statistics(FITNESS_STATISTICS *stats);
+
+/**********************************************************//**
+ * @brief Sets the trial counters to zero.
+ **************************************************************/
+extern void fitness_ResetStatistics(void);
+
+/*============================================================*/
+#endif // _FITNESS_H_
@@ -9,15 +9,61 @@
 // Standard library
 #include <stddef.h>         // size_t
 #include <stdbool.h>        // bool
+#include <limits.h>         // LONG_MAX
 #include <stdlib.h>         // malloc
-#include <string.h>         // memcpy
-#include <math.h>           // INFINITY
+#include <string.h>         // memcpy, strcmp
+#include <math.h>           // INFINITY, NAN, ceil, sqrt, isnan
+
+// External libraries
+#include <pthread.h>        // pthread_mutex_t
 
 // This project
 #include "debug.h"          // eprintf
 #include "heap.h"           // HEAP
+#include "pool.h"           // POOL
+#include "rng.h"            // RNG
 #include "genetic.h"        // GENETIC, GENETIC_REQUEST
 
+//**************************************************************
+/// @brief Default number of individuals competing in a
+/// tournament, and the number in a steady-state one.
+#define TOURNAMENT_SIZE 3
+
+/// @brief One in this many screened entities that are not
+/// promoted is evaluated in full anyway, for the correlation,
+/// and competes with the fitness it was found to have.
+#define SCREEN_AUDIT 8
+
+/// @brief Expected number of children of the fittest entity
+/// under linear rank selection, from 1 for none to 2.
+#define RANK_PRESSURE 1.5
+
+/// Elites kept by the strategies that do not truncate.
+#define DEFAULT_ELITISM 2
+
+/// Names of the selection strategies, as accepted on the command line.
+static const char *const SelectionNames[N_SELECTIONS] = {
+    [SELECTION_SORTED] = "sorted",
+    [SELECTION_TRUNCATION] = "truncation",
+    [SELECTION_TOURNAMENT] = "tournament",
+    [SELECTION_RANK] = "rank",
+    [SELECTION_SUS] = "sus",
+};
+
+/**********************************************************//**
+ * @struct STEADY_STATE
+ * @brief Shared state of the steady-state workers.
+ **************************************************************/
+typedef struct {
+    GENETIC *data;          ///< The algorithm data.
+    pthread_mutex_t lock;   ///< Guards the population and below.
+    float target;           ///< Fitness that ends the run.
+    long timeout;           ///< Maximum number of children.
+    long births;            ///< Number of children claimed so far.
+    long pause;             ///< Births after which the workers stop.
+    bool done;              ///< Whether the target was reached.
+} STEADY_STATE;
+
 /**********************************************************//**
  * @brief Gets the entity associated with the given index.
  * @param data: The GENETIC algorithm data.
@@ -43,24 +89,803 @@ static inline int Index(const GENETIC *data, const void *entity) {
 }
 
 /**********************************************************//**
- * @brief Gets a pointer to the newborn entity at the given
- * index.
+ * @brief Gets the spare entity at the given index.
  * @param data: The GENETIC algorithm data.
  * @param index: The index of the entity sought. This can be
- * from 0 to the number of newborns - 1.
- * @return Pointer to the entity.
+ * from 0 to the population size - 1.
+ * @return Pointer to the entity in the spare buffer.
  **************************************************************/
-static inline void *Newborn(GENETIC *data, int index) {
-    return ((char *)data->newborn) + index*data->entitySize;
+static inline void *Spare(GENETIC *data, int index) {
+    return ((char *)data->spare) + index*data->entitySize;
 }
 
 /**********************************************************//**
- * @brief Gets the number of newborn to generate.
+ * @brief Checks whether the selection keeps only the elites
+ * and breeds them with each other, in place.
+ * @param data: The GENETIC algorithm data.
+ * @return Whether the selection truncates.
+ **************************************************************/
+static inline bool Truncates(const GENETIC *data) {
+    return data->selection == SELECTION_SORTED || data->selection == SELECTION_TRUNCATION;
+}
+
+/**********************************************************//**
+ * @brief Gets the number of newborn to generate. Truncation
+ * breeds as many as there are elites, in the places of the
+ * entities ranked just below them. The others replace every
+ * entity but the elites, up to an even number.
  * @param data: The GENETIC algorithm data.
  * @return Number of newborn per generation.
  **************************************************************/
 static inline int NumberNewborn(const GENETIC *data) {
-    return 2*(data->populationSize/4);
+    if (Truncates(data)) {
+        return data->elitism;
+    }
+    return 2*((data->populationSize - data->elitism)/2);
+}
+
+/**********************************************************//**
+ * @brief Gets the number of entities that must die but have
+ * no newborn to take their place, which are randomized.
+ * @param data: The GENETIC algorithm data.
+ * @return Number of stragglers per generation.
+ **************************************************************/
+static inline int NumberStragglers(const GENETIC *data) {
+    if (Truncates(data)) {
+        return data->populationSize - 2*data->elitism;
+    }
+    return data->populationSize - data->elitism - NumberNewborn(data);
+}
+
+/**********************************************************//**
+ * @brief Gets the fitness of an entity for selection, which
+ * ranks an entity without a number last.
+ * @param data: The GENETIC algorithm data.
+ * @param index: The entity to inspect.
+ * @return The fitness, or INFINITY if it is NAN.
+ **************************************************************/
+static inline float Score(const GENETIC *data, int index) {
+    float score = data->scores[index];
+    return isnan(score)? INFINITY: score;
+}
+
+/**********************************************************//**
+ * @brief Compares two entities by fitness. Ties are broken by
+ * index, so the order is total and does not depend on how
+ * the entities are arranged.
+ * @param data: The GENETIC algorithm data.
+ * @param a, b: The entities to compare.
+ * @return Whether the first entity ranks above the second.
+ **************************************************************/
+static inline bool Fitter(const GENETIC *data, int a, int b) {
+    float x = Score(data, a);
+    float y = Score(data, b);
+    return x < y || (x == y && a < b);
+}
+
+/**********************************************************//**
+ * @brief Swaps two entity indices.
+ * @param a, b: The indices to swap.
+ **************************************************************/
+static inline void Swap(int *a, int *b) {
+    int temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+/**********************************************************//**
+ * @brief Partitions entity indices around the k-th fittest,
+ * like nth_element. Afterwards the k fittest come first in no
+ * particular order, with the k-th fittest at k-1. This takes
+ * linear time on average.
+ * @param data: The GENETIC algorithm data.
+ * @param order: The entity indices to partition.
+ * @param count: The number of indices.
+ * @param k: The number of fittest entities to put first,
+ * from 1 to count.
+ **************************************************************/
+static void Partition(const GENETIC *data, int *order, int count, int k) {
+    int target = k - 1;
+    int low = 0;
+    int high = count - 1;
+    while (low < high) {
+        // Median of three, which also sorts the ends
+        int middle = low + (high - low)/2;
+        if (Fitter(data, order[middle], order[low])) {
+            Swap(&order[middle], &order[low]);
+        }
+        if (Fitter(data, order[high], order[low])) {
+            Swap(&order[high], &order[low]);
+        }
+        if (Fitter(data, order[high], order[middle])) {
+            Swap(&order[high], &order[middle]);
+        }
+        int pivot = order[middle];
+        
+        // Everything up to j ranks at or above the pivot, and
+        // everything from i on at or below it.
+        int i = low;
+        int j = high;
+        while (i <= j) {
+            while (Fitter(data, order[i], pivot)) {
+                i++;
+            }
+            while (Fitter(data, pivot, order[j])) {
+                j--;
+            }
+            if (i <= j) {
+                Swap(&order[i], &order[j]);
+                i++;
+                j--;
+            }
+        }
+        if (target <= j) {
+            high = j;
+        } else if (target >= i) {
+            low = i;
+        } else {
+            break;
+        }
+    }
+}
+
+/**********************************************************//**
+ * @brief Merges two runs of entity indices sorted by fitness.
+ * The output may overlap the end of the second run, as long as
+ * it starts no later than the first run would in its place.
+ * @param data: The GENETIC algorithm data.
+ * @param a, b: The sorted runs.
+ * @param na, nb: The lengths of the runs.
+ * @param out: Location to store the merged indices.
+ **************************************************************/
+static void Merge(const GENETIC *data, const int *a, int na, const int *b, int nb, int *out) {
+    int i = 0;
+    int j = 0;
+    while (i < na && j < nb) {
+        if (Fitter(data, b[j], a[i])) {
+            *out++ = b[j++];
+        } else {
+            *out++ = a[i++];
+        }
+    }
+    while (i < na) {
+        *out++ = a[i++];
+    }
+    while (j < nb) {
+        *out++ = b[j++];
+    }
+}
+
+/**********************************************************//**
+ * @brief Sorts entity indices by fitness with a merge sort,
+ * using the evaluation queue as scratch space. Fitter is a
+ * total order, so this ranks exactly as the heap would with
+ * no ties, without the heap's arbitrary order among ties.
+ * @param data: The GENETIC algorithm data.
+ * @param order: The entity indices to sort.
+ * @param count: The number of indices.
+ **************************************************************/
+static void Sort(GENETIC *data, int *order, int count) {
+    int *from = order;
+    int *to = data->queue;
+    for (int width = 1; width < count; width *= 2) {
+        for (int start = 0; start < count; start += 2*width) {
+            int middle = (start + width < count)? start + width: count;
+            int end = (middle + width < count)? middle + width: count;
+            Merge(data, &from[start], middle - start, &from[middle], end - middle, &to[start]);
+        }
+        int *temp = from;
+        from = to;
+        to = temp;
+    }
+    if (from != order) {
+        memcpy(order, from, sizeof(int)*count);
+    }
+}
+
+/**********************************************************//**
+ * @brief Sorts the whole population by fitness into the
+ * ranking. The survivors head the ranking already sorted from
+ * the last generation, and keep the fitness they had if it is
+ * memoized, so only the rest are sorted and then merged with
+ * them in linear time. The survivors are sorted again should
+ * their fitness have changed after all.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Rerank(GENETIC *data) {
+    int n = data->populationSize;
+    int nSurvivors = data->nSurvivors;
+    int *survivors = data->ranking;
+    int *newborn = &data->ranking[nSurvivors];
+    for (int r = 1; r < nSurvivors; r++) {
+        if (Fitter(data, survivors[r], survivors[r-1])) {
+            Sort(data, survivors, nSurvivors);
+            break;
+        }
+    }
+    Sort(data, newborn, n - nSurvivors);
+    memcpy(data->queue, survivors, sizeof(int)*nSurvivors);
+    Merge(data, data->queue, nSurvivors, newborn, n - nSurvivors, data->ranking);
+}
+
+/**********************************************************//**
+ * @brief Pool task evaluating the fitness of one entity.
+ * @param context: The GENETIC algorithm data.
+ * @param index: The place of the entity in the queue.
+ * @param worker: Unused.
+ **************************************************************/
+static void EvaluateTask(void *context, int index, int worker) {
+    (void)worker;
+    GENETIC *data = (GENETIC *)context;
+    int entity = data->queue[index];
+    data->scores[entity] = data->fitness(Entity(data, entity));
+}
+
+/**********************************************************//**
+ * @brief Gets the cheap fitness of every entity at a rung.
+ * @param data: The GENETIC algorithm data.
+ * @param rung: The rung of the screening ladder.
+ * @return The cheap fitness, by entity index.
+ **************************************************************/
+static inline float *Screens(const GENETIC *data, int rung) {
+    return data->screens + rung*data->populationSize;
+}
+
+/**********************************************************//**
+ * @brief Pool task estimating the fitness of one entity with
+ * the current rung of the screen.
+ * @param context: The GENETIC algorithm data.
+ * @param index: The place of the entity in the queue.
+ * @param worker: Unused.
+ **************************************************************/
+static void ScreenTask(void *context, int index, int worker) {
+    (void)worker;
+    GENETIC *data = (GENETIC *)context;
+    int entity = data->queue[index];
+    float screen = data->screen(Entity(data, entity), data->rung);
+    Screens(data, data->rung)[entity] = screen;
+    if (screen != -INFINITY) {
+        data->rungs[entity] = data->rung + 1;
+    }
+}
+
+/**********************************************************//**
+ * @brief Pool task evaluating the fitness of one batch of
+ * consecutive queued entities.
+ * @param context: The GENETIC algorithm data.
+ * @param index: The batch to evaluate.
+ * @param worker: Unused.
+ **************************************************************/
+static void BatchTask(void *context, int index, int worker) {
+    (void)worker;
+    GENETIC *data = (GENETIC *)context;
+    int start = index*data->batchSize;
+    int count = data->nQueued - start;
+    if (count > data->batchSize) {
+        count = data->batchSize;
+    }
+    data->batchFitness(&data->batch[start], count, &data->results[start]);
+    for (int i = start; i < start + count; i++) {
+        data->scores[data->queue[i]] = data->results[i];
+    }
+}
+
+/**********************************************************//**
+ * @brief Puts the whole population in the evaluation queue.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static inline void QueueAll(GENETIC *data) {
+    for (int i = 0; i < data->populationSize; i++) {
+        data->queue[i] = i;
+    }
+    data->nQueued = data->populationSize;
+}
+
+/**********************************************************//**
+ * @brief Estimates the cost of evaluating every queued entity.
+ * @param data: The GENETIC algorithm data.
+ * @return The costs in queue order, or NULL if they cannot
+ * be estimated.
+ **************************************************************/
+static float *Weigh(GENETIC *data) {
+    if (!data->cost) {
+        return NULL;
+    }
+    for (int i = 0; i < data->nQueued; i++) {
+        data->costs[i] = data->cost(Entity(data, data->queue[i]));
+    }
+    return data->costs;
+}
+
+/**********************************************************//**
+ * @brief Evaluates the queued entities concurrently. Each
+ * worker only writes its own slots of the fitness array. When
+ * the cost of each entity can be estimated, the expensive
+ * items are spread out first so no thread is left holding them.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Evaluate(GENETIC *data) {
+    float *costs = Weigh(data);
+    if (!data->batchFitness) {
+        pool_RunWeighted(&data->pool, data->nQueued, &EvaluateTask, data, costs);
+        return;
+    }
+    
+    // Batches are consecutive runs of the queue. Batch b never
+    // starts before entry b, so its total cost can be stored
+    // in place once the costs it covers have been read.
+    for (int i = 0; i < data->nQueued; i++) {
+        data->batch[i] = Entity(data, data->queue[i]);
+    }
+    int nBatches = (data->nQueued + data->batchSize - 1) / data->batchSize;
+    for (int b = 0; b < nBatches && costs; b++) {
+        int start = b*data->batchSize;
+        float total = 0.0;
+        for (int i = start; i < start + data->batchSize && i < data->nQueued; i++) {
+            total += costs[i];
+        }
+        costs[b] = total;
+    }
+    pool_RunWeighted(&data->pool, nBatches, &BatchTask, data, costs);
+}
+
+/**********************************************************//**
+ * @brief Ranks some values from smallest to largest using the
+ * heap, which must be empty. Tied values share the average of
+ * their ranks, as the Spearman correlation needs.
+ * @param data: The GENETIC algorithm data.
+ * @param values: The values to rank, none of them NAN.
+ * @param count: The number of values.
+ * @param ranks: Location to store the rank of each value.
+ **************************************************************/
+static void Rank(GENETIC *data, const float *values, int count, float *ranks) {
+    int *order = data->order;
+    for (int i = 0; i < count; i++) {
+        heap_Push(&data->heap, i, values[i]);
+    }
+    for (int r = 0; r < count; r++) {
+        heap_Pop(&data->heap, &order[r]);
+    }
+    for (int r = 0; r < count;) {
+        int end = r + 1;
+        while (end < count && values[order[end]] == values[order[r]]) {
+            end++;
+        }
+        float rank = 0.5*(r + end - 1);
+        for (int k = r; k < end; k++) {
+            ranks[order[k]] = rank;
+        }
+        r = end;
+    }
+}
+
+/**********************************************************//**
+ * @brief Finds the Spearman rank correlation between the
+ * cheap fitness at a rung and the full fitness of the queued
+ * entities after the survivors that were screened at the
+ * rung. This is the Pearson correlation of their ranks, which
+ * stays exact when there are ties.
+ * @param data: The GENETIC algorithm data.
+ * @param rung: The rung of the screening ladder.
+ * @return The correlation, or NAN if there are too few or
+ * either fitness is the same for all of them.
+ **************************************************************/
+static float Correlation(GENETIC *data, int rung) {
+    int n = data->populationSize;
+    float *cheap = data->ranks;
+    float *full = data->ranks + n;
+    float *cheapRanks = data->ranks + 2*n;
+    float *fullRanks = data->ranks + 3*n;
+    const float *screens = Screens(data, rung);
+    int count = 0;
+    for (int i = data->nSurvivors; i < data->nQueued; i++) {
+        int entity = data->queue[i];
+        if (data->rungs[entity] > rung) {
+            cheap[count] = isnan(screens[entity])? INFINITY: screens[entity];
+            full[count] = Score(data, entity);
+            count++;
+        }
+    }
+    if (count < 2) {
+        return NAN;
+    }
+    Rank(data, cheap, count, cheapRanks);
+    Rank(data, full, count, fullRanks);
+    
+    // Both sets of ranks have the same mean
+    double mean = 0.5*(count - 1);
+    double covariance = 0.0;
+    double cheapSquares = 0.0;
+    double fullSquares = 0.0;
+    for (int i = 0; i < count; i++) {
+        double x = cheapRanks[i] - mean;
+        double y = fullRanks[i] - mean;
+        covariance += x*y;
+        cheapSquares += x*x;
+        fullSquares += y*y;
+    }
+    if (cheapSquares == 0.0 || fullSquares == 0.0) {
+        return NAN;
+    }
+    return covariance / sqrt(cheapSquares*fullSquares);
+}
+
+/**********************************************************//**
+ * @brief Evaluates the population through the screening
+ * ladder. The entities below the survivors climb it: at each
+ * rung, those still climbing are screened and sorted by their
+ * cheap fitness in place at the head of the candidates, and
+ * only the promoted fraction of them keeps climbing, so the
+ * entities rejected at each rung are left in order behind
+ * them. The entities whose fitness is already known sort
+ * first and are set aside there, behind the survivors, so
+ * they neither climb further nor take the place of an unknown.
+ * The ranking is rebuilt after the evaluation anyway. Then
+ * the survivors, the known entities, the entities promoted
+ * past the last rung and every SCREEN_AUDIT-th of the
+ * rejected are evaluated in full. The other rejected entities
+ * are given infinite fitness.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Screen(GENETIC *data) {
+    // Everything ranked below the survivors is new
+    int nSurvivors = data->nSurvivors;
+    int nCandidates = data->populationSize - nSurvivors;
+    int *candidates = &data->ranking[nSurvivors];
+    for (int i = 0; i < nCandidates; i++) {
+        data->rungs[candidates[i]] = 0;
+    }
+    
+    // The elites must all have their full fitness
+    int nNeeded = data->elitism - nSurvivors;
+    int nClimbing = nCandidates;
+    int nAhead = nSurvivors;
+    for (int rung = 0; rung < data->nRungs; rung++) {
+        for (int i = 0; i < nClimbing; i++) {
+            data->queue[i] = candidates[i];
+        }
+        data->nQueued = nClimbing;
+        data->rung = rung;
+        pool_RunWeighted(&data->pool, data->nQueued, &ScreenTask, data, Weigh(data));
+        const float *screens = Screens(data, rung);
+        for (int i = 0; i < nClimbing; i++) {
+            int entity = data->queue[i];
+            heap_Push(&data->heap, entity, isnan(screens[entity])? INFINITY: screens[entity]);
+        }
+        for (int r = 0; r < nClimbing; r++) {
+            heap_Pop(&data->heap, &candidates[r]);
+        }
+        
+        // The known entities sort first and stay where they are
+        int nKnown = 0;
+        while (nKnown < nClimbing && screens[candidates[nKnown]] == -INFINITY) {
+            nKnown++;
+        }
+        candidates += nKnown;
+        nCandidates -= nKnown;
+        nClimbing -= nKnown;
+        nNeeded -= nKnown;
+        nAhead += nKnown;
+        int nPromote = (int)ceil(data->promote[rung]*nClimbing);
+        if (nPromote < nNeeded) {
+            nPromote = nNeeded;
+        }
+        if (nPromote > nClimbing) {
+            nPromote = nClimbing;
+        }
+        nClimbing = nPromote;
+    }
+    data->nQueued = 0;
+    for (int r = 0; r < nAhead + nClimbing; r++) {
+        data->queue[data->nQueued++] = data->ranking[r];
+    }
+    for (int r = nClimbing; r < nCandidates; r += SCREEN_AUDIT) {
+        data->queue[data->nQueued++] = candidates[r];
+    }
+    Evaluate(data);
+    for (int rung = 0; rung < MAX_RUNGS; rung++) {
+        data->correlation[rung] = (rung < data->nRungs)? Correlation(data, rung): NAN;
+    }
+    
+    // The rest lose to everybody evaluated in full, but the
+    // audited ones keep the fitness they were found to have
+    for (int r = nClimbing; r < nCandidates; r++) {
+        if ((r - nClimbing) % SCREEN_AUDIT != 0) {
+            data->scores[candidates[r]] = INFINITY;
+        }
+    }
+}
+
+/**********************************************************//**
+ * @brief Gets the fitness of two children at once, in a batch
+ * when the batch function is available.
+ * @param data: The GENETIC algorithm data.
+ * @param son: The first child.
+ * @param daughter: The second child.
+ * @param fitness: Location to store both fitnesses.
+ **************************************************************/
+static void EvaluatePair(GENETIC *data, void *son, void *daughter, float fitness[2]) {
+    if (data->batchFitness) {
+        void *pair[2] = {son, daughter};
+        data->batchFitness(pair, 2, fitness);
+    } else {
+        fitness[0] = data->fitness(son);
+        fitness[1] = data->fitness(daughter);
+    }
+}
+
+/**********************************************************//**
+ * @brief Pool task breeding one pair of newborn. When the
+ * selection truncates, the parents are adjacent in the ranking
+ * and the n-th newborn is bred straight into the place of the
+ * n-th individual below them, which must die and is never a
+ * parent itself, so nothing is staged or copied. Otherwise
+ * the parents are drawn from the whole population, and the
+ * newborn are bred into the spare buffer after the elites.
+ * @param context: The GENETIC algorithm data.
+ * @param index: The pair to breed.
+ * @param worker: Unused.
+ **************************************************************/
+static void BreedTask(void *context, int index, int worker) {
+    (void)worker;
+    GENETIC *data = (GENETIC *)context;
+    int nElite = data->elitism;
+    int n = 2*index;
+    void *mother;
+    void *father;
+    void *son;
+    void *daughter;
+    if (Truncates(data)) {
+        mother = Entity(data, data->ranking[n]);
+        father = Entity(data, data->ranking[n+1]);
+        son = Entity(data, data->ranking[nElite + n]);
+        daughter = Entity(data, data->ranking[nElite + n + 1]);
+    } else {
+        mother = Entity(data, data->parents[n]);
+        father = Entity(data, data->parents[n+1]);
+        son = Spare(data, nElite + n);
+        daughter = Spare(data, nElite + n + 1);
+    }
+    
+    // The pair's random stream is named after the first child,
+    // so the result does not depend on which worker breeds it.
+    RNG rng;
+    rng_Derive(&rng, data->seed, data->generation+1, n);
+    data->breed(mother, father, son, daughter, &rng);
+}
+
+/**********************************************************//**
+ * @brief Pool task randomizing one straggler, an individual
+ * who must die but has no newborn to take its place.
+ * @param context: The GENETIC algorithm data.
+ * @param index: The straggler to randomize, counting from the
+ * first one below the newborn.
+ * @param worker: Unused.
+ **************************************************************/
+static void RandomizeTask(void *context, int index, int worker) {
+    (void)worker;
+    GENETIC *data = (GENETIC *)context;
+    int nBreed = NumberNewborn(data);
+    void *straggler;
+    if (Truncates(data)) {
+        straggler = Entity(data, data->ranking[2*nBreed + index]);
+    } else {
+        straggler = Spare(data, data->elitism + nBreed + index);
+    }
+    
+    // Stragglers are numbered after the newborn.
+    RNG rng;
+    rng_Derive(&rng, data->seed, data->generation+1, nBreed + index);
+    data->random(straggler, &rng);
+}
+
+/**********************************************************//**
+ * @brief Runs a tournament between random individuals. The
+ * population lock must be held in the steady state.
+ * @param data: The GENETIC algorithm data.
+ * @param rng: The random stream to draw from.
+ * @param size: The number of individuals competing.
+ * @param fittest: Whether the fittest or least fit wins.
+ * @return Index of the winning entity.
+ **************************************************************/
+static int Tournament(const GENETIC *data, RNG *rng, int size, bool fittest) {
+    int winner = rng_Randint(rng, 0, data->populationSize-1);
+    for (int i = 1; i < size; i++) {
+        int challenger = rng_Randint(rng, 0, data->populationSize-1);
+        float difference = Score(data, challenger) - Score(data, winner);
+        if (fittest? (difference < 0.0): (difference > 0.0)) {
+            winner = challenger;
+        }
+    }
+    return winner;
+}
+
+/**********************************************************//**
+ * @brief Draws the parents of every newborn by stochastic
+ * universal sampling: evenly spaced pointers over the fitness
+ * of everybody, measured from the least fit finite fitness, so
+ * the number of times an entity is drawn is within one of its
+ * expected share. The parents are then shuffled so they mate
+ * at random.
+ * @param data: The GENETIC algorithm data.
+ * @param rng: The random stream to draw from.
+ * @param count: The number of parents to draw.
+ **************************************************************/
+static void Sample(GENETIC *data, RNG *rng, int count) {
+    int n = data->populationSize;
+    float worst = -INFINITY;
+    for (int i = 0; i < n; i++) {
+        if (isfinite(data->scores[i]) && data->scores[i] > worst) {
+            worst = data->scores[i];
+        }
+    }
+    double total = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (isfinite(data->scores[i])) {
+            total += worst - data->scores[i];
+        }
+    }
+    
+    // Everybody is equally fit, or nobody has a fitness
+    if (!(total > 0.0)) {
+        for (int k = 0; k < count; k++) {
+            data->parents[k] = rng_Randint(rng, 0, n-1);
+        }
+        return;
+    }
+    
+    // One pass over the population with all the pointers
+    double spacing = total / count;
+    double pointer = rng_Uniform(rng, 0.0, 1.0)*spacing;
+    double sum = 0.0;
+    int last = 0;
+    int k = 0;
+    for (int i = 0; i < n && k < count; i++) {
+        if (!isfinite(data->scores[i]) || data->scores[i] == worst) {
+            continue;
+        }
+        sum += worst - data->scores[i];
+        last = i;
+        while (k < count && pointer < sum) {
+            data->parents[k++] = i;
+            pointer += spacing;
+        }
+    }
+    
+    // Pointers lost to rounding go to the last one passed
+    while (k < count) {
+        data->parents[k++] = last;
+    }
+    for (int i = count - 1; i > 0; i--) {
+        Swap(&data->parents[i], &data->parents[rng_Randint(rng, 0, i)]);
+    }
+}
+
+/**********************************************************//**
+ * @brief Chooses the elites and, when the selection does not
+ * truncate, the parents of every newborn. Afterwards the
+ * ranking starts with the elites, fittest first, and the rest
+ * of the population follows. Only SELECTION_SORTED and
+ * SELECTION_RANK sort the rest; the others find the elites by
+ * partitioning in linear time, and SELECTION_TRUNCATION leaves
+ * the elites between the first and last unsorted too.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Select(GENETIC *data) {
+    int n = data->populationSize;
+    int nElite = data->elitism;
+    switch (data->selection) {
+    case SELECTION_SORTED:
+    case SELECTION_RANK:
+        Rerank(data);
+        break;
+        
+    case SELECTION_TRUNCATION:
+        // Only the cut and the best need to be found
+        for (int i = 0; i < n; i++) {
+            data->ranking[i] = i;
+        }
+        Partition(data, data->ranking, n, nElite);
+        for (int r = 1; r < nElite - 1; r++) {
+            if (Fitter(data, data->ranking[r], data->ranking[0])) {
+                Swap(&data->ranking[r], &data->ranking[0]);
+            }
+        }
+        break;
+        
+    default:
+        // Only the elites need to be in order
+        for (int i = 0; i < n; i++) {
+            data->ranking[i] = i;
+        }
+        Partition(data, data->ranking, n, nElite);
+        Sort(data, data->ranking, nElite);
+        break;
+    }
+    
+    // Set the best individual's properties
+    data->best = Entity(data, data->ranking[0]);
+    data->bestFitness = data->scores[data->ranking[0]];
+    if (Truncates(data)) {
+        return;
+    }
+    
+    // Draw the parents from one stream, numbered after all the
+    // newborn and stragglers.
+    int nParents = NumberNewborn(data);
+    RNG rng;
+    rng_Derive(&rng, data->seed, data->generation+1, n);
+    switch (data->selection) {
+    case SELECTION_TOURNAMENT:
+        for (int k = 0; k < nParents; k++) {
+            data->parents[k] = Tournament(data, &rng, data->tournamentSize, true);
+        }
+        break;
+        
+    case SELECTION_RANK:
+        // Invert the linear ranking's distribution, treating
+        // the rank as continuous.
+        for (int k = 0; k < nParents; k++) {
+            double u = rng_Uniform(&rng, 0.0, 1.0);
+            double x = u;
+            if (RANK_PRESSURE > 1.0) {
+                double s = RANK_PRESSURE;
+                x = (s - sqrt(s*s - 4.0*(s - 1.0)*u)) / (2.0*(s - 1.0));
+            }
+            int r = (int)(x*n);
+            data->parents[k] = data->ranking[(r < n)? r: n - 1];
+        }
+        break;
+        
+    default:
+        Sample(data, &rng, nParents);
+        break;
+    }
+}
+
+/**********************************************************//**
+ * @brief Moves the newborn bred into the spare buffer into
+ * the population. The elites are copied to the front of the
+ * spare buffer, fittest first, and the buffers are swapped.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Succeed(GENETIC *data) {
+    int nElite = data->elitism;
+    for (int r = 0; r < nElite; r++) {
+        memcpy(Spare(data, r), Entity(data, data->ranking[r]), data->entitySize);
+        data->results[r] = data->scores[data->ranking[r]];
+    }
+    for (int r = 0; r < nElite; r++) {
+        data->scores[r] = data->results[r];
+    }
+    for (int i = 0; i < data->populationSize; i++) {
+        data->ranking[i] = i;
+    }
+    void *entities = data->entities;
+    data->entities = data->spare;
+    data->spare = entities;
+    data->best = Entity(data, 0);
+}
+
+/**********************************************************//**
+ * @brief Lets the compact function reclaim the storage of
+ * everybody who is about to be replaced. Only the survivors
+ * and, when the selection does not truncate, the parents are
+ * still read.
+ * @param data: The GENETIC algorithm data.
+ **************************************************************/
+static void Compact(GENETIC *data) {
+    int count = 0;
+    for (int r = 0; r < data->elitism; r++) {
+        data->batch[count++] = Entity(data, data->ranking[r]);
+    }
+    if (!Truncates(data)) {
+        int nParents = NumberNewborn(data);
+        for (int k = 0; k < nParents; k++) {
+            data->batch[count++] = Entity(data, data->parents[k]);
+        }
+    }
+    data->compact(data->batch, count);
 }
 
 /*============================================================*
@@ -70,9 +895,70 @@ bool genetic_Create(GENETIC *data, const GENETIC_REQUEST *request) {
     // Move request information over
     data->entitySize = request->entitySize;
     data->populationSize = request->populationSize;
+    data->seed = request->seed;
+    data->generation = 0;
+    data->nSurvivors = 0;
     data->random = request->random;
     data->breed = request->breed;
     data->fitness = request->fitness;
+    data->batchFitness = request->batchFitness;
+    data->batchSize = request->batchSize;
+    data->cost = request->cost;
+    data->compact = request->compact;
+    data->screen = request->screen;
+    data->nRungs = request->nRungs;
+    memcpy(data->promote, request->promote, sizeof(data->promote));
+    data->selection = request->selection;
+    data->elitism = request->elitism;
+    data->tournamentSize = request->tournamentSize;
+    data->spare = NULL;
+    data->parents = NULL;
+    data->screens = NULL;
+    data->rungs = NULL;
+    data->ranks = NULL;
+    data->order = NULL;
+    if (data->batchSize <= 0 || data->batchSize > data->populationSize) {
+        data->batchSize = data->populationSize;
+    }
+    if (!data->fitness && !data->batchFitness) {
+        eprintf("No fitness function given.\n");
+        return false;
+    }
+    if (data->screen && (data->nRungs < 1 || data->nRungs > MAX_RUNGS)) {
+        eprintf("Screening ladder must have from 1 to %d rungs.\n", MAX_RUNGS);
+        return false;
+    }
+    for (int rung = 0; data->screen && rung < data->nRungs; rung++) {
+        if (!(data->promote[rung] > 0.0 && data->promote[rung] <= 1.0)) {
+            eprintf("Promoted fraction must be above 0 and at most 1.\n");
+            return false;
+        }
+    }
+    if (data->selection < 0 || data->selection >= N_SELECTIONS) {
+        eprintf("Unknown selection strategy.\n");
+        return false;
+    }
+    if (data->tournamentSize == 0) {
+        data->tournamentSize = TOURNAMENT_SIZE;
+    }
+    if (data->tournamentSize < 1) {
+        eprintf("Tournament size must be at least 1.\n");
+        return false;
+    }
+    
+    // Truncation breeds the elites into the places of as many
+    // entities, in pairs.
+    if (data->elitism == 0) {
+        data->elitism = Truncates(data)? 2*(data->populationSize/4): DEFAULT_ELITISM;
+    }
+    if (Truncates(data) && (data->elitism < 0 || data->elitism % 2 || 2*data->elitism > data->populationSize)) {
+        eprintf("Truncation needs an even number of elites, at most half the population.\n");
+        return false;
+    }
+    if (!Truncates(data) && (data->elitism < 1 || data->elitism > data->populationSize)) {
+        eprintf("Elites must number from 1 to the population size.\n");
+        return false;
+    }
     
     // Allocates data for the entity array
     data->entities = malloc(data->entitySize*data->populationSize);
@@ -88,25 +974,84 @@ bool genetic_Create(GENETIC *data, const GENETIC_REQUEST *request) {
         return false;
     }
     
-    // Create the newborn array
-    int newbornSize = NumberNewborn(data);
-    data->newborn = malloc(data->entitySize*newbornSize);
-    if (!data->newborn) {
-        eprintf("Failed to create newborn array.\n");
+    // Create the fitness, cost and ranking arrays used by the workers
+    data->scores = malloc(sizeof(float)*data->populationSize);
+    data->costs = malloc(sizeof(float)*data->populationSize);
+    data->results = malloc(sizeof(float)*data->populationSize);
+    data->ranking = malloc(sizeof(int)*data->populationSize);
+    data->queue = malloc(sizeof(int)*data->populationSize);
+    data->batch = malloc(sizeof(void *)*data->populationSize);
+    if (!Truncates(data)) {
+        data->spare = malloc(data->entitySize*data->populationSize);
+        data->parents = malloc(sizeof(int)*data->populationSize);
+    }
+    
+    // The screen keeps the cheap fitness of every rung, and the
+    // correlation ranks two sets of values for each of them.
+    if (data->screen) {
+        data->screens = malloc(sizeof(float)*data->nRungs*data->populationSize);
+        data->rungs = malloc(sizeof(int)*data->populationSize);
+        data->ranks = malloc(sizeof(float)*4*data->populationSize);
+        data->order = malloc(sizeof(int)*data->populationSize);
+    }
+    if (!data->scores || !data->costs || !data->results
+        || !data->ranking || !data->queue || !data->batch
+        || (!Truncates(data) && (!data->spare || !data->parents))
+        || (data->screen && (!data->screens || !data->rungs || !data->ranks || !data->order))) {
+        eprintf("Failed to create fitness array.\n");
+        free(data->entities);
+        heap_Destroy(&data->heap);
+        free(data->scores);
+        free(data->costs);
+        free(data->screens);
+        free(data->rungs);
+        free(data->ranks);
+        free(data->order);
+        free(data->results);
+        free(data->ranking);
+        free(data->queue);
+        free(data->batch);
+        free(data->spare);
+        free(data->parents);
+        return false;
+    }
+    
+    // Start the workers
+    if (!pool_Create(&data->pool, request->nThreads)) {
+        eprintf("Failed to create worker pool.\n");
         free(data->entities);
         heap_Destroy(&data->heap);
+        free(data->scores);
+        free(data->costs);
+        free(data->screens);
+        free(data->rungs);
+        free(data->ranks);
+        free(data->order);
+        free(data->results);
+        free(data->ranking);
+        free(data->queue);
+        free(data->batch);
+        free(data->spare);
+        free(data->parents);
         return false;
     }
     
-    // Initial population generation
+    // Initial population generation. Every individual gets its
+    // own random stream so the result is reproducible.
     for (int i = 0; i < data->populationSize; i++) {
+        RNG rng;
+        rng_Derive(&rng, data->seed, 0, i);
         void *where = Entity(data, i);
-        data->random(where);
+        data->random(where, &rng);
+        data->ranking[i] = i;
     }
     
     // Unrelated initialization
     data->best = NULL;
     data->bestFitness = INFINITY;
+    for (int rung = 0; rung < MAX_RUNGS; rung++) {
+        data->correlation[rung] = NAN;
+    }
     return true;
 }
 
@@ -114,54 +1059,97 @@ bool genetic_Create(GENETIC *data, const GENETIC_REQUEST *request) {
  * Computes one generation
  *============================================================*/
 void genetic_Generation(GENETIC *data) {
-    // Create a heap to sort the population by fitness.
-    // We re-use the same allocated heap for efficiency.
-    for (int i = 0; i < data->populationSize; i++) {
-        heap_Push(&data->heap, i, data->fitness(Entity(data, i)));
+    // Evaluate the whole population
+    if (data->screen) {
+        Screen(data);
+    } else {
+        QueueAll(data);
+        Evaluate(data);
     }
     
-    // Set the best individual's properties
-    const HEAP_ELEMENT *best = heap_Top(&data->heap);
-    data->best = Entity(data, best->payload);
-    data->bestFitness = best->priority;
-    
-    // Get the number of newborn to generate.
-    // Then generate all the newborn organisms using the breeding
-    // function specified. The newborn array is probably full of
-    // garbage at this point, we just overwrite it.
-    int nBreed = NumberNewborn(data);
-    for (int n = 0; n < nBreed; n += 2) {
-        // Indicies the parents are the top ones on the heap.
-        int motherIndex, fatherIndex;
-        heap_Pop(&data->heap, &motherIndex);
-        heap_Pop(&data->heap, &fatherIndex);
-        void *mother = Entity(data, motherIndex);
-        void *father = Entity(data, fatherIndex);
-        
-        // Get pointers to the newborn data slots
-        void *son = Newborn(data, n);
-        void *daughter = Newborn(data, n+1);
-        data->breed(mother, father, son, daughter);
+    // Choose the elites and the parents of the newborn
+    Select(data);
+    if (data->compact) {
+        Compact(data);
     }
     
-    // Kill the remaining individuals and place newborns in their place
-    for (int n = 0; n < nBreed && !heap_IsEmpty(&data->heap); n++) {
-        // Pop an individual from the heap who must die.
-        int killIndex;
-        heap_Pop(&data->heap, &killIndex);
-        
-        // Copy the newborn into the entity array.
-        memcpy(Entity(data, killIndex), Newborn(data, n), data->entitySize);
+    // Breed the newborn using the breeding function specified,
+    // one pair per task, and randomize any stragglers. When the
+    // selection truncates, they take the places of the dead and
+    // the survivors keep theirs in the entity array. Otherwise
+    // the next generation is built in the spare buffer.
+    int nBreed = NumberNewborn(data);
+    if (nBreed > 0) {
+        pool_Run(&data->pool, nBreed/2, &BreedTask, data);
     }
-    
-    // If any stragglers left on the heap, just randomize them to keep
-    // the same population size.
-    while (!heap_IsEmpty(&data->heap)) {
-        // Overwrite with a random index
-        int randomIndex;
-        heap_Pop(&data->heap, &randomIndex);
-        data->random(Entity(data, randomIndex));
+    int nStragglers = NumberStragglers(data);
+    if (nStragglers > 0) {
+        pool_Run(&data->pool, nStragglers, &RandomizeTask, data);
+    }
+    if (!Truncates(data)) {
+        Succeed(data);
+    }
+    data->nSurvivors = data->elitism;
+    data->generation++;
+}
+
+/*============================================================*
+ * Survivor access
+ *============================================================*/
+const void *genetic_Survivor(const GENETIC *data, int rank, float *fitness) {
+    if (rank < 0 || rank >= data->nSurvivors) {
+        return NULL;
+    }
+    int index = data->ranking[rank];
+    *fitness = data->scores[index];
+    return ((const char *)data->entities) + index*data->entitySize;
+}
+
+/*============================================================*
+ * Survival cutoff
+ *============================================================*/
+float genetic_Cutoff(const GENETIC *data) {
+    if (data->nSurvivors == 0 || !Truncates(data)) {
+        return INFINITY;
+    }
+    return data->scores[data->ranking[data->nSurvivors - 1]];
+}
+
+/*============================================================*
+ * Migration
+ *============================================================*/
+bool genetic_Immigrate(GENETIC *data, const void *entity, int n) {
+    // Everything ranked below the survivors is a newborn or a
+    // straggler that has not been evaluated yet.
+    if (n < 0 || n >= data->populationSize - data->nSurvivors) {
+        return false;
     }
+    int index = data->ranking[data->populationSize - 1 - n];
+    memcpy(Entity(data, index), entity, data->entitySize);
+    return true;
+}
+
+/*============================================================*
+ * Selection names
+ *============================================================*/
+const char *genetic_SelectionName(SELECTION selection) {
+    if (selection < 0 || selection >= N_SELECTIONS) {
+        return "unknown";
+    }
+    return SelectionNames[selection];
+}
+
+/*============================================================*
+ * Selection lookup
+ *============================================================*/
+bool genetic_FindSelection(const char *name, SELECTION *selection) {
+    for (int i = 0; i < N_SELECTIONS; i++) {
+        if (!strcmp(name, SelectionNames[i])) {
+            *selection = (SELECTION)i;
+            return true;
+        }
+    }
+    return false;
 }
 
 /*============================================================*
@@ -183,4 +1171,130 @@ int genetic_Solve(GENETIC *data, float fitness, int timeout) {
     return timeout;
 }
 
+/**********************************************************//**
+ * @brief Puts a child into the population if it beats the
+ * loser of a reverse tournament. The population lock must
+ * be held.
+ * @param data: The GENETIC algorithm data.
+ * @param child: The evaluated child.
+ * @param fitness: The fitness of the child.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void Replace(GENETIC *data, const void *child, float fitness, RNG *rng) {
+    int loser = Tournament(data, rng, TOURNAMENT_SIZE, false);
+    if (fitness < data->scores[loser]) {
+        memcpy(Entity(data, loser), child, data->entitySize);
+        data->scores[loser] = fitness;
+        if (fitness < data->bestFitness) {
+            data->best = Entity(data, loser);
+            data->bestFitness = fitness;
+        }
+    }
+}
+
+/**********************************************************//**
+ * @brief Pool task run once per worker, which breeds children
+ * until the steady-state run is over.
+ * @param context: The STEADY_STATE shared by the workers.
+ * @param index: Unused.
+ * @param worker: Unused.
+ **************************************************************/
+static void SteadyTask(void *context, int index, int worker) {
+    (void)index;
+    (void)worker;
+    STEADY_STATE *state = (STEADY_STATE *)context;
+    GENETIC *data = state->data;
+    
+    // Private copies of the parents and children, so they can be
+    // used without holding the lock.
+    char *scratch = malloc(4*data->entitySize);
+    if (!scratch) {
+        eprintf("Failed to allocate steady-state scratch.\n");
+        return;
+    }
+    void *mother = scratch;
+    void *father = scratch + data->entitySize;
+    void *son = scratch + 2*data->entitySize;
+    void *daughter = scratch + 3*data->entitySize;
+    
+    while (true) {
+        // Claim the next pair of children and select the parents
+        pthread_mutex_lock(&state->lock);
+        if (state->done || state->births >= state->pause
+            || (state->timeout != TIMEOUT_NONE && state->births >= state->timeout)) {
+            pthread_mutex_unlock(&state->lock);
+            break;
+        }
+        long birth = state->births;
+        state->births += 2;
+        RNG rng;
+        rng_Derive(&rng, data->seed, data->generation+1, birth);
+        memcpy(mother, Entity(data, Tournament(data, &rng, TOURNAMENT_SIZE, true)), data->entitySize);
+        memcpy(father, Entity(data, Tournament(data, &rng, TOURNAMENT_SIZE, true)), data->entitySize);
+        pthread_mutex_unlock(&state->lock);
+        
+        // Breed and evaluate, which is where all the time goes
+        data->breed(mother, father, son, daughter, &rng);
+        float fitness[2];
+        EvaluatePair(data, son, daughter, fitness);
+        
+        // Put the children back in the population
+        pthread_mutex_lock(&state->lock);
+        Replace(data, son, fitness[0], &rng);
+        Replace(data, daughter, fitness[1], &rng);
+        if (data->bestFitness <= state->target) {
+            state->done = true;
+        }
+        pthread_mutex_unlock(&state->lock);
+    }
+    free(scratch);
+}
+
+/*============================================================*
+ * Steady-state solver algorithm
+ *============================================================*/
+long genetic_SteadyState(GENETIC *data, float fitness, long timeout) {
+    // Tournaments need the fitness of everybody up front.
+    QueueAll(data);
+    Evaluate(data);
+    data->best = Entity(data, 0);
+    data->bestFitness = data->scores[0];
+    for (int i = 1; i < data->populationSize; i++) {
+        if (data->scores[i] < data->bestFitness) {
+            data->best = Entity(data, i);
+            data->bestFitness = data->scores[i];
+        }
+    }
+    
+    // Every worker runs the steady-state loop until the target
+    // fitness or timeout is reached, stopping now and then for
+    // the compact function if there is one.
+    STEADY_STATE state = {
+        .data = data,
+        .target = fitness,
+        .timeout = timeout,
+        .births = 0,
+        .done = (data->bestFitness <= fitness),
+    };
+    pthread_mutex_init(&state.lock, NULL);
+    do {
+        state.pause = data->compact? state.births + data->populationSize: LONG_MAX;
+        pool_Run(&data->pool, data->pool.nThreads, &SteadyTask, &state);
+        if (data->compact) {
+            for (int i = 0; i < data->populationSize; i++) {
+                data->batch[i] = Entity(data, i);
+            }
+            data->compact(data->batch, data->populationSize);
+        }
+    } while (state.births >= state.pause && !state.done
+        && (timeout == TIMEOUT_NONE || state.births < timeout));
+    pthread_mutex_destroy(&state.lock);
+    
+    // The whole run counts as one generation for random streams.
+    // Replacement was all over the place so the ranking is stale.
+    data->nSurvivors = 0;
+    data->generation++;
+    return state.births;
+}
+
 /*============================================================*/
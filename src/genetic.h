@@ -12,9 +12,12 @@
 // Standard library
 #include <stddef.h>         // size_t
 #include <stdbool.h>        // bool
+#include <stdint.h>         // uint64_t
 
 // This project
 #include "heap.h"           // HEAP
+#include "pool.h"           // POOL
+#include "rng.h"            // RNG
 
 //**************************************************************
 /// @brief Value used for specifying that a genetic algorithm
@@ -23,29 +26,112 @@
 
 /**********************************************************//**
  * @typedef RANDOM_FUNCTION
- * @brief Generates a random entity.
+ * @brief Generates a random entity. This may be called from
+ * several threads at once for different entities.
  * @param entity: The location the data is stored.
+ * @param rng: The random stream reserved for this entity.
  **************************************************************/
-typedef void (*RANDOM_FUNCTION)(void *entity);
+typedef void (*RANDOM_FUNCTION)(void *entity, RNG *rng);
 
 /**********************************************************//**
  * @typedef BREEDING_FUNCTION
- * @brief Breeds two entities and creates two children.
+ * @brief Breeds two entities and creates two children. This
+ * may be called from several threads at once, and the same
+ * parents are never written to.
  * @param mother: The first parent.
  * @param father: The second parent.
  * @param son: The first child generated.
  * @param daughter: The second child generated.
+ * @param rng: The random stream reserved for this pair of
+ * children.
  **************************************************************/
-typedef void (*BREEDING_FUNCTION)(const void *mother, const void *father, void *son, void *daughter);
+typedef void (*BREEDING_FUNCTION)(const void *mother, const void *father, void *son, void *daughter, RNG *rng);
 
 /**********************************************************//**
  * @typedef FITNESS_FUNCTION
- * @brief Get the fitness of the organism in any order.
+ * @brief Get the fitness of the organism in any order. This
+ * may be called from several threads at once, but never twice
+ * at once for the same entity.
  * @param entity: The entity to evaluate.
  * @return The fitness (smaller numbers are more fit).
  **************************************************************/
 typedef float (*FITNESS_FUNCTION)(void *entity);
 
+/**********************************************************//**
+ * @typedef SCREEN_FUNCTION
+ * @brief Get a cheap estimate of the fitness of the organism,
+ * at one rung of a ladder of ever more faithful estimates.
+ * This may be called from several threads at once, but never
+ * twice at once for the same entity. An entity whose full
+ * fitness is already known can skip the rest of the ladder.
+ * @param entity: The entity to evaluate.
+ * @param rung: The rung of the ladder, from 0 for the cheapest.
+ * @return The estimated fitness (smaller numbers are more fit),
+ * or -INFINITY to evaluate the entity in full unscreened.
+ **************************************************************/
+typedef float (*SCREEN_FUNCTION)(void *entity, int rung);
+
+/**********************************************************//**
+ * @typedef BATCH_FITNESS_FUNCTION
+ * @brief Get the fitness of many organisms at once, so the
+ * work can be shared between them. This may be called from
+ * several threads at once for different batches.
+ * @param entities: The entities to evaluate.
+ * @param count: The number of entities.
+ * @param fitness: Location to store the fitness of each
+ * entity (smaller numbers are more fit).
+ **************************************************************/
+typedef void (*BATCH_FITNESS_FUNCTION)(void *const *entities, int count, float *fitness);
+
+/**********************************************************//**
+ * @typedef COST_FUNCTION
+ * @brief Estimates how long the fitness of an entity takes to
+ * evaluate, used to balance the work between threads.
+ * @param entity: The entity to inspect.
+ * @return The relative cost, in any consistent unit.
+ **************************************************************/
+typedef float (*COST_FUNCTION)(const void *entity);
+
+/**********************************************************//**
+ * @typedef COMPACT_FUNCTION
+ * @brief Reclaims storage the entities refer to outside their
+ * own data once no entity still in use refers to it. This is
+ * called between generations, with nothing else running.
+ * @param entities: Every entity that may still be read, in
+ * any order, which may be reordered.
+ * @param count: The number of entities.
+ **************************************************************/
+typedef void (*COMPACT_FUNCTION)(void **entities, int count);
+
+//**************************************************************
+/// Most rungs a screening ladder can have.
+#define MAX_RUNGS 4
+
+/**********************************************************//**
+ * @enum SELECTION
+ * @brief Ways of choosing who survives a generation and who
+ * breeds. The truncating strategies keep the elites in place
+ * and breed them with each other. The others keep the elites
+ * and fill the rest of the population with children of parents
+ * drawn from everybody, bred into a second buffer. Entities
+ * of equal fitness are ranked by their index in the
+ * population, so the ranking only depends on the fitness. The
+ * ties that occur are clones and the entities the screen gives
+ * infinite fitness. Ranking those by index rather than in the
+ * arbitrary order of a heap does not change which genomes
+ * survive, only which slots the newborn are bred into and,
+ * with SELECTION_RANK, which of the tied entities is drawn as
+ * a parent.
+ **************************************************************/
+typedef enum {
+    SELECTION_SORTED,       ///< Truncation by sorting everybody; neighbours mate.
+    SELECTION_TRUNCATION,   ///< Truncation by partitioning around the cut; the survivors mate in no order.
+    SELECTION_TOURNAMENT,   ///< Each parent is the fittest of tournamentSize random entities.
+    SELECTION_RANK,         ///< Linear ranking, drawing parents by their rank.
+    SELECTION_SUS,          ///< Stochastic universal sampling in proportion to fitness.
+    N_SELECTIONS,           ///< Number of selection strategies.
+} SELECTION;
+
 /**********************************************************//**
  * @struct GENETIC_REQUEST
  * @brief Stores all the information required as user input
@@ -55,11 +141,25 @@ typedef struct {
     // Individuals
     size_t entitySize;          ///< The size of each organism's data.
     int populationSize;         ///< The number of entities in the population.
+    int nThreads;               ///< Worker threads used to evaluate and breed.
+    uint64_t seed;              ///< Seed all random streams derive from.
     
     // Functions
     RANDOM_FUNCTION random;     ///< Generates a random entity.
     BREEDING_FUNCTION breed;    ///< Breeds two entities.
-    FITNESS_FUNCTION fitness;   ///< Gets the fitness of the entity.
+    FITNESS_FUNCTION fitness;   ///< Gets the fitness of the entity, or NULL.
+    BATCH_FITNESS_FUNCTION batchFitness;    ///< Preferred over fitness when not NULL.
+    int batchSize;              ///< Entities per batch, or 0 for the whole population.
+    COST_FUNCTION cost;         ///< Estimates the fitness cost, or NULL.
+    COMPACT_FUNCTION compact;   ///< Reclaims storage outside the entities, or NULL.
+    SCREEN_FUNCTION screen;     ///< Cheap estimates of the fitness, or NULL.
+    int nRungs;                 ///< Rungs of the screening ladder, from 1 to MAX_RUNGS.
+    float promote[MAX_RUNGS];   ///< Fraction of the entities screened at each rung promoted past it.
+    
+    // Selection
+    SELECTION selection;        ///< How survivors and parents are chosen.
+    int elitism;                ///< Fittest entities kept unchanged, or 0 for the default.
+    int tournamentSize;         ///< Entities per tournament, or 0 for the default.
 } GENETIC_REQUEST;
 
 /**********************************************************//**
@@ -71,18 +171,48 @@ typedef struct {
     // Individuals
     size_t entitySize;          ///< The size of each organism's data.
     int populationSize;         ///< The number of entities in the population.
+    uint64_t seed;              ///< Seed all random streams derive from.
+    int generation;             ///< The number of generations run so far.
     
     // Functions
     RANDOM_FUNCTION random;     ///< Generates a random entity.
     BREEDING_FUNCTION breed;    ///< Breeds two entities.
-    FITNESS_FUNCTION fitness;   ///< Gets the fitness of the entity.
+    FITNESS_FUNCTION fitness;   ///< Gets the fitness of the entity, or NULL.
+    BATCH_FITNESS_FUNCTION batchFitness;    ///< Preferred over fitness when not NULL.
+    int batchSize;              ///< Entities per batch.
+    COST_FUNCTION cost;         ///< Estimates the fitness cost, or NULL.
+    COMPACT_FUNCTION compact;   ///< Reclaims storage outside the entities, or NULL.
+    SCREEN_FUNCTION screen;     ///< Cheap estimates of the fitness, or NULL.
+    int nRungs;                 ///< Rungs of the screening ladder.
+    float promote[MAX_RUNGS];   ///< Fraction of the entities screened at each rung promoted past it.
+    
+    // Selection
+    SELECTION selection;        ///< How survivors and parents are chosen.
+    int elitism;                ///< Fittest entities kept unchanged.
+    int tournamentSize;         ///< Entities per tournament.
     
     // Storage information
     void *entities;             ///< The actual creature data stored in any order.
-    HEAP heap;                  ///< Heap used to sort organisms.
-    void *newborn;              ///< List used to capture all the newborn creatures.
+    float *scores;              ///< The fitness of each entity this generation.
+    float *costs;               ///< The estimated cost of each evaluation.
+    float *screens;             ///< The cheap fitness of each screened entity, one array per rung.
+    int *rungs;                 ///< Rungs each entity was screened at this generation.
+    int rung;                   ///< The rung being screened.
+    float *ranks;               ///< Values and ranks compared by the correlation.
+    int *order;                 ///< Indices sorted while ranking values.
+    float *results;             ///< Fitness of each queued entity from batchFitness.
+    int *ranking;               ///< Entity indices from most to least fit.
+    int *queue;                 ///< Entity indices waiting to be evaluated.
+    int nQueued;                ///< Number of entities in the queue.
+    void **batch;               ///< Entity pointers handed to batchFitness.
+    void *spare;                ///< Buffer the next generation is bred into, or NULL.
+    int *parents;               ///< Parents of each child, in pairs.
+    int nSurvivors;             ///< Leading ranks still holding survivors.
+    HEAP heap;                  ///< Heap used to sort screened organisms.
+    POOL pool;                  ///< Workers used to evaluate and breed.
     void *best;                 ///< The best individual in the population.
     float bestFitness;          ///< The fitness of the best individual.
+    float correlation[MAX_RUNGS];   ///< Rank correlation of each rung with the full fitness.
 } GENETIC;
 
 /**********************************************************//**
@@ -113,7 +243,94 @@ static inline float genetic_BestFitness(const GENETIC *data) {
 }
 
 /**********************************************************//**
- * @brief Runs one generation of the genetic algorithm.
+ * @brief Get how well a rung of the screen predicted the
+ * fitness in the last generation, as the Spearman rank
+ * correlation between the cheap and full fitness of every
+ * entity evaluated both ways. Those are the entities promoted
+ * past the last rung and a sample of those rejected at the
+ * rung or after it, so a value near 1 means the rung ranks
+ * newborn the way the full evaluation would. Tied values
+ * share the average of their ranks.
+ * @param data: Genetic algorithm data.
+ * @param rung: The rung of the ladder.
+ * @return The correlation from -1 to 1, or NAN if nothing was
+ * screened at the rung.
+ **************************************************************/
+static inline float genetic_Correlation(const GENETIC *data, int rung) {
+    return data->correlation[rung];
+}
+
+/**********************************************************//**
+ * @brief Get a survivor of the last generation by rank. These
+ * are the elites, which are carried over unchanged. With
+ * SELECTION_TRUNCATION only the first and last survivors are
+ * in rank order, and the rest are in no particular order.
+ * @param data: Genetic algorithm data.
+ * @param rank: The rank, starting from 0 for the best.
+ * @param fitness: Location to store the survivor's fitness.
+ * @return Pointer to the entity, or NULL if there is no
+ * survivor with that rank.
+ **************************************************************/
+extern const void *genetic_Survivor(const GENETIC *data, int rank, float *fitness);
+
+/**********************************************************//**
+ * @brief Get the fitness an entity must beat to survive the
+ * next generation. The survivors keep their place, so as long
+ * as the fitness function gives them the same fitness again,
+ * an entity less fit than the last of them is ranked below
+ * all of them and killed. The evaluator may stop evaluating
+ * an entity once it is sure to be less fit than this. This
+ * only holds for the truncating strategies; the others may
+ * pick any entity as a parent.
+ * @param data: Genetic algorithm data.
+ * @return The fitness of the least fit survivor, or INFINITY
+ * when there are no survivors or the selection does not
+ * truncate.
+ **************************************************************/
+extern float genetic_Cutoff(const GENETIC *data);
+
+/**********************************************************//**
+ * @brief Brings an outside entity into the population in
+ * place of one of the least fit newborn. Survivors are never
+ * replaced.
+ * @param data: Genetic algorithm data.
+ * @param entity: The entity to copy in.
+ * @param n: Which newborn to replace, starting from 0 for the
+ * one ranked last.
+ * @return Whether there was a newborn to replace.
+ **************************************************************/
+extern bool genetic_Immigrate(GENETIC *data, const void *entity, int n);
+
+/**********************************************************//**
+ * @brief Gets the name of a selection strategy.
+ * @param selection: The strategy to name.
+ * @return The name of the strategy.
+ **************************************************************/
+extern const char *genetic_SelectionName(SELECTION selection);
+
+/**********************************************************//**
+ * @brief Looks up a selection strategy by name.
+ * @param name: The name, as from genetic_SelectionName.
+ * @param selection: Location to store the strategy.
+ * @return Whether there is a strategy with that name.
+ **************************************************************/
+extern bool genetic_FindSelection(const char *name, SELECTION *selection);
+
+/**********************************************************//**
+ * @brief Runs one generation of the genetic algorithm. With a
+ * screen, every entity but the survivors climbs the ladder:
+ * it is evaluated with each rung in turn, and only the
+ * promoted fraction of the entities at a rung with the best
+ * cheap fitness there go on to the next rung, and past the
+ * last to the full evaluation. At every rung at least enough
+ * are promoted to give all the elites a full fitness. The
+ * entities the screen says are known leave the ladder for the
+ * full evaluation without taking a place from the others, and
+ * are left out of the correlation. A sample of the rest is
+ * evaluated in full to measure the correlation, and keeps
+ * its fitness. The others are given infinite fitness, so they
+ * are ranked last and killed. Once the parents are chosen,
+ * the compact function is given the survivors and the parents.
  * @param data: Algorithm data.
  **************************************************************/
 extern void genetic_Generation(GENETIC *data);
@@ -130,14 +347,47 @@ extern void genetic_Generation(GENETIC *data);
  **************************************************************/
 extern int genetic_Solve(GENETIC *data, float fitness, int timeout);
 
+/**********************************************************//**
+ * @brief Runs a steady-state version of the algorithm with no
+ * generation barrier. Every worker repeatedly picks two parents
+ * by tournament, breeds them, evaluates the children and lets
+ * each child replace the loser of a reverse tournament if the
+ * child is fitter. Only the selection and replacement hold the
+ * population lock, so all workers stay busy. Results are only
+ * reproducible from the seed with a single thread.
+ * Children are always evaluated in full, without the screen.
+ * With a compact function, the workers pause every population
+ * size births so it can be given the whole population.
+ * @param data: Algorithm configuration.
+ * @param fitness: The minimum desired fitness of the best
+ * indivual. This will run until an individual with fitness
+ * less than or equal to this value is found.
+ * @param timeout: The maximum number of children to breed,
+ * or TIMEOUT_NONE if infinite is desired.
+ * @return The number of children bred.
+ **************************************************************/
+extern long genetic_SteadyState(GENETIC *data, float fitness, long timeout);
+
 /**********************************************************//**
  * @brief Destroy the algorithm data.
  * @param data: Algorithm data to get rid of.
  **************************************************************/
 static inline void genetic_Destroy(GENETIC *data) {
+    pool_Destroy(&data->pool);
     heap_Destroy(&data->heap);
     free(data->entities);
-    free(data->newborn);
+    free(data->scores);
+    free(data->costs);
+    free(data->screens);
+    free(data->rungs);
+    free(data->ranks);
+    free(data->order);
+    free(data->results);
+    free(data->ranking);
+    free(data->queue);
+    free(data->batch);
+    free(data->spare);
+    free(data->parents);
 }
 
 /*============================================================*/
@@ -0,0 +1,801 @@
+/**********************************************************//**
+ * @file genome.c
+ * @brief Implementation of the heritable description of a
+ * creature and the genetic operators on it.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdint.h>         // uint16_t, uint32_t, uint64_t
+#include <stdlib.h>         // malloc, calloc, free, qsort, exit
+#include <string.h>         // memcpy, memmove
+#include <math.h>           // round
+#include <pthread.h>        // pthread_mutex_lock, pthread_mutex_unlock
+
+// This project
+#include "debug.h"          // eprintf
+#include "vector.h"         // VECTOR
+#include "rng.h"            // RNG, rng_Mix
+#include "genome.h"         // GENOME
+
+//**************************************************************
+/// @brief Probability that a random action stream will contain
+/// an actual action as opposed to a wait / stop action.
+#define ACTION_DENSITY 0.5
+
+/// Maximum number of mutations per creature.
+#define MAX_MUTATIONS 4
+
+/// Relative cost of updating one NODE for one time step.
+#define NODE_COST 1.5
+
+/// Relative cost of updating one MUSCLE for one time step.
+#define MUSCLE_COST 1.0
+
+// Genes are stored end to end in a GENE_ARENA
+__extension__ _Static_assert(sizeof(PACKED_NODE) % GENE_ALIGN == 0, "PACKED_NODE is not aligned");
+__extension__ _Static_assert(sizeof(PACKED_MUSCLE) % GENE_ALIGN == 0, "PACKED_MUSCLE is not aligned");
+
+/**********************************************************//**
+ * @brief Generate a random node. Assume all nodes reside
+ * inside the unit hemisphere for simplicity.
+ * @param genome: The genome to generate for.
+ * @param index: The node to generate.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void GenerateNode(GENOME *genome, int index, RNG *rng) {
+    // Node to generate
+    NODE_GENE *node = &genome->nodes[index];
+    
+    // Initialize this node's position
+    node->initial.x = rng_Uniform(rng, MIN_POSITION, MAX_POSITION);
+    node->initial.y = rng_Uniform(rng, 0.0, MAX_POSITION);
+    node->initial.z = rng_Uniform(rng, MIN_POSITION, MAX_POSITION);
+    
+    // Random frictionness
+    node->friction = rng_Uniform(rng, MIN_FRICTION, MAX_FRICTION);
+}
+
+/**********************************************************//**
+ * @brief Generate a random muscle. This must ensure all
+ * the nodes are attached to each other so we don't get
+ * a weird degenerate creature.
+ * @param genome: The genome to generate for.
+ * @param index: The muscle to generate.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+static void GenerateMuscle(GENOME *genome, int index, RNG *rng) {
+    // Muscle to generate
+    MUSCLE_GENE *muscle = &genome->muscles[index];
+    
+    // Forced muscle connection for each node
+    if (index < genome->nNodes) {
+        muscle->first = index;
+    
+        // Ensure the creature is fully connected. The
+        // proof that this works comes from induction:
+        // if the first n nodes are fully connected and
+        // we must attach node n+1 to one of the previous
+        // n nodes, then the n+1 nodes are fully connected.
+        if (muscle->first > 0) {
+            muscle->second = rng_Randint(rng, 0, index-1);
+        } else {
+            muscle->second = 0;
+        }
+    } else {
+        muscle->first = rng_Randint(rng, 0, genome->nNodes-1);
+        muscle->second = rng_Randint(rng, 0, genome->nNodes-1);
+    }
+    
+    // Ban self-edges from appearing
+    if (muscle->first == muscle->second) {
+        // Jump to next if a self-muscle appears
+        muscle->second = (muscle->second + 1) % genome->nNodes;
+    }
+    
+    // Get the actual muscle length from the initial state.
+    const NODE_GENE *first = &genome->nodes[muscle->first];
+    const NODE_GENE *second = &genome->nodes[muscle->second];
+    VECTOR delta = second->initial;
+    vector_Subtract(&delta, &first->initial);
+    float length = vector_Length(&delta);
+    
+    // Get random contract or expand lengths
+    muscle->extended = length;
+    muscle->contracted = rng_Uniform(rng, length/2.0, length);
+    
+    // Random muscle strength
+    muscle->strength = rng_Uniform(rng, MIN_STRENGTH, MAX_STRENGTH);
+}
+
+/*============================================================*
+ * Random genome generation
+ *============================================================*/
+void genome_CreateRandom(GENOME *genome, RNG *rng) {
+    // Create random nodes and muscles
+    genome->nNodes = rng_Randint(rng, MIN_NODES, MAX_NODES);
+    genome->nMuscles = rng_Randint(rng, genome->nNodes, MAX_MUSCLES);
+    
+    // Generate initial fitness memo.
+    genome->fitness = FITNESS_INVALID;
+    
+    // Generate the creature parts
+    for (int i = 0; i < genome->nNodes; i++) {
+        GenerateNode(genome, i, rng);
+    }
+    for (int i = 0; i < genome->nMuscles; i++) {
+        GenerateMuscle(genome, i, rng);
+    }
+    
+    // Make the creature's motion
+    for (int i = 0; i < MAX_ACTIONS; i++) {
+        if (rng_Uniform(rng, 0.0, 1.0) < ACTION_DENSITY) {
+            // Generate a real action
+            genome->behavior.action[i] = rng_Randint(rng, 0, genome->nMuscles-1);
+        } else {
+            // Generate a no-op
+            genome->behavior.action[i] = MUSCLE_NONE;
+        }
+    }
+}
+
+/**********************************************************//**
+ * @enum MUTATION
+ * @brief Lists all the possible mutations that can occur.
+ **************************************************************/
+typedef enum {
+    NODE_ADD,               ///< Add an extra node.
+    NODE_REMOVE,            ///< Delete one of the nodes.
+    NODE_POSITION,          ///< Change the start position of a node.
+    NODE_FRICTION,          ///< Change the friction corfficient of the node.
+    MUSCLE_ANCHOR,          ///< Change where a muscle is attached.
+    MUSCLE_EXTENDED,        ///< Change the muscle extended length.
+    MUSCLE_CONTRACTED,      ///< Change the muscle contract length.
+    MUSCLE_STRENGTH,        ///< Change the muscle power.
+    MUSCLE_ADD,             ///< Add a new muscle.
+    MUSCLE_REMOVE,          ///< Remove one muscle.
+    BEHAVIOR_ADD,           ///< Add an action to the motion.
+    BEHAVIOR_REMOVE,        ///< Remove an action from the motion.
+} MUTATION;
+
+/// The number of unique possible mutations.
+#define N_MUTATIONS 10
+
+/**********************************************************//**
+ * @brief Fix all the muscles in the genome, if they point
+ * to nodes that no longer exist in the creature.
+ * @param genome: The genome to fix.
+ **************************************************************/
+static inline void FixMuscles(GENOME *genome) {
+    for (int i = 0; i < genome->nMuscles; i++) {
+        MUSCLE_GENE *muscle = &genome->muscles[i];
+        if (muscle->first >= genome->nNodes || muscle->second >= genome->nNodes) {
+            muscle->first = muscle->first % genome->nNodes;
+            muscle->second = muscle->second % genome->nNodes;
+            if (muscle->first == muscle->second) {
+                muscle->second = (muscle->second + 1) % genome->nNodes;
+            }
+        }
+    }
+}
+
+/*============================================================*
+ * Randomly mutate the genome
+ *============================================================*/
+void genome_Mutate(GENOME *genome, RNG *rng) {
+    // Pick any mutation to occur
+    MUTATION mutation = rng_Randint(rng, 0, N_MUTATIONS-1);
+    
+    // Pre-generate all the random numbers
+    NODE_GENE *node = &genome->nodes[rng_Randint(rng, 0, genome->nNodes-1)];
+    MUSCLE_GENE *muscle = &genome->muscles[rng_Randint(rng, 0, genome->nMuscles-1)];
+    int action = rng_Randint(rng, 0, MAX_ACTIONS-1);
+    
+    // Apply the mutations
+    switch (mutation) {
+    case NODE_POSITION:
+        // Change a random node position
+        node->initial.x = rng_Uniform(rng, MIN_POSITION, MAX_POSITION);
+        node->initial.y = rng_Uniform(rng, 0.0, MAX_POSITION);
+        node->initial.z = rng_Uniform(rng, MIN_POSITION, MAX_POSITION);
+        break;
+    
+    case NODE_FRICTION:
+        // Change a random node friction
+        node->friction = rng_Uniform(rng, MIN_FRICTION, MAX_FRICTION);
+        break;
+    
+    case NODE_ADD:
+        // Add a new node
+        if (genome->nNodes < MAX_NODES) {
+            GenerateNode(genome, genome->nNodes++, rng);
+        }
+        break;
+    
+    case NODE_REMOVE:
+        // Add a new node
+        if (genome->nNodes > MIN_NODES) {
+            genome->nNodes--;
+        }
+        FixMuscles(genome);
+        break;
+    
+    case MUSCLE_ANCHOR:
+        // Changes a random muscle anchor point
+        muscle->second = rng_Randint(rng, 0, genome->nNodes-1);
+        if (muscle->first == muscle->second) {
+            muscle->second = (muscle->second + 1) % genome->nNodes;
+        }
+        break;
+    
+    case MUSCLE_EXTENDED:
+        // Change a muscle extended length
+        muscle->extended = rng_Uniform(rng, muscle->contracted, MAX_MUSCLE_LENGTH);
+        break;
+    
+    case MUSCLE_CONTRACTED:
+        // Change muscle contracted length
+        muscle->contracted = rng_Uniform(rng, MIN_CONTRACTED_LENGTH, muscle->extended);
+        break;
+    
+    case MUSCLE_STRENGTH:
+        // Change muscle strength
+        muscle->strength = rng_Uniform(rng, MIN_STRENGTH, MAX_STRENGTH);
+        break;
+    
+    case MUSCLE_ADD:
+        // Add a muscle
+        if (genome->nMuscles < MAX_MUSCLES) {
+            GenerateMuscle(genome, genome->nMuscles++, rng);
+        }
+        break;
+    
+    case MUSCLE_REMOVE:
+        // Remove a muscle - but not a base connection
+        // muscle!
+        if (genome->nMuscles > genome->nNodes) {
+            genome->nMuscles--;
+        }
+        break;
+    
+    case BEHAVIOR_ADD:
+        // Add  anew action to the stream
+        genome->behavior.action[action] = rng_Randint(rng, 0, genome->nMuscles-1);
+        break;
+    
+    case BEHAVIOR_REMOVE:
+        // Delete an action from the stream
+        genome->behavior.action[action] = MUSCLE_NONE;
+        break;
+    
+    default:
+        // Should never happen
+        eprintf("Erroneous mutation: %d\n", mutation);
+        break;
+    }
+}
+
+/*============================================================*
+ * Genome breeding interchange
+ *============================================================*/
+void genome_Breed(const GENOME *mother, const GENOME *father, GENOME *child, RNG *rng) {
+    // Cross the genetic information of the mother and father to
+    // create child information.
+    
+    // Inherit body structure from either parent
+    if (rng_Randint(rng, 0, 1)) {
+        child->nNodes = mother->nNodes;
+        child->nMuscles = mother->nMuscles;
+    } else {
+        child->nNodes = father->nNodes;
+        child->nMuscles = father->nMuscles;
+    }
+    
+    // Generate initial fitness table.
+    child->fitness = FITNESS_INVALID;
+    
+    // Inherit actual node properties.
+    for (int i = 0; i < child->nNodes; i++) {
+        // Inherit this node from either parent
+        const GENOME *selected;
+        if ((rng_Randint(rng, 0, 1) == 0 && i < mother->nNodes) || i >= father->nNodes) {
+            selected = mother;
+        } else {
+            selected = father;
+        }
+    
+        // Copy over the node data
+        child->nodes[i] = selected->nodes[i];
+    }
+    
+    // Inherit muscles. These guarantee the new child is fully connected
+    // by the proof of either parent's nodes.
+    for (int i = 0; i < child->nMuscles; i++) {
+        // Inherit the muscle from either parent
+        const GENOME *selected;
+        if ((rng_Randint(rng, 0, 1) == 0 && i < mother->nMuscles) || i >= father->nMuscles) {
+            selected = mother;
+        } else {
+            selected = father;
+        }
+    
+        // Copy over the muscle data, ensuring that the
+        // node indices are actually valid nodes.
+        child->muscles[i] = selected->muscles[i];
+    }
+    
+    // We might need to fix up the muscles if we accidentally inherited a
+    // muscle that isn't compatible with the child's nodes.
+    FixMuscles(child);
+    
+    // Inherit behaviors: pick a cross-over point within
+    // the action stream and copy.
+    int crossover = rng_Randint(rng, 0, MAX_ACTIONS-1);
+    for (int j = 0; j < crossover; j++) {
+        child->behavior.action[j] = mother->behavior.action[j];
+    }
+    for (int j = crossover; j < MAX_ACTIONS; j++) {
+        child->behavior.action[j] = father->behavior.action[j];
+    }
+    
+    // Mutate the child at random
+    int nMutations = rng_Randint(rng, 0, MAX_MUTATIONS);
+    for (int i = 0; i < nMutations; i++) {
+        genome_Mutate(child, rng);
+    }
+}
+
+/**********************************************************//**
+ * @brief Rounds a gene to the nearest quantization level.
+ * @param value: The gene to round.
+ * @param low: The smallest value of the gene.
+ * @param high: The largest value of the gene.
+ * @return The level, from 0 to GENE_LEVELS.
+ **************************************************************/
+static inline uint16_t Quantize(float value, double low, double high) {
+    double level = round((value - low)/(high - low)*GENE_LEVELS);
+    if (!(level > 0.0)) {
+        return 0;
+    } else if (level > GENE_LEVELS) {
+        return GENE_LEVELS;
+    }
+    return (uint16_t)level;
+}
+
+/**********************************************************//**
+ * @brief Gets the gene at a quantization level. Quantize
+ * gives back the same level for it.
+ * @param level: The level, from 0 to GENE_LEVELS.
+ * @param low: The smallest value of the gene.
+ * @param high: The largest value of the gene.
+ * @return The gene.
+ **************************************************************/
+static inline float Level(uint16_t level, double low, double high) {
+    return low + (high - low)*level/GENE_LEVELS;
+}
+
+/**********************************************************//**
+ * @brief Gets the size of the genes of a genome in an arena.
+ * @param nNodes: The number of nodes.
+ * @param nMuscles: The number of muscles.
+ * @return The number of bytes, a multiple of GENE_ALIGN.
+ **************************************************************/
+static inline size_t GeneSize(int nNodes, int nMuscles) {
+    return sizeof(PACKED_NODE)*nNodes + sizeof(PACKED_MUSCLE)*nMuscles;
+}
+
+/**********************************************************//**
+ * @brief Gets the memory at a byte offset into an arena.
+ * @param arena: The arena.
+ * @param at: The offset, within an allocated chunk.
+ * @return Pointer to the memory.
+ **************************************************************/
+static inline unsigned char *Where(const GENE_ARENA *arena, uint64_t at) {
+    return arena->chunks[at/GENE_CHUNK] + at%GENE_CHUNK;
+}
+
+/**********************************************************//**
+ * @brief Gets the node genes of a genome.
+ * @param arena: The arena holding its genes.
+ * @param packed: The genome.
+ * @return Pointer to the nNodes node genes.
+ **************************************************************/
+static inline PACKED_NODE *Nodes(const GENE_ARENA *arena, const PACKED_GENOME *packed) {
+    return (PACKED_NODE *)Where(arena, (uint64_t)packed->genes*GENE_ALIGN);
+}
+
+/**********************************************************//**
+ * @brief Gets the muscle genes of a genome, which follow its
+ * node genes.
+ * @param arena: The arena holding its genes.
+ * @param packed: The genome.
+ * @return Pointer to the nMuscles muscle genes.
+ **************************************************************/
+static inline PACKED_MUSCLE *Muscles(const GENE_ARENA *arena, const PACKED_GENOME *packed) {
+    return (PACKED_MUSCLE *)(Nodes(arena, packed) + packed->nNodes);
+}
+
+/**********************************************************//**
+ * @brief Makes sure a chunk of the arena is allocated.
+ * @param arena: The arena.
+ * @param chunk: The chunk needed.
+ * @return Whether the chunk could be allocated.
+ **************************************************************/
+static bool Reserve(GENE_ARENA *arena, uint64_t chunk) {
+    if (__atomic_load_n(&arena->chunks[chunk], __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    pthread_mutex_lock(&arena->lock);
+    unsigned char *memory = arena->chunks[chunk];
+    if (!memory) {
+        memory = malloc(GENE_CHUNK);
+        __atomic_store_n(&arena->chunks[chunk], memory, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&arena->lock);
+    return memory != NULL;
+}
+
+/**********************************************************//**
+ * @brief Hands out space for the genes of one genome. Many
+ * threads may allocate at once without taking turns, except
+ * when a new chunk is needed. A population that has run out
+ * of memory cannot go on, so that ends the program.
+ * @param arena: The arena to allocate from.
+ * @param size: The bytes needed, a multiple of GENE_ALIGN.
+ * @return Where the space is, in units of GENE_ALIGN.
+ **************************************************************/
+static uint32_t Allocate(GENE_ARENA *arena, size_t size) {
+    while (true) {
+        uint64_t at = __atomic_fetch_add(&arena->used, size, __ATOMIC_RELAXED);
+        uint64_t chunk = at/GENE_CHUNK;
+        
+        // Genes never straddle two chunks, so the end of this
+        // chunk is skipped and the space after it is tried.
+        if ((at + size - 1)/GENE_CHUNK != chunk) {
+            continue;
+        }
+        if (chunk >= MAX_GENE_CHUNKS || !Reserve(arena, chunk)) {
+            eprintf("Out of memory for genes.\n");
+            exit(EXIT_FAILURE);
+        }
+        return (uint32_t)(at/GENE_ALIGN);
+    }
+}
+
+/*============================================================*
+ * Arena creation
+ *============================================================*/
+bool genome_CreateArena(GENE_ARENA *arena) {
+    arena->used = 0;
+    arena->chunks = calloc(MAX_GENE_CHUNKS, sizeof(unsigned char *));
+    if (!arena->chunks) {
+        eprintf("Failed to allocate gene arena.\n");
+        return false;
+    }
+    pthread_mutex_init(&arena->lock, NULL);
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Orders genomes by where their genes are.
+ * @param a: Pointer to the first PACKED_GENOME pointer.
+ * @param b: Pointer to the second PACKED_GENOME pointer.
+ * @return Negative, zero or positive as for qsort.
+ **************************************************************/
+static int ByGenes(const void *a, const void *b) {
+    uint32_t x = (*(PACKED_GENOME *const *)a)->genes;
+    uint32_t y = (*(PACKED_GENOME *const *)b)->genes;
+    return (x > y) - (x < y);
+}
+
+/*============================================================*
+ * Arena compaction
+ *============================================================*/
+void genome_Compact(GENE_ARENA *arena, PACKED_GENOME **genomes, int count) {
+    // Genes are slid down in the order they are stored, and
+    // packed the way Allocate would, so each lands no later
+    // than where it was and nothing is overwritten before it
+    // has been moved.
+    if (count > 0) {
+        qsort(genomes, count, sizeof(PACKED_GENOME *), &ByGenes);
+    }
+    uint64_t to = 0;
+    uint32_t from = 0;
+    uint32_t moved = 0;
+    for (int i = 0; i < count; i++) {
+        PACKED_GENOME *packed = genomes[i];
+        
+        // Copies of a genome share its genes, and a genome
+        // given twice has already been moved.
+        if (i > 0 && (packed->genes == from || packed->genes == moved)) {
+            packed->genes = moved;
+            continue;
+        }
+        size_t size = GeneSize(packed->nNodes, packed->nMuscles);
+        if ((to + size - 1)/GENE_CHUNK != to/GENE_CHUNK) {
+            to = (to/GENE_CHUNK + 1)*GENE_CHUNK;
+        }
+        from = packed->genes;
+        moved = (uint32_t)(to/GENE_ALIGN);
+        memmove(Where(arena, to), Where(arena, (uint64_t)from*GENE_ALIGN), size);
+        packed->genes = moved;
+        to += size;
+    }
+    arena->used = to;
+    
+    // Give back the chunks left empty, but keep the first
+    for (int chunk = (to + GENE_CHUNK - 1)/GENE_CHUNK; chunk < MAX_GENE_CHUNKS; chunk++) {
+        if (chunk > 0 && arena->chunks[chunk]) {
+            free(arena->chunks[chunk]);
+            arena->chunks[chunk] = NULL;
+        }
+    }
+}
+
+/*============================================================*
+ * Arena destruction
+ *============================================================*/
+void genome_DestroyArena(GENE_ARENA *arena) {
+    for (int chunk = 0; chunk < MAX_GENE_CHUNKS; chunk++) {
+        free(arena->chunks[chunk]);
+    }
+    free(arena->chunks);
+    arena->chunks = NULL;
+    pthread_mutex_destroy(&arena->lock);
+}
+
+/*============================================================*
+ * Genome packing
+ *============================================================*/
+void genome_Pack(const GENOME *genome, PACKED_GENOME *packed, GENE_ARENA *arena) {
+    packed->fitness = genome->fitness;
+    packed->nNodes = genome->nNodes;
+    packed->nMuscles = genome->nMuscles;
+    packed->genes = Allocate(arena, GeneSize(genome->nNodes, genome->nMuscles));
+    
+    // Only the live genes are quantized and stored
+    PACKED_NODE *nodes = Nodes(arena, packed);
+    for (int i = 0; i < genome->nNodes; i++) {
+        const NODE_GENE *node = &genome->nodes[i];
+        PACKED_NODE *out = &nodes[i];
+        out->x = Quantize(node->initial.x, MIN_POSITION, MAX_POSITION);
+        out->y = Quantize(node->initial.y, 0.0, MAX_POSITION);
+        out->z = Quantize(node->initial.z, MIN_POSITION, MAX_POSITION);
+        out->friction = Quantize(node->friction, MIN_FRICTION, MAX_FRICTION);
+    }
+    PACKED_MUSCLE *muscles = Muscles(arena, packed);
+    for (int i = 0; i < genome->nMuscles; i++) {
+        const MUSCLE_GENE *muscle = &genome->muscles[i];
+        PACKED_MUSCLE *out = &muscles[i];
+        out->first = muscle->first;
+        out->second = muscle->second;
+        out->extended = Quantize(muscle->extended, 0.0, MAX_INITIAL_LENGTH);
+        out->contracted = Quantize(muscle->contracted, 0.0, MAX_INITIAL_LENGTH);
+        out->strength = Quantize(muscle->strength, MIN_STRENGTH, MAX_STRENGTH);
+    }
+    packed->behavior = genome->behavior;
+}
+
+/*============================================================*
+ * Genome unpacking
+ *============================================================*/
+void genome_Unpack(GENOME *genome, const PACKED_GENOME *packed, const GENE_ARENA *arena) {
+    genome->fitness = packed->fitness;
+    genome->nNodes = packed->nNodes;
+    genome->nMuscles = packed->nMuscles;
+    const PACKED_NODE *nodes = Nodes(arena, packed);
+    for (int i = 0; i < packed->nNodes; i++) {
+        const PACKED_NODE *node = &nodes[i];
+        NODE_GENE *out = &genome->nodes[i];
+        out->initial.x = Level(node->x, MIN_POSITION, MAX_POSITION);
+        out->initial.y = Level(node->y, 0.0, MAX_POSITION);
+        out->initial.z = Level(node->z, MIN_POSITION, MAX_POSITION);
+        out->friction = Level(node->friction, MIN_FRICTION, MAX_FRICTION);
+    }
+    const PACKED_MUSCLE *muscles = Muscles(arena, packed);
+    for (int i = 0; i < packed->nMuscles; i++) {
+        const PACKED_MUSCLE *muscle = &muscles[i];
+        MUSCLE_GENE *out = &genome->muscles[i];
+        out->first = muscle->first;
+        out->second = muscle->second;
+        out->extended = Level(muscle->extended, 0.0, MAX_INITIAL_LENGTH);
+        out->contracted = Level(muscle->contracted, 0.0, MAX_INITIAL_LENGTH);
+        out->strength = Level(muscle->strength, MIN_STRENGTH, MAX_STRENGTH);
+    }
+    genome->behavior = packed->behavior;
+}
+
+/*============================================================*
+ * Simulation cost estimate
+ *============================================================*/
+float genome_Cost(const PACKED_GENOME *packed) {
+    // Every step runs three loops over the nodes, including
+    // the integrator, and one loop over the muscles.
+    return NODE_COST*packed->nNodes + MUSCLE_COST*packed->nMuscles;
+}
+
+/**********************************************************//**
+ * @brief Gets an action of a genome, with the actions on
+ * muscles it does not have, which do nothing, as MUSCLE_NONE.
+ * @param packed: The genome.
+ * @param i: The action slot.
+ * @return The muscle toggled, or MUSCLE_NONE.
+ **************************************************************/
+static inline int Action(const PACKED_GENOME *packed, int i) {
+    int action = packed->behavior.action[i];
+    return (action < packed->nMuscles)? action: MUSCLE_NONE;
+}
+
+/*============================================================*
+ * Canonical genome hash
+ *============================================================*/
+uint64_t genome_Hash(const PACKED_GENOME *packed, const GENE_ARENA *arena) {
+    // Each gene is gathered into a word by value, so neither
+    // padding nor where the genes are can change the hash.
+    uint64_t hash = rng_Mix(packed->nNodes | (uint64_t)packed->nMuscles << 8);
+    const PACKED_NODE *nodes = Nodes(arena, packed);
+    for (int i = 0; i < packed->nNodes; i++) {
+        const PACKED_NODE *node = &nodes[i];
+        uint64_t word = node->x | (uint64_t)node->y << 16
+            | (uint64_t)node->z << 32 | (uint64_t)node->friction << 48;
+        hash = rng_Mix(hash ^ word);
+    }
+    const PACKED_MUSCLE *muscles = Muscles(arena, packed);
+    for (int i = 0; i < packed->nMuscles; i++) {
+        const PACKED_MUSCLE *muscle = &muscles[i];
+        uint64_t word = muscle->first | (uint64_t)muscle->second << 8
+            | (uint64_t)muscle->extended << 16 | (uint64_t)muscle->contracted << 32
+            | (uint64_t)muscle->strength << 48;
+        hash = rng_Mix(hash ^ word);
+    }
+    for (int i = 0; i < MAX_ACTIONS; i += 8) {
+        uint64_t word = 0;
+        for (int k = 0; k < 8; k++) {
+            word |= (uint64_t)Action(packed, i + k) << 8*k;
+        }
+        hash = rng_Mix(hash ^ word);
+    }
+    return hash;
+}
+
+/**********************************************************//**
+ * @brief Writes a quantized gene as two little-endian bytes.
+ * @param buffer: Location to store the bytes.
+ * @param value: The level to write.
+ * @return Pointer just past the bytes written.
+ **************************************************************/
+static inline unsigned char *PutLevel(unsigned char *buffer, uint16_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = value >> 8;
+    return buffer + 2;
+}
+
+/**********************************************************//**
+ * @brief Reads a quantized gene stored by PutLevel.
+ * @param buffer: The bytes to read.
+ * @param value: Location to store the level.
+ * @return Pointer just past the bytes read.
+ **************************************************************/
+static inline const unsigned char *GetLevel(const unsigned char *buffer, uint16_t *value) {
+    *value = buffer[0] | (uint16_t)buffer[1] << 8;
+    return buffer + 2;
+}
+
+/**********************************************************//**
+ * @brief Gets the size of an encoded genome.
+ * @param nNodes: The number of nodes.
+ * @param nMuscles: The number of muscles.
+ * @return The number of bytes genome_Encode produces.
+ **************************************************************/
+static inline size_t EncodedSize(int nNodes, int nMuscles) {
+    return 4 + 8*nNodes + 8*nMuscles + MAX_ACTIONS;
+}
+
+/*============================================================*
+ * Wire format encoding
+ *============================================================*/
+size_t genome_Encode(const PACKED_GENOME *packed, unsigned char *buffer, const GENE_ARENA *arena) {
+    unsigned char *where = buffer;
+    
+    // Header
+    *where++ = GENOME_WIRE_VERSION;
+    *where++ = packed->nNodes;
+    *where++ = packed->nMuscles;
+    *where++ = 0;
+    
+    // Node genes
+    const PACKED_NODE *nodes = Nodes(arena, packed);
+    for (int i = 0; i < packed->nNodes; i++) {
+        const PACKED_NODE *node = &nodes[i];
+        where = PutLevel(where, node->x);
+        where = PutLevel(where, node->y);
+        where = PutLevel(where, node->z);
+        where = PutLevel(where, node->friction);
+    }
+    
+    // Muscle genes
+    const PACKED_MUSCLE *muscles = Muscles(arena, packed);
+    for (int i = 0; i < packed->nMuscles; i++) {
+        const PACKED_MUSCLE *muscle = &muscles[i];
+        *where++ = muscle->first;
+        *where++ = muscle->second;
+        where = PutLevel(where, muscle->extended);
+        where = PutLevel(where, muscle->contracted);
+        where = PutLevel(where, muscle->strength);
+    }
+    
+    // Behavior
+    for (int i = 0; i < MAX_ACTIONS; i++) {
+        *where++ = Action(packed, i);
+    }
+    return where - buffer;
+}
+
+/*============================================================*
+ * Wire format decoding
+ *============================================================*/
+bool genome_Decode(PACKED_GENOME *packed, const unsigned char *buffer, size_t size, GENE_ARENA *arena) {
+    const unsigned char *where = buffer;
+    
+    // Header
+    if (size < 4 || where[0] != GENOME_WIRE_VERSION) {
+        return false;
+    }
+    int nNodes = where[1];
+    int nMuscles = where[2];
+    where += 4;
+    if (nNodes < MIN_NODES || nNodes > MAX_NODES || nMuscles < MIN_MUSCLES || nMuscles > MAX_MUSCLES) {
+        return false;
+    }
+    if (size != EncodedSize(nNodes, nMuscles)) {
+        return false;
+    }
+    
+    // Node genes. Nothing is stored in the genome or the
+    // arena until the whole genome is known to be valid.
+    PACKED_NODE nodes[MAX_NODES];
+    for (int i = 0; i < nNodes; i++) {
+        PACKED_NODE *node = &nodes[i];
+        where = GetLevel(where, &node->x);
+        where = GetLevel(where, &node->y);
+        where = GetLevel(where, &node->z);
+        where = GetLevel(where, &node->friction);
+    }
+    
+    // Muscle genes, which must join two distinct live nodes
+    PACKED_MUSCLE muscles[MAX_MUSCLES];
+    for (int i = 0; i < nMuscles; i++) {
+        PACKED_MUSCLE *muscle = &muscles[i];
+        muscle->first = *where++;
+        muscle->second = *where++;
+        where = GetLevel(where, &muscle->extended);
+        where = GetLevel(where, &muscle->contracted);
+        where = GetLevel(where, &muscle->strength);
+        if (muscle->first >= nNodes || muscle->second >= nNodes || muscle->first == muscle->second) {
+            return false;
+        }
+    }
+    
+    // Behavior, which only toggles live muscles
+    MOTION behavior;
+    for (int i = 0; i < MAX_ACTIONS; i++) {
+        int action = where[i];
+        if (action != MUSCLE_NONE && action >= nMuscles) {
+            return false;
+        }
+        behavior.action[i] = action;
+    }
+    packed->behavior = behavior;
+    packed->nNodes = nNodes;
+    packed->nMuscles = nMuscles;
+    packed->genes = Allocate(arena, GeneSize(nNodes, nMuscles));
+    memcpy(Nodes(arena, packed), nodes, sizeof(PACKED_NODE)*nNodes);
+    memcpy(Muscles(arena, packed), muscles, sizeof(PACKED_MUSCLE)*nMuscles);
+    packed->fitness = FITNESS_INVALID;
+    return true;
+}
+
+/*============================================================*/
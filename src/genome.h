@@ -0,0 +1,329 @@
+/**********************************************************//**
+ * @file genome.h
+ * @brief Declaration of the heritable description of a
+ * creature and the genetic operators on it.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _GENOME_H_
+#define _GENOME_H_
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdbool.h>        // bool
+#include <stdint.h>         // uint8_t, uint16_t, uint32_t, uint64_t
+#include <pthread.h>        // pthread_mutex_t
+
+// This project
+#include "vector.h"         // VECTOR
+#include "rng.h"            // RNG
+
+//**************************************************************
+// Node amounts
+#define MIN_NODES 4         ///< Minimum number of NODEs needed per creature.
+#define MAX_NODES 16        ///< Maximum number of NODEs per creature.
+
+// Node properties
+#define MIN_POSITION -1.0   ///< Minimum initial XZ position of a NODE.
+#define MAX_POSITION 1.0    ///< Maximum initial XZ position of a NODE.
+#define MIN_FRICTION 0.1    ///< Minimum friction of a NODE.
+#define MAX_FRICTION 2.0    ///< Maximum friction of a NODE.
+
+//**************************************************************
+/// Maximum number of MUSCLEs per creature.
+#define MAX_MUSCLES 64
+
+/// @brief Minimum number of MUSCLEs per creature. Random genomes
+/// have at least one per node, and a muscle is only removed
+/// while there are more muscles than nodes.
+#define MIN_MUSCLES MIN_NODES
+
+/// @brief The maximum number of actions occurring in
+/// one period of a cyclic MOTION.
+#define MAX_ACTIONS 64
+
+// Configurations
+#define MIN_STRENGTH 1.0    ///< The minumum strength of a MUSCLE.
+#define MAX_STRENGTH 20.0   ///< Maximum strength of a MUSCLE.
+
+/// The minimum length of a contracted MUSCLE.
+#define MIN_CONTRACTED_LENGTH 0.25
+
+/// The minumum length of an extended MUSCLE.
+#define MIN_EXTENDED_LENGTH 0.5
+
+/// The maximum length of a MUSCLE in any state.
+#define MAX_MUSCLE_LENGTH 2.0
+
+/// @brief The longest a MUSCLE can start out, across the box
+/// the initial node positions are drawn from.
+#define MAX_INITIAL_LENGTH 3.0
+
+/**********************************************************//**
+ * @struct MOTION
+ * @brief Defines a a list of muscle indexes to contract or
+ * expand. Each muscle has its state flipped when this occurs.
+ * If MUSCLE_NONE is specified, then nothing happens and
+ * playback is essentially sustained for that action.
+ **************************************************************/
+typedef struct {
+    /// List of muscle indices to contract or expand.
+    unsigned char action[MAX_ACTIONS];
+} MOTION;
+
+//**************************************************************
+/// Signals that no muscle should contract.
+#define MUSCLE_NONE 255
+
+/// Invalid fitness amount.
+#define FITNESS_INVALID -1.0
+
+/**********************************************************//**
+ * @struct NODE_GENE
+ * @brief The heritable properties of a NODE.
+ **************************************************************/
+typedef struct {
+    VECTOR initial;         ///< The initial position.
+    float friction;         ///< Coefficient of friction.
+} NODE_GENE;
+
+/**********************************************************//**
+ * @struct MUSCLE_GENE
+ * @brief The heritable properties of a MUSCLE.
+ **************************************************************/
+typedef struct {
+    int first;              ///< The index of the first NODE.
+    int second;             ///< The index of the second NODE.
+    float extended;         ///< Extended muscle length.
+    float contracted;       ///< Contracted muscle length.
+    float strength;         ///< Stiffness of the muscle.
+} MUSCLE_GENE;
+
+/**********************************************************//**
+ * @struct GENOME
+ * @brief Everything a creature inherits, without any of the
+ * state of simulating it. This is what the population holds;
+ * a CREATURE is grown from it to be simulated.
+ **************************************************************/
+typedef struct {
+    int nNodes;             ///< Number of distinct nodes.
+    int nMuscles;           ///< Number of distinct muscles.
+    NODE_GENE nodes[MAX_NODES];     ///< Node genes, of which nNodes are used.
+    MUSCLE_GENE muscles[MAX_MUSCLES];   ///< Muscle genes, of which nMuscles are used.
+    MOTION behavior;        ///< The actions of one period of the walk.
+    float fitness;          ///< Memoized fitness, or FITNESS_INVALID.
+} GENOME;
+
+/**********************************************************//**
+ * @brief Generates an entirely random genome.
+ * @param genome: Data is stored at this location.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+extern void genome_CreateRandom(GENOME *genome, RNG *rng);
+
+/**********************************************************//**
+ * @brief Applies a random mutation to some aspect of the
+ * genome. This can mutate the initial node position, node
+ * friction, muscle properties and attachment, and actions
+ * found within a behavior.
+ * @param genome: The data to mutate.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+extern void genome_Mutate(GENOME *genome, RNG *rng);
+
+/**********************************************************//**
+ * @brief Recombines the parent genes to create a child genome.
+ * @param mother: The genes of one parent.
+ * @param father: The genes of the other parent.
+ * @param child: Location to store the child genes at.
+ * @param rng: The random stream to draw from.
+ **************************************************************/
+extern void genome_Breed(const GENOME *mother, const GENOME *father, GENOME *child, RNG *rng);
+
+//**************************************************************
+/// Largest level of a gene quantized to 16 bits.
+#define GENE_LEVELS 65535
+
+/**********************************************************//**
+ * @struct PACKED_NODE
+ * @brief A NODE_GENE with every property quantized to 16 bits
+ * within its range.
+ **************************************************************/
+typedef struct {
+    uint16_t x;             ///< Initial X position.
+    uint16_t y;             ///< Initial Y position.
+    uint16_t z;             ///< Initial Z position.
+    uint16_t friction;      ///< Coefficient of friction.
+} PACKED_NODE;
+
+/**********************************************************//**
+ * @struct PACKED_MUSCLE
+ * @brief A MUSCLE_GENE with byte node indices and every length
+ * and strength quantized to 16 bits within its range.
+ **************************************************************/
+typedef struct {
+    uint8_t first;          ///< The index of the first NODE.
+    uint8_t second;         ///< The index of the second NODE.
+    uint16_t extended;      ///< Extended muscle length.
+    uint16_t contracted;    ///< Contracted muscle length.
+    uint16_t strength;      ///< Stiffness of the muscle.
+} PACKED_MUSCLE;
+
+//**************************************************************
+/// Bytes in each chunk of a GENE_ARENA, a power of two.
+#define GENE_CHUNK (1 << 20)
+
+/// Largest number of chunks in a GENE_ARENA.
+#define MAX_GENE_CHUNKS 32768
+
+/// Alignment of the genes of each genome in a GENE_ARENA.
+#define GENE_ALIGN 8
+
+/**********************************************************//**
+ * @struct GENE_ARENA
+ * @brief Storage for the node and muscle genes of a whole
+ * population, so each genome only takes the space of the genes
+ * it uses. Genes are appended in chunks and never changed, so
+ * a PACKED_GENOME can be copied byte for byte and its copies
+ * share them. Space no genome refers to any more is reclaimed
+ * by genome_Compact. The genes of one population are private
+ * to its process; genomes cross to other processes through
+ * genome_Encode.
+ **************************************************************/
+typedef struct {
+    unsigned char **chunks; ///< Every chunk, or NULL if not allocated yet.
+    uint64_t used;          ///< Bytes handed out, including skipped chunk ends.
+    pthread_mutex_t lock;   ///< Held while allocating a chunk.
+} GENE_ARENA;
+
+/**********************************************************//**
+ * @struct PACKED_GENOME
+ * @brief The compact form of a GENOME the population is stored
+ * in. Its nodes, followed by its muscles, are kept in a
+ * GENE_ARENA, and only the counts, the behavior and where the
+ * genes are stay in the genome itself. Every GENOME the
+ * simulation sees is unpacked from one of these, so
+ * quantizing loses nothing: packing an unpacked genome gives
+ * back the same genes.
+ **************************************************************/
+typedef struct {
+    float fitness;          ///< Memoized fitness, or FITNESS_INVALID.
+    uint32_t genes;         ///< Where the genes are in the arena, in units of GENE_ALIGN.
+    uint8_t nNodes;         ///< Number of distinct nodes.
+    uint8_t nMuscles;       ///< Number of distinct muscles.
+    MOTION behavior;        ///< The actions of one period of the walk.
+} PACKED_GENOME;
+
+/**********************************************************//**
+ * @brief Creates an empty arena.
+ * @param arena: The arena to initialize.
+ * @return Whether the arena could be allocated.
+ **************************************************************/
+extern bool genome_CreateArena(GENE_ARENA *arena);
+
+/**********************************************************//**
+ * @brief Reclaims the genes no genome refers to any more. The
+ * genes of the given genomes are moved towards the start of
+ * the arena and the genomes are pointed at their new place,
+ * and every other genome in the arena becomes invalid. No
+ * genome may be packed, unpacked or decoded at the same time.
+ * @param arena: The arena to compact.
+ * @param genomes: Every genome still in use, in any order,
+ * which are sorted by where their genes are.
+ * @param count: The number of genomes.
+ **************************************************************/
+extern void genome_Compact(GENE_ARENA *arena, PACKED_GENOME **genomes, int count);
+
+/**********************************************************//**
+ * @brief Gets how many bytes of genes the arena holds.
+ * @param arena: The arena to inspect.
+ * @return The bytes handed out since the last compaction
+ * and before, including any skipped at the end of a chunk.
+ **************************************************************/
+static inline uint64_t genome_ArenaSize(const GENE_ARENA *arena) {
+    return __atomic_load_n(&arena->used, __ATOMIC_RELAXED);
+}
+
+/**********************************************************//**
+ * @brief Frees the arena and all the genes in it.
+ * @param arena: The arena to destroy.
+ **************************************************************/
+extern void genome_DestroyArena(GENE_ARENA *arena);
+
+/**********************************************************//**
+ * @brief Quantizes the genome into its compact form, rounding
+ * each gene to the nearest of GENE_LEVELS+1 levels spanning
+ * its range. The memoized fitness is copied along with it.
+ * This may be called from several threads at once.
+ * @param genome: The genome to pack.
+ * @param packed: Location to store the compact genome.
+ * @param arena: The arena to store the genes in.
+ **************************************************************/
+extern void genome_Pack(const GENOME *genome, PACKED_GENOME *packed, GENE_ARENA *arena);
+
+/**********************************************************//**
+ * @brief Expands a compact genome back into one that can be
+ * bred or grown into a CREATURE.
+ * @param genome: Location to store the genome.
+ * @param packed: The compact genome.
+ * @param arena: The arena holding its genes.
+ **************************************************************/
+extern void genome_Unpack(GENOME *genome, const PACKED_GENOME *packed, const GENE_ARENA *arena);
+
+/**********************************************************//**
+ * @brief Estimates how long simulating a creature grown from
+ * the genome takes, from its size alone.
+ * @param packed: The genome to inspect.
+ * @return The relative cost of one update step.
+ **************************************************************/
+extern float genome_Cost(const PACKED_GENOME *packed);
+
+/**********************************************************//**
+ * @brief Hashes the genes of a compact genome. Only the live
+ * nodes and muscles and the behavior are hashed, not the
+ * memoized fitness, and actions on muscles the genome does
+ * not have count as MUSCLE_NONE, so genomes that grow
+ * identical creatures hash the same.
+ * @param packed: The genome to hash.
+ * @param arena: The arena holding its genes.
+ * @return A 64-bit hash of the genes.
+ **************************************************************/
+extern uint64_t genome_Hash(const PACKED_GENOME *packed, const GENE_ARENA *arena);
+
+//**************************************************************
+/// Version of the genome_Encode wire format.
+#define GENOME_WIRE_VERSION 2
+
+/// Largest number of bytes genome_Encode can produce.
+#define GENOME_WIRE_SIZE (4 + 8*MAX_NODES + 8*MAX_MUSCLES + MAX_ACTIONS)
+
+/**********************************************************//**
+ * @brief Serializes the compact genome into a portable byte
+ * stream. Only the live nodes and muscles are written, actions
+ * on muscles the genome does not have are written as
+ * MUSCLE_NONE, and the fitness is not included.
+ * @param packed: The genome to encode.
+ * @param buffer: Location to store the bytes, which must hold
+ * at least GENOME_WIRE_SIZE bytes.
+ * @param arena: The arena holding its genes.
+ * @return The number of bytes written.
+ **************************************************************/
+extern size_t genome_Encode(const PACKED_GENOME *packed, unsigned char *buffer, const GENE_ARENA *arena);
+
+/**********************************************************//**
+ * @brief Rebuilds a compact genome from genome_Encode output,
+ * with no memoized fitness. The whole genome is checked before
+ * anything is stored, so invalid bytes leave both the genome
+ * and the arena untouched.
+ * @param packed: Location to store the genome.
+ * @param buffer: The encoded bytes.
+ * @param size: The number of bytes available.
+ * @param arena: The arena to store the genes in.
+ * @return Whether the bytes held a valid genome.
+ **************************************************************/
+extern bool genome_Decode(PACKED_GENOME *packed, const unsigned char *buffer, size_t size, GENE_ARENA *arena);
+
+/*============================================================*/
+#endif // _GENOME_H_
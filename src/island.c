@@ -0,0 +1,443 @@
+/**********************************************************//**
+ * @file island.c
+ * @brief Implementation of an island model running several
+ * genetic algorithm populations in separate processes.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdbool.h>        // bool
+#include <stdint.h>         // uint32_t
+#include <stdio.h>          // snprintf, fflush
+#include <stdlib.h>         // malloc
+#include <string.h>         // memcpy
+#include <math.h>           // INFINITY
+
+// External libraries
+#ifndef WINDOWS
+#include <unistd.h>         // fork, ftruncate, _exit
+#include <fcntl.h>          // O_CREAT, O_RDWR
+#include <sys/mman.h>       // shm_open, mmap
+#include <sys/wait.h>       // waitpid
+#endif
+
+// This project
+#include "debug.h"          // eprintf
+#include "pool.h"           // CACHE_LINE
+#include "genetic.h"        // GENETIC
+#include "island.h"         // ISLAND_REQUEST
+
+#ifndef WINDOWS
+//**************************************************************
+/// Migrations each connection can buffer before dropping some.
+#define RING_DEPTH 2
+
+/// Offset of the entity data within a shared slot.
+#define ENTITY_OFFSET 16
+
+/// Offset of the size of the entity data within a migrant slot.
+#define SIZE_OFFSET 4
+
+/**********************************************************//**
+ * @struct RING
+ * @brief Header of a single-producer single-consumer ring
+ * of migrants in shared memory. The sender only writes the
+ * tail and the receiver only writes the head, and the two
+ * live on separate cache lines.
+ **************************************************************/
+typedef struct {
+    unsigned long tail;     ///< Number of migrants ever sent.
+    char tailPadding[CACHE_LINE - sizeof(unsigned long)];
+    unsigned long head;     ///< Number of migrants ever received.
+    char headPadding[CACHE_LINE - sizeof(unsigned long)];
+} RING;
+
+/**********************************************************//**
+ * @struct ISLAND_RESULT
+ * @brief Header of the slot where an island leaves its best
+ * entity when it finishes. The entity follows the header.
+ **************************************************************/
+typedef struct {
+    float fitness;          ///< Fitness of the best entity.
+    int generations;        ///< Generations the island ran.
+    bool success;           ///< Whether the island ran at all.
+    uint32_t size;          ///< Bytes of entity data.
+} ISLAND_RESULT;
+
+// The result header is followed by the entity
+__extension__ _Static_assert(sizeof(ISLAND_RESULT) <= ENTITY_OFFSET, "ISLAND_RESULT overlaps the entity");
+
+/**********************************************************//**
+ * @struct ISLAND_MAP
+ * @brief Describes the layout of the shared memory region:
+ * a stop flag, then every ring followed by its slots, then
+ * one result per island. Every part is cache line aligned.
+ **************************************************************/
+typedef struct {
+    const ISLAND_REQUEST *request;  ///< The island configuration.
+    char *base;             ///< Start of the shared region.
+    size_t size;            ///< Total size of the region.
+    int nChannels;          ///< The number of rings.
+    int capacity;           ///< Migrants each ring can hold.
+    size_t slotSize;        ///< Size of one migrant or result slot.
+    size_t ringSize;        ///< Size of a ring and its slots.
+} ISLAND_MAP;
+
+/**********************************************************//**
+ * @brief Rounds a size up to a whole number of cache lines.
+ * @param size: The size in bytes.
+ * @return The rounded size.
+ **************************************************************/
+static inline size_t Align(size_t size) {
+    return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+/**********************************************************//**
+ * @brief Gets the ring carrying migrants between two islands.
+ * @param request: The island configuration.
+ * @param from: The sending island.
+ * @param to: The receiving island.
+ * @return The ring index, or -1 if they are not connected.
+ **************************************************************/
+static int Channel(const ISLAND_REQUEST *request, int from, int to) {
+    int nIslands = request->nIslands;
+    if (from == to) {
+        return -1;
+    }
+    switch (request->topology) {
+    case TOPOLOGY_RING:
+        return (to == (from + 1) % nIslands)? from: -1;
+    case TOPOLOGY_FULL:
+        return from*(nIslands - 1) + ((to < from)? to: to - 1);
+    default:
+        return -1;
+    }
+}
+
+/**********************************************************//**
+ * @brief Gets the flag telling every island to stop.
+ * @param map: The shared memory layout.
+ * @return Pointer to the flag.
+ **************************************************************/
+static inline int *StopFlag(const ISLAND_MAP *map) {
+    return (int *)map->base;
+}
+
+/**********************************************************//**
+ * @brief Gets a ring header in shared memory.
+ * @param map: The shared memory layout.
+ * @param channel: The ring index.
+ * @return Pointer to the ring.
+ **************************************************************/
+static inline RING *Ring(const ISLAND_MAP *map, int channel) {
+    return (RING *)(map->base + CACHE_LINE + channel*map->ringSize);
+}
+
+/**********************************************************//**
+ * @brief Gets a migrant slot of a ring.
+ * @param map: The shared memory layout.
+ * @param channel: The ring index.
+ * @param count: The running migrant count, wrapped around.
+ * @return Pointer to the slot, which starts with the fitness.
+ **************************************************************/
+static inline char *Slot(const ISLAND_MAP *map, int channel, unsigned long count) {
+    char *slots = (char *)Ring(map, channel) + sizeof(RING);
+    return slots + (count % map->capacity)*map->slotSize;
+}
+
+/**********************************************************//**
+ * @brief Gets the result slot of an island.
+ * @param map: The shared memory layout.
+ * @param island: The island index.
+ * @return Pointer to the result, followed by the entity.
+ **************************************************************/
+static inline ISLAND_RESULT *Result(const ISLAND_MAP *map, int island) {
+    char *results = map->base + CACHE_LINE + map->nChannels*map->ringSize;
+    return (ISLAND_RESULT *)(results + island*map->slotSize);
+}
+
+/**********************************************************//**
+ * @brief Stores an entity in shared memory, encoding it if
+ * the islands have an encode function.
+ * @param request: The island configuration.
+ * @param where: Location to store the entity data.
+ * @param entity: The entity to store.
+ * @return The number of bytes stored.
+ **************************************************************/
+static uint32_t Put(const ISLAND_REQUEST *request, char *where, const void *entity) {
+    if (request->encode) {
+        return (uint32_t)request->encode(entity, (unsigned char *)where);
+    }
+    memcpy(where, entity, request->genetic.entitySize);
+    return (uint32_t)request->genetic.entitySize;
+}
+
+/**********************************************************//**
+ * @brief Rebuilds an entity stored by Put in this process.
+ * @param request: The island configuration.
+ * @param entity: Location to store the entity.
+ * @param where: The entity data.
+ * @param size: The number of bytes stored.
+ * @return Whether the data held a valid entity.
+ **************************************************************/
+static bool Get(const ISLAND_REQUEST *request, void *entity, const char *where, uint32_t size) {
+    if (request->decode) {
+        return request->decode(entity, (const unsigned char *)where, size);
+    }
+    memcpy(entity, where, request->genetic.entitySize);
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Sends a migrant without waiting for the receiver.
+ * @param map: The shared memory layout.
+ * @param channel: The ring to send along.
+ * @param entity: The migrant.
+ * @param fitness: The fitness of the migrant.
+ * @return Whether there was room in the ring.
+ **************************************************************/
+static bool Send(const ISLAND_MAP *map, int channel, const void *entity, float fitness) {
+    RING *ring = Ring(map, channel);
+    unsigned long tail = ring->tail;
+    unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - head >= (unsigned long)map->capacity) {
+        return false;
+    }
+
+    // Fill the slot before publishing it
+    char *slot = Slot(map, channel, tail);
+    uint32_t size = Put(map->request, slot + ENTITY_OFFSET, entity);
+    memcpy(slot, &fitness, sizeof(float));
+    memcpy(slot + SIZE_OFFSET, &size, sizeof(uint32_t));
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Exchanges migrants with the neighboring islands.
+ * @param map: The shared memory layout.
+ * @param data: The population of this island.
+ * @param island: The index of this island.
+ * @param migrant: Space to rebuild one arriving migrant in.
+ **************************************************************/
+static void Migrate(const ISLAND_MAP *map, GENETIC *data, int island, void *migrant) {
+    const ISLAND_REQUEST *request = map->request;
+
+    // Send our best survivors to everyone we are connected to
+    for (int to = 0; to < request->nIslands; to++) {
+        int channel = Channel(request, island, to);
+        if (channel < 0) {
+            continue;
+        }
+        for (int rank = 0; rank < request->nMigrants; rank++) {
+            float fitness;
+            const void *entity = genetic_Survivor(data, rank, &fitness);
+            if (!entity || !Send(map, channel, entity, fitness)) {
+                break;
+            }
+        }
+    }
+
+    // Take in whatever has arrived, replacing our worst newborn
+    int n = 0;
+    for (int from = 0; from < request->nIslands; from++) {
+        int channel = Channel(request, from, island);
+        if (channel < 0) {
+            continue;
+        }
+        RING *ring = Ring(map, channel);
+        unsigned long head = ring->head;
+        unsigned long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        for (; head < tail; head++) {
+            const char *slot = Slot(map, channel, head);
+            uint32_t size;
+            memcpy(&size, slot + SIZE_OFFSET, sizeof(uint32_t));
+            if (Get(request, migrant, slot + ENTITY_OFFSET, size) && genetic_Immigrate(data, migrant, n)) {
+                n++;
+            }
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+}
+
+/**********************************************************//**
+ * @brief Runs one island to completion. This is the whole
+ * life of an island process.
+ * @param map: The shared memory layout.
+ * @param island: The index of this island.
+ * @param fitness: The minimum desired fitness.
+ * @param timeout: The number of generations to run.
+ * @return Whether the island ran successfully.
+ **************************************************************/
+static bool RunIsland(const ISLAND_MAP *map, int island, float fitness, int timeout) {
+    const ISLAND_REQUEST *request = map->request;
+    ISLAND_RESULT *result = Result(map, island);
+
+    // Every island gets its own seed
+    GENETIC_REQUEST genetic = request->genetic;
+    genetic.seed += island;
+    GENETIC data;
+    if (!genetic_Create(&data, &genetic)) {
+        eprintf("Failed to initialize island %d.\n", island);
+        return false;
+    }
+    void *migrant = malloc(genetic.entitySize);
+    if (!migrant) {
+        eprintf("Failed to allocate migrant for island %d.\n", island);
+        genetic_Destroy(&data);
+        return false;
+    }
+
+    int *stop = StopFlag(map);
+    int generation = 0;
+    while (timeout == TIMEOUT_NONE || generation < timeout) {
+        genetic_Generation(&data);
+        generation++;
+        if (request->report) {
+            request->report(island, generation, genetic_BestFitness(&data));
+        }
+
+        // Termination check, shared between all islands
+        if (genetic_BestFitness(&data) <= fitness) {
+            __atomic_store_n(stop, 1, __ATOMIC_RELAXED);
+        }
+        if (__atomic_load_n(stop, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        // Periodic migration
+        if (request->nIslands > 1 && generation % request->interval == 0) {
+            Migrate(map, &data, island, migrant);
+        }
+    }
+
+    // Leave our best entity for the parent process
+    result->fitness = genetic_BestFitness(&data);
+    result->generations = generation;
+    result->size = Put(request, (char *)result + ENTITY_OFFSET, genetic_Best(&data));
+    result->success = true;
+    free(migrant);
+    genetic_Destroy(&data);
+    return true;
+}
+
+/*============================================================*
+ * Island model
+ *============================================================*/
+bool island_Run(const ISLAND_REQUEST *request, float fitness, int timeout, void *best, float *bestFitness) {
+    if (request->nIslands < 1 || request->interval < 1 || !request->encode != !request->decode) {
+        eprintf("Invalid island configuration.\n");
+        return false;
+    }
+
+    // Work out the shared memory layout
+    ISLAND_MAP map;
+    map.request = request;
+    map.nChannels = 0;
+    for (int from = 0; from < request->nIslands; from++) {
+        for (int to = 0; to < request->nIslands; to++) {
+            if (Channel(request, from, to) >= 0) {
+                map.nChannels++;
+            }
+        }
+    }
+    map.capacity = RING_DEPTH*request->nMigrants;
+    if (map.capacity < 1) {
+        map.capacity = 1;
+    }
+    map.slotSize = Align(ENTITY_OFFSET + (request->encode? request->wireSize: request->genetic.entitySize));
+    map.ringSize = sizeof(RING) + map.capacity*map.slotSize;
+    map.size = CACHE_LINE + map.nChannels*map.ringSize + request->nIslands*map.slotSize;
+
+    // Create the shared region. The name is removed right away:
+    // the mapping survives in every process that inherits it,
+    // and nothing is left behind if we crash.
+    char name[64];
+    snprintf(name, sizeof(name), "/creature-islands-%d", (int)getpid());
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        eprintf("Failed to create shared memory \"%s\".\n", name);
+        return false;
+    }
+    shm_unlink(name);
+    if (ftruncate(fd, map.size)) {
+        eprintf("Failed to size shared memory.\n");
+        close(fd);
+        return false;
+    }
+    map.base = mmap(NULL, map.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map.base == MAP_FAILED) {
+        eprintf("Failed to map shared memory.\n");
+        return false;
+    }
+
+    // Start all the islands. The region is zero-filled, so
+    // every ring is empty and no result is marked successful.
+    pid_t *children = malloc(sizeof(pid_t)*request->nIslands);
+    if (!children) {
+        eprintf("Failed to allocate island list.\n");
+        munmap(map.base, map.size);
+        return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    int nStarted = 0;
+    for (int island = 0; island < request->nIslands; island++) {
+        pid_t child = fork();
+        if (child == 0) {
+            bool success = RunIsland(&map, island, fitness, timeout);
+            fflush(stdout);
+            _exit(success? EXIT_SUCCESS: EXIT_FAILURE);
+        } else if (child < 0) {
+            eprintf("Failed to start island %d.\n", island);
+            __atomic_store_n(StopFlag(&map), 1, __ATOMIC_RELAXED);
+            break;
+        }
+        children[nStarted++] = child;
+    }
+
+    // Wait for everybody to finish
+    bool success = (nStarted == request->nIslands);
+    for (int i = 0; i < nStarted; i++) {
+        int status;
+        if (waitpid(children[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            eprintf("Island %d failed.\n", i);
+            success = false;
+        }
+    }
+    free(children);
+
+    // Find the best entity across all the islands
+    const ISLAND_RESULT *winner = NULL;
+    for (int island = 0; island < request->nIslands; island++) {
+        const ISLAND_RESULT *result = Result(&map, island);
+        if (result->success && (!winner || result->fitness < winner->fitness)) {
+            winner = result;
+        }
+    }
+    *bestFitness = winner? winner->fitness: INFINITY;
+    bool found = winner && Get(request, best, (const char *)winner + ENTITY_OFFSET, winner->size);
+    munmap(map.base, map.size);
+    return success && found;
+}
+
+#else
+/*============================================================*
+ * Island model stub
+ *============================================================*/
+bool island_Run(const ISLAND_REQUEST *request, float fitness, int timeout, void *best, float *bestFitness) {
+    (void)request;
+    (void)fitness;
+    (void)timeout;
+    (void)best;
+    (void)bestFitness;
+    eprintf("Island model requires fork and POSIX shared memory.\n");
+    return false;
+}
+#endif
+
+/*============================================================*/
@@ -0,0 +1,84 @@
+/**********************************************************//**
+ * @file island.h
+ * @brief Declaration of an island model running several
+ * genetic algorithm populations in separate processes.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _ISLAND_H_
+#define _ISLAND_H_
+
+// Standard library
+#include <stddef.h>         // size_t
+#include <stdbool.h>        // bool
+
+// This project
+#include "genetic.h"        // GENETIC_REQUEST
+#include "farm.h"           // ENCODE_FUNCTION, DECODE_FUNCTION
+
+/**********************************************************//**
+ * @enum TOPOLOGY
+ * @brief Lists which islands send migrants to which.
+ **************************************************************/
+typedef enum {
+    TOPOLOGY_RING,          ///< Island i sends to island i+1.
+    TOPOLOGY_FULL,          ///< Every island sends to every other.
+} TOPOLOGY;
+
+/**********************************************************//**
+ * @typedef ISLAND_REPORT
+ * @brief Called by an island process after every generation.
+ * @param island: The island index.
+ * @param generation: The number of generations run so far.
+ * @param fitness: The best fitness on the island.
+ **************************************************************/
+typedef void (*ISLAND_REPORT)(int island, int generation, float fitness);
+
+/**********************************************************//**
+ * @struct ISLAND_REQUEST
+ * @brief Stores all the information required to run the
+ * island model.
+ **************************************************************/
+typedef struct {
+    GENETIC_REQUEST genetic;    ///< Configuration of every island. Island k uses seed + k.
+    int nIslands;               ///< The number of island processes.
+    int interval;               ///< Generations between migrations.
+    int nMigrants;              ///< Survivors sent along each connection.
+    TOPOLOGY topology;          ///< Which islands are connected.
+    ISLAND_REPORT report;       ///< Progress callback, or NULL.
+    
+    // Entities that refer to storage private to their island
+    size_t wireSize;            ///< The largest encoded size of an entity.
+    ENCODE_FUNCTION encode;     ///< Serializes migrants and results, or NULL to copy them.
+    DECODE_FUNCTION decode;     ///< Deserializes migrants and results, or NULL to copy them.
+} ISLAND_REQUEST;
+
+/**********************************************************//**
+ * @brief Runs the island model. Each island is a forked
+ * process with a private GENETIC population, so its hot data
+ * is allocated on its own NUMA node and never shared. Every
+ * interval generations the best survivors are pushed through
+ * single-producer single-consumer rings in POSIX shared memory
+ * and replace the least fit newborn of the receiving island.
+ * Islands never wait for each other: a full ring drops the
+ * migrant. Migrants and results are copied byte for byte,
+ * unless encode and decode are given, in which case they are
+ * decoded in the receiving process and the fitness memoized
+ * in an entity may be lost on the way. This must be called
+ * before any threads are started.
+ * @param request: The island configuration.
+ * @param fitness: The minimum desired fitness. All islands stop
+ * once any island reaches it.
+ * @param timeout: The number of generations to run on each
+ * island, or TIMEOUT_NONE if infinite is desired.
+ * @param best: Location to store the best entity found, which
+ * must hold request->genetic.entitySize bytes.
+ * @param bestFitness: Location to store its fitness.
+ * @return Whether every island ran successfully.
+ **************************************************************/
+extern bool island_Run(const ISLAND_REQUEST *request, float fitness, int timeout, void *best, float *bestFitness);
+
+/*============================================================*/
+#endif // _ISLAND_H_
@@ -0,0 +1,462 @@
+/**********************************************************//**
+ * @file muscle.c
+ * @brief Implementation of the vectorized muscle force kernels
+ * and the runtime selection between them.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stddef.h>         // offsetof
+#include <math.h>           // sqrt
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MUSCLE_SIMD         ///< Whether the x86 kernels are compiled.
+#include <immintrin.h>      // __m128, __m256, __m512 ...
+#endif
+
+// External libraries
+#include <pthread.h>        // pthread_once
+
+// This project
+#include "vector.h"         // VECTOR
+#include "creature.h"       // NODE, MUSCLE
+#include "muscle.h"         // MUSCLE_FORCES
+
+//**************************************************************
+/// Index of a field when a structure is read as 32-bit words.
+#define WORD(type, field) (offsetof(type, field)/sizeof(float))
+
+// The gathers read structures as arrays of 32-bit words, and
+// read the contraction flag as the low byte of its word.
+__extension__ _Static_assert(sizeof(NODE) % sizeof(float) == 0, "NODE is not made of words");
+__extension__ _Static_assert(sizeof(MUSCLE) % sizeof(float) == 0, "MUSCLE is not made of words");
+__extension__ _Static_assert(offsetof(MUSCLE, isContracted) % sizeof(int) == 0, "MUSCLE flag is not aligned");
+
+/**********************************************************//**
+ * @typedef FORCE_KERNEL
+ * @brief Computes the force of every muscle, as described for
+ * muscle_Forces.
+ **************************************************************/
+typedef void (*FORCE_KERNEL)(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces);
+
+/*============================================================*
+ * Scalar kernel
+ *============================================================*/
+
+/**********************************************************//**
+ * @brief Computes the force of a range of muscles one at a
+ * time. This is the reference every other kernel must match,
+ * and also finishes the muscles left over by them.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param start: The first muscle to compute.
+ * @param count: One past the last muscle to compute.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+static void ScalarRange(const NODE *nodes, const MUSCLE *muscles, int start, int count, MUSCLE_FORCES *forces) {
+    for (int i = start; i < count; i++) {
+        const MUSCLE *muscle = &muscles[i];
+        const NODE *first = &nodes[muscle->first];
+        const NODE *second = &nodes[muscle->second];
+        
+        // Get the current muscle length and normalize the
+        // direction of the muscle.
+        VECTOR delta = second->position;
+        vector_Subtract(&delta, &first->position);
+        float length = vector_Length(&delta);
+        vector_Multiply(&delta, 1.0 / length);
+        
+        // Get the muscle force. The strength is per unit
+        // of target length, so divide that out too.
+        float targetLength = muscle->isContracted? muscle->contracted: muscle->extended;
+        float forceMagnitude = -(muscle->strength/targetLength)*(targetLength - length);
+        
+        // Get the velocity damping force. These velocities are along
+        // the vector connecting the masses, not in general.
+        float firstVelocity = vector_Dot(&delta, &first->velocity);
+        float secondVelocity = vector_Dot(&delta, &second->velocity);
+        forceMagnitude -= DAMPING*(firstVelocity-secondVelocity);
+        
+        // Scale the direction by the force magnitude
+        forces->x[i] = delta.x*forceMagnitude;
+        forces->y[i] = delta.y*forceMagnitude;
+        forces->z[i] = delta.z*forceMagnitude;
+        forces->magnitude[i] = forceMagnitude;
+    }
+}
+
+/**********************************************************//**
+ * @brief Computes the force of every muscle one at a time.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param count: The number of muscles.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+static void ForcesScalar(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces) {
+    ScalarRange(nodes, muscles, 0, count, forces);
+}
+
+#ifdef MUSCLE_SIMD
+/*============================================================*
+ * SSE2 kernel
+ *============================================================*/
+
+/// Loads a field of four nodes or muscles into one vector.
+#define GATHER4(p, field) _mm_setr_ps(p[0]->field, p[1]->field, p[2]->field, p[3]->field)
+
+/**********************************************************//**
+ * @brief Computes the force of four muscles at a time. SSE2
+ * has no gathers, so the nodes are loaded one lane at a time.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param count: The number of muscles.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+__attribute__((target("sse2")))
+static void ForcesSSE2(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128d damping = _mm_set1_pd(DAMPING);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const MUSCLE *m[4];
+        const NODE *a[4];
+        const NODE *b[4];
+        for (int k = 0; k < 4; k++) {
+            m[k] = &muscles[i + k];
+            a[k] = &nodes[m[k]->first];
+            b[k] = &nodes[m[k]->second];
+        }
+        
+        // Normalized muscle direction
+        __m128 dx = _mm_sub_ps(GATHER4(b, position.x), GATHER4(a, position.x));
+        __m128 dy = _mm_sub_ps(GATHER4(b, position.y), GATHER4(a, position.y));
+        __m128 dz = _mm_sub_ps(GATHER4(b, position.z), GATHER4(a, position.z));
+        __m128 square = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 length = _mm_sqrt_ps(square);
+        __m128 inverse = _mm_div_ps(one, length);
+        dx = _mm_mul_ps(dx, inverse);
+        dy = _mm_mul_ps(dy, inverse);
+        dz = _mm_mul_ps(dz, inverse);
+        
+        // Spring force per unit of target length
+        __m128 target = _mm_setr_ps(
+            m[0]->isContracted? m[0]->contracted: m[0]->extended,
+            m[1]->isContracted? m[1]->contracted: m[1]->extended,
+            m[2]->isContracted? m[2]->contracted: m[2]->extended,
+            m[3]->isContracted? m[3]->contracted: m[3]->extended);
+        __m128 stiffness = _mm_xor_ps(_mm_div_ps(GATHER4(m, strength), target), sign);
+        __m128 magnitude = _mm_mul_ps(stiffness, _mm_sub_ps(target, length));
+        
+        // Velocity damping along the muscle
+        __m128 firstVelocity = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(dx, GATHER4(a, velocity.x)),
+            _mm_mul_ps(dy, GATHER4(a, velocity.y))),
+            _mm_mul_ps(dz, GATHER4(a, velocity.z)));
+        __m128 secondVelocity = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(dx, GATHER4(b, velocity.x)),
+            _mm_mul_ps(dy, GATHER4(b, velocity.y))),
+            _mm_mul_ps(dz, GATHER4(b, velocity.z)));
+        __m128 relative = _mm_sub_ps(firstVelocity, secondVelocity);
+        
+        // DAMPING is a double, so the damping is subtracted in
+        // double precision before rounding, like the scalar code.
+        __m128d low = _mm_sub_pd(_mm_cvtps_pd(magnitude),
+            _mm_mul_pd(damping, _mm_cvtps_pd(relative)));
+        __m128d high = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(magnitude, magnitude)),
+            _mm_mul_pd(damping, _mm_cvtps_pd(_mm_movehl_ps(relative, relative))));
+        magnitude = _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+        
+        // Scale the direction by the force magnitude
+        _mm_storeu_ps(&forces->x[i], _mm_mul_ps(dx, magnitude));
+        _mm_storeu_ps(&forces->y[i], _mm_mul_ps(dy, magnitude));
+        _mm_storeu_ps(&forces->z[i], _mm_mul_ps(dz, magnitude));
+        _mm_storeu_ps(&forces->magnitude[i], magnitude);
+    }
+    ScalarRange(nodes, muscles, i, count, forces);
+}
+
+/*============================================================*
+ * AVX2 kernel
+ *============================================================*/
+
+/**********************************************************//**
+ * @brief Computes the force of eight muscles at a time,
+ * gathering the muscles and their nodes straight out of the
+ * creature. FMA is not enabled, since fusing would round
+ * differently from the scalar kernel.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param count: The number of muscles.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+__attribute__((target("avx2")))
+static void ForcesAVX2(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces) {
+    const float *node = (const float *)nodes;
+    const __m256i lanes = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+        _mm256_set1_epi32(sizeof(MUSCLE)/sizeof(float)));
+    const __m256i nodeWords = _mm256_set1_epi32(sizeof(NODE)/sizeof(float));
+    const __m256i flag = _mm256_set1_epi32(0xFF);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256d damping = _mm256_set1_pd(DAMPING);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Gather the muscles, and turn node indices into
+        // word offsets.
+        const float *muscle = (const float *)&muscles[i];
+        const int *words = (const int *)&muscles[i];
+        __m256i a = _mm256_mullo_epi32(_mm256_i32gather_epi32(words + WORD(MUSCLE, first), lanes, 4), nodeWords);
+        __m256i b = _mm256_mullo_epi32(_mm256_i32gather_epi32(words + WORD(MUSCLE, second), lanes, 4), nodeWords);
+        __m256i contracted = _mm256_and_si256(_mm256_i32gather_epi32(words + WORD(MUSCLE, isContracted), lanes, 4), flag);
+        
+        // Normalized muscle direction
+        __m256 dx = _mm256_sub_ps(
+            _mm256_i32gather_ps(node + WORD(NODE, position.x), b, 4),
+            _mm256_i32gather_ps(node + WORD(NODE, position.x), a, 4));
+        __m256 dy = _mm256_sub_ps(
+            _mm256_i32gather_ps(node + WORD(NODE, position.y), b, 4),
+            _mm256_i32gather_ps(node + WORD(NODE, position.y), a, 4));
+        __m256 dz = _mm256_sub_ps(
+            _mm256_i32gather_ps(node + WORD(NODE, position.z), b, 4),
+            _mm256_i32gather_ps(node + WORD(NODE, position.z), a, 4));
+        __m256 square = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        __m256 length = _mm256_sqrt_ps(square);
+        __m256 inverse = _mm256_div_ps(one, length);
+        dx = _mm256_mul_ps(dx, inverse);
+        dy = _mm256_mul_ps(dy, inverse);
+        dz = _mm256_mul_ps(dz, inverse);
+        
+        // Spring force per unit of target length
+        __m256 relaxed = _mm256_castsi256_ps(_mm256_cmpeq_epi32(contracted, _mm256_setzero_si256()));
+        __m256 target = _mm256_blendv_ps(
+            _mm256_i32gather_ps(muscle + WORD(MUSCLE, contracted), lanes, 4),
+            _mm256_i32gather_ps(muscle + WORD(MUSCLE, extended), lanes, 4), relaxed);
+        __m256 strength = _mm256_i32gather_ps(muscle + WORD(MUSCLE, strength), lanes, 4);
+        __m256 stiffness = _mm256_xor_ps(_mm256_div_ps(strength, target), sign);
+        __m256 magnitude = _mm256_mul_ps(stiffness, _mm256_sub_ps(target, length));
+        
+        // Velocity damping along the muscle
+        __m256 firstVelocity = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(dx, _mm256_i32gather_ps(node + WORD(NODE, velocity.x), a, 4)),
+            _mm256_mul_ps(dy, _mm256_i32gather_ps(node + WORD(NODE, velocity.y), a, 4))),
+            _mm256_mul_ps(dz, _mm256_i32gather_ps(node + WORD(NODE, velocity.z), a, 4)));
+        __m256 secondVelocity = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(dx, _mm256_i32gather_ps(node + WORD(NODE, velocity.x), b, 4)),
+            _mm256_mul_ps(dy, _mm256_i32gather_ps(node + WORD(NODE, velocity.y), b, 4))),
+            _mm256_mul_ps(dz, _mm256_i32gather_ps(node + WORD(NODE, velocity.z), b, 4)));
+        __m256 relative = _mm256_sub_ps(firstVelocity, secondVelocity);
+        
+        // Damping in double precision, like the scalar code
+        __m256d low = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(magnitude)),
+            _mm256_mul_pd(damping, _mm256_cvtps_pd(_mm256_castps256_ps128(relative))));
+        __m256d high = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(magnitude, 1)),
+            _mm256_mul_pd(damping, _mm256_cvtps_pd(_mm256_extractf128_ps(relative, 1))));
+        magnitude = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+        
+        // Scale the direction by the force magnitude
+        _mm256_storeu_ps(&forces->x[i], _mm256_mul_ps(dx, magnitude));
+        _mm256_storeu_ps(&forces->y[i], _mm256_mul_ps(dy, magnitude));
+        _mm256_storeu_ps(&forces->z[i], _mm256_mul_ps(dz, magnitude));
+        _mm256_storeu_ps(&forces->magnitude[i], magnitude);
+    }
+    ScalarRange(nodes, muscles, i, count, forces);
+}
+
+/*============================================================*
+ * AVX-512 kernel
+ *============================================================*/
+
+/**********************************************************//**
+ * @brief Computes the force of sixteen muscles at a time, the
+ * same way as the AVX2 kernel. Only AVX-512F instructions are
+ * used, so any AVX-512 CPU can run it. AVX-512F includes FMA,
+ * so this file must be built with -ffp-contract=off to keep
+ * the multiplies and adds apart.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param count: The number of muscles.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+__attribute__((target("avx512f")))
+static void ForcesAVX512(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces) {
+    const float *node = (const float *)nodes;
+    const __m512i lanes = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+        _mm512_set1_epi32(sizeof(MUSCLE)/sizeof(float)));
+    const __m512i nodeWords = _mm512_set1_epi32(sizeof(NODE)/sizeof(float));
+    const __m512i flag = _mm512_set1_epi32(0xFF);
+    const __m512i sign = _mm512_set1_epi32(0x80000000);
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512d damping = _mm512_set1_pd(DAMPING);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Gather the muscles, and turn node indices into
+        // word offsets.
+        const float *muscle = (const float *)&muscles[i];
+        const int *words = (const int *)&muscles[i];
+        __m512i a = _mm512_mullo_epi32(_mm512_i32gather_epi32(lanes, words + WORD(MUSCLE, first), 4), nodeWords);
+        __m512i b = _mm512_mullo_epi32(_mm512_i32gather_epi32(lanes, words + WORD(MUSCLE, second), 4), nodeWords);
+        __mmask16 contracted = _mm512_test_epi32_mask(_mm512_i32gather_epi32(lanes, words + WORD(MUSCLE, isContracted), 4), flag);
+        
+        // Normalized muscle direction
+        __m512 dx = _mm512_sub_ps(
+            _mm512_i32gather_ps(b, node + WORD(NODE, position.x), 4),
+            _mm512_i32gather_ps(a, node + WORD(NODE, position.x), 4));
+        __m512 dy = _mm512_sub_ps(
+            _mm512_i32gather_ps(b, node + WORD(NODE, position.y), 4),
+            _mm512_i32gather_ps(a, node + WORD(NODE, position.y), 4));
+        __m512 dz = _mm512_sub_ps(
+            _mm512_i32gather_ps(b, node + WORD(NODE, position.z), 4),
+            _mm512_i32gather_ps(a, node + WORD(NODE, position.z), 4));
+        __m512 square = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+        __m512 length = _mm512_sqrt_ps(square);
+        __m512 inverse = _mm512_div_ps(one, length);
+        dx = _mm512_mul_ps(dx, inverse);
+        dy = _mm512_mul_ps(dy, inverse);
+        dz = _mm512_mul_ps(dz, inverse);
+        
+        // Spring force per unit of target length. Floating
+        // point XOR needs AVX-512DQ, so flip the sign as integers.
+        __m512 target = _mm512_mask_blend_ps(contracted,
+            _mm512_i32gather_ps(lanes, muscle + WORD(MUSCLE, extended), 4),
+            _mm512_i32gather_ps(lanes, muscle + WORD(MUSCLE, contracted), 4));
+        __m512 strength = _mm512_i32gather_ps(lanes, muscle + WORD(MUSCLE, strength), 4);
+        __m512 stiffness = _mm512_castsi512_ps(_mm512_xor_si512(
+            _mm512_castps_si512(_mm512_div_ps(strength, target)), sign));
+        __m512 magnitude = _mm512_mul_ps(stiffness, _mm512_sub_ps(target, length));
+        
+        // Velocity damping along the muscle
+        __m512 firstVelocity = _mm512_add_ps(_mm512_add_ps(
+            _mm512_mul_ps(dx, _mm512_i32gather_ps(a, node + WORD(NODE, velocity.x), 4)),
+            _mm512_mul_ps(dy, _mm512_i32gather_ps(a, node + WORD(NODE, velocity.y), 4))),
+            _mm512_mul_ps(dz, _mm512_i32gather_ps(a, node + WORD(NODE, velocity.z), 4)));
+        __m512 secondVelocity = _mm512_add_ps(_mm512_add_ps(
+            _mm512_mul_ps(dx, _mm512_i32gather_ps(b, node + WORD(NODE, velocity.x), 4)),
+            _mm512_mul_ps(dy, _mm512_i32gather_ps(b, node + WORD(NODE, velocity.y), 4))),
+            _mm512_mul_ps(dz, _mm512_i32gather_ps(b, node + WORD(NODE, velocity.z), 4)));
+        __m512 relative = _mm512_sub_ps(firstVelocity, secondVelocity);
+        
+        // Damping in double precision, like the scalar code
+        __m256 magnitudeHigh = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(magnitude), 1));
+        __m256 relativeHigh = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(relative), 1));
+        __m512d low = _mm512_sub_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(magnitude)),
+            _mm512_mul_pd(damping, _mm512_cvtps_pd(_mm512_castps512_ps256(relative))));
+        __m512d high = _mm512_sub_pd(_mm512_cvtps_pd(magnitudeHigh),
+            _mm512_mul_pd(damping, _mm512_cvtps_pd(relativeHigh)));
+        magnitude = _mm512_castpd_ps(_mm512_insertf64x4(
+            _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(low))),
+            _mm256_castps_pd(_mm512_cvtpd_ps(high)), 1));
+        
+        // Scale the direction by the force magnitude
+        _mm512_storeu_ps(&forces->x[i], _mm512_mul_ps(dx, magnitude));
+        _mm512_storeu_ps(&forces->y[i], _mm512_mul_ps(dy, magnitude));
+        _mm512_storeu_ps(&forces->z[i], _mm512_mul_ps(dz, magnitude));
+        _mm512_storeu_ps(&forces->magnitude[i], magnitude);
+    }
+    ScalarRange(nodes, muscles, i, count, forces);
+}
+#endif
+
+/*============================================================*
+ * CPU detection
+ *============================================================*/
+
+/// Every kernel by instruction set, NULL if not compiled in.
+static const FORCE_KERNEL Kernels[N_KERNELS] = {
+    [KERNEL_SCALAR] = &ForcesScalar,
+#ifdef MUSCLE_SIMD
+    [KERNEL_SSE2] = &ForcesSSE2,
+    [KERNEL_AVX2] = &ForcesAVX2,
+    [KERNEL_AVX512] = &ForcesAVX512,
+#endif
+};
+
+/// Printable kernel names.
+static const char *const KernelNames[N_KERNELS] = {
+    [KERNEL_SCALAR] = "scalar",
+    [KERNEL_SSE2] = "sse2",
+    [KERNEL_AVX2] = "avx2",
+    [KERNEL_AVX512] = "avx512",
+};
+
+static pthread_once_t Detected = PTHREAD_ONCE_INIT;    ///< Guards the CPU detection.
+static MUSCLE_KERNEL Selected = KERNEL_SCALAR;          ///< The kernel in use.
+
+/**********************************************************//**
+ * @brief Selects the fastest kernel the CPU supports.
+ **************************************************************/
+static void Detect(void) {
+#ifdef MUSCLE_SIMD
+    __builtin_cpu_init();
+#endif
+    for (int kernel = N_KERNELS - 1; kernel >= 0; kernel--) {
+        if (muscle_Supported(kernel)) {
+            Selected = kernel;
+            break;
+        }
+    }
+}
+
+/*============================================================*
+ * Kernel support
+ *============================================================*/
+bool muscle_Supported(MUSCLE_KERNEL kernel) {
+    switch (kernel) {
+    case KERNEL_SCALAR:
+        return true;
+#ifdef MUSCLE_SIMD
+    case KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+/*============================================================*
+ * Kernel selection
+ *============================================================*/
+bool muscle_Select(MUSCLE_KERNEL kernel) {
+    pthread_once(&Detected, &Detect);
+    if (kernel < 0 || kernel >= N_KERNELS || !muscle_Supported(kernel)) {
+        return false;
+    }
+    Selected = kernel;
+    return true;
+}
+
+/*============================================================*
+ * Selected kernel
+ *============================================================*/
+MUSCLE_KERNEL muscle_Selected(void) {
+    pthread_once(&Detected, &Detect);
+    return Selected;
+}
+
+/*============================================================*
+ * Kernel names
+ *============================================================*/
+const char *muscle_KernelName(MUSCLE_KERNEL kernel) {
+    if (kernel < 0 || kernel >= N_KERNELS) {
+        return "unknown";
+    }
+    return KernelNames[kernel];
+}
+
+/*============================================================*
+ * Muscle forces
+ *============================================================*/
+void muscle_Forces(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces) {
+    pthread_once(&Detected, &Detect);
+    Kernels[Selected](nodes, muscles, count, forces);
+}
+
+/*============================================================*/
@@ -0,0 +1,90 @@
+/**********************************************************//**
+ * @file muscle.h
+ * @brief Declaration of the vectorized muscle force kernels
+ * and the runtime selection between them.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _MUSCLE_H_
+#define _MUSCLE_H_
+
+// Standard library
+#include <stdbool.h>        // bool
+
+// This project
+#include "creature.h"       // NODE, MUSCLE, MAX_MUSCLES
+
+/**********************************************************//**
+ * @enum MUSCLE_KERNEL
+ * @brief Instruction sets the muscle forces can be computed
+ * with, from slowest to fastest.
+ **************************************************************/
+typedef enum {
+    KERNEL_SCALAR,          ///< One muscle at a time, always available.
+    KERNEL_SSE2,            ///< Four muscles at a time.
+    KERNEL_AVX2,            ///< Eight muscles at a time with gathers.
+    KERNEL_AVX512,          ///< Sixteen muscles at a time with gathers.
+    N_KERNELS,              ///< Number of kernels.
+} MUSCLE_KERNEL;
+
+/**********************************************************//**
+ * @struct MUSCLE_FORCES
+ * @brief Stores the force every muscle of a creature exerts,
+ * one array per component so the kernels can store whole
+ * vectors. The first node of a muscle is pulled by the force
+ * and the second node by its opposite.
+ **************************************************************/
+typedef struct {
+    float x[MAX_MUSCLES] __attribute__((aligned(64)));  ///< X components.
+    float y[MAX_MUSCLES] __attribute__((aligned(64)));  ///< Y components.
+    float z[MAX_MUSCLES] __attribute__((aligned(64)));  ///< Z components.
+    float magnitude[MAX_MUSCLES] __attribute__((aligned(64)));  ///< Signed magnitudes.
+} MUSCLE_FORCES;
+
+/**********************************************************//**
+ * @brief Computes the spring and damping force of every
+ * muscle, including muscles without strength, using the
+ * selected kernel. Every kernel rounds exactly like the
+ * scalar one, so the results never depend on the CPU.
+ * @param nodes: The nodes the muscles connect.
+ * @param muscles: The muscles to compute.
+ * @param count: The number of muscles.
+ * @param forces: Location to store the forces.
+ **************************************************************/
+extern void muscle_Forces(const NODE *nodes, const MUSCLE *muscles, int count, MUSCLE_FORCES *forces);
+
+/**********************************************************//**
+ * @brief Checks whether this CPU can run a kernel.
+ * @param kernel: The kernel to check.
+ * @return Whether the kernel was compiled in and the CPU
+ * supports its instructions.
+ **************************************************************/
+extern bool muscle_Supported(MUSCLE_KERNEL kernel);
+
+/**********************************************************//**
+ * @brief Changes the kernel muscle_Forces uses. The fastest
+ * supported kernel is chosen automatically, so this is only
+ * needed to verify or time the others. Not thread safe; call
+ * it while no creatures are being simulated.
+ * @param kernel: The kernel to use.
+ * @return Whether the kernel is supported.
+ **************************************************************/
+extern bool muscle_Select(MUSCLE_KERNEL kernel);
+
+/**********************************************************//**
+ * @brief Gets the kernel muscle_Forces uses.
+ * @return The selected kernel.
+ **************************************************************/
+extern MUSCLE_KERNEL muscle_Selected(void);
+
+/**********************************************************//**
+ * @brief Gets a printable name of a kernel.
+ * @param kernel: The kernel to name.
+ * @return The name of the kernel.
+ **************************************************************/
+extern const char *muscle_KernelName(MUSCLE_KERNEL kernel);
+
+/*============================================================*/
+#endif // _MUSCLE_H_
@@ -0,0 +1,402 @@
+/**********************************************************//**
+ * @file pool.c
+ * @brief Implementation of a fixed-size worker thread pool.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdbool.h>        // bool
+#include <stdlib.h>         // malloc, qsort
+#include <time.h>           // clock_gettime
+
+// External libraries
+#ifdef WINDOWS
+#include <windows.h>        // GetSystemInfo
+#else
+#include <unistd.h>         // sysconf
+#endif
+#include <pthread.h>        // pthread_create
+
+// This project
+#include "debug.h"          // eprintf
+#include "pool.h"           // POOL
+
+/*============================================================*
+ * Processor count
+ *============================================================*/
+int pool_Processors(void) {
+#ifdef WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0)? count: 1;
+}
+
+/**********************************************************//**
+ * @struct POOL_ITEM
+ * @brief Item of a weighted job while it is being dealt out.
+ **************************************************************/
+typedef struct POOL_ITEM {
+    float cost;             ///< The estimated cost of the item.
+    int index;              ///< The item index.
+    int owner;              ///< The worker the item is dealt to.
+} POOL_ITEM;
+
+/**********************************************************//**
+ * @brief Gets the current time for profiling.
+ * @return Monotonic time in seconds.
+ **************************************************************/
+static inline double Now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+/**********************************************************//**
+ * @brief Sorting function placing expensive items first.
+ * Ties keep index order so the deal is deterministic.
+ * @param a: The first POOL_ITEM.
+ * @param b: The second POOL_ITEM.
+ * @return The comparison result.
+ **************************************************************/
+static int CompareCost(const void *a, const void *b) {
+    const POOL_ITEM *first = (const POOL_ITEM *)a;
+    const POOL_ITEM *second = (const POOL_ITEM *)b;
+    if (first->cost != second->cost) {
+        return (first->cost > second->cost)? -1: 1;
+    }
+    return first->index - second->index;
+}
+
+/**********************************************************//**
+ * @brief Takes the most expensive item from our own queue.
+ * @param worker: The calling worker.
+ * @param index: Location to store the item index.
+ * @return Whether an item was available.
+ **************************************************************/
+static inline bool Take(POOL_WORKER *worker, int *index) {
+    bool found = false;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->head < worker->tail) {
+        *index = worker->pool->items[worker->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+/**********************************************************//**
+ * @brief Takes the cheapest item from another worker's queue.
+ * Items are never added during a job, so once every queue
+ * has been seen empty the job has no work left to claim.
+ * @param worker: The calling worker.
+ * @param index: Location to store the item index.
+ * @return Whether an item was available.
+ **************************************************************/
+static bool Steal(POOL_WORKER *worker, int *index) {
+    POOL *pool = worker->pool;
+    for (int i = 1; i < pool->nThreads; i++) {
+        POOL_WORKER *victim = &pool->workers[(worker->id + i) % pool->nThreads];
+        bool found = false;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            *index = pool->items[--victim->tail];
+            found = true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**********************************************************//**
+ * @brief Runs items of the current job until none are left
+ * to claim anywhere.
+ * @param worker: The calling worker.
+ **************************************************************/
+static void Drain(POOL_WORKER *worker) {
+    POOL *pool = worker->pool;
+    while (true) {
+        int index;
+        if (!Take(worker, &index)) {
+            if (!Steal(worker, &index)) {
+                break;
+            }
+            worker->stats.steals++;
+        }
+        
+        // Run the item and time it
+        double start = Now();
+        pool->task(pool->context, index, worker->id);
+        worker->spent += Now() - start;
+        worker->stats.tasks++;
+    }
+}
+
+/**********************************************************//**
+ * @brief Main loop of every worker thread other than 0.
+ * @param argument: The POOL_WORKER for this thread.
+ * @return Always NULL.
+ **************************************************************/
+static void *Worker(void *argument) {
+    POOL_WORKER *self = (POOL_WORKER *)argument;
+    POOL *pool = self->pool;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        // Sleep until there is a new job or we must exit.
+        while (!pool->quit && pool->round == seen) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        seen = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+
+        // Do our share of the job
+        Drain(self);
+
+        // The last worker out wakes up the caller.
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*============================================================*
+ * Creation function
+ *============================================================*/
+bool pool_Create(POOL *pool, int nThreads) {
+    pool->nThreads = (nThreads > 1)? nThreads: 1;
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->items = NULL;
+    pool->order = NULL;
+    pool->capacity = 0;
+    pool->round = 0;
+    pool->active = 0;
+    pool->quit = false;
+
+    // Allocate the worker queues
+    pool->workers = malloc(sizeof(POOL_WORKER)*pool->nThreads);
+    if (!pool->workers) {
+        eprintf("Failed to allocate pool workers.\n");
+        return false;
+    }
+    for (int i = 0; i < pool->nThreads; i++) {
+        POOL_WORKER *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->id = i;
+        worker->head = 0;
+        worker->tail = 0;
+        pthread_mutex_init(&worker->lock, NULL);
+    }
+    pool_ResetStatistics(pool);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // Start up the threads. Worker 0 is the caller.
+    for (int i = 1; i < pool->nThreads; i++) {
+        POOL_WORKER *worker = &pool->workers[i];
+        if (pthread_create(&worker->thread, NULL, &Worker, worker)) {
+            eprintf("Failed to start pool thread %d.\n", i);
+
+            // Shut down the ones that did start
+            for (int j = i; j < pool->nThreads; j++) {
+                pthread_mutex_destroy(&pool->workers[j].lock);
+            }
+            pool->nThreads = i;
+            pool_Destroy(pool);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Makes sure the item buffers can hold a job.
+ * @param pool: The worker pool.
+ * @param count: The number of items in the job.
+ * @return Whether the buffers are large enough.
+ **************************************************************/
+static bool Reserve(POOL *pool, int count) {
+    if (count <= pool->capacity) {
+        return true;
+    }
+    int *items = realloc(pool->items, sizeof(int)*count);
+    if (!items) {
+        return false;
+    }
+    pool->items = items;
+    POOL_ITEM *order = realloc(pool->order, sizeof(POOL_ITEM)*count);
+    if (!order) {
+        return false;
+    }
+    pool->order = order;
+    pool->capacity = count;
+    return true;
+}
+
+/**********************************************************//**
+ * @brief Deals the items of a job out to the worker queues.
+ * Without costs every worker gets a contiguous block. With
+ * costs, items go longest-first to the least loaded worker,
+ * which bounds the imbalance before any stealing happens.
+ * @param pool: The worker pool.
+ * @param count: The number of items in the job.
+ * @param cost: The estimated cost of each item, or NULL.
+ **************************************************************/
+static void Deal(POOL *pool, int count, const float *cost) {
+    int nThreads = pool->nThreads;
+    if (!cost) {
+        for (int i = 0; i < count; i++) {
+            pool->items[i] = i;
+        }
+        for (int w = 0; w < nThreads; w++) {
+            POOL_WORKER *worker = &pool->workers[w];
+            worker->head = (int)((long)count*w/nThreads);
+            worker->tail = (int)((long)count*(w+1)/nThreads);
+            worker->load = worker->tail - worker->head;
+        }
+        return;
+    }
+
+    // Sort the items by decreasing cost
+    POOL_ITEM *order = pool->order;
+    for (int i = 0; i < count; i++) {
+        order[i].cost = cost[i];
+        order[i].index = i;
+    }
+    qsort(order, count, sizeof(POOL_ITEM), &CompareCost);
+
+    // Greedily hand each item to the least loaded worker
+    for (int w = 0; w < nThreads; w++) {
+        pool->workers[w].load = 0.0;
+        pool->workers[w].head = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        int lightest = 0;
+        for (int w = 1; w < nThreads; w++) {
+            if (pool->workers[w].load < pool->workers[lightest].load) {
+                lightest = w;
+            }
+        }
+        order[i].owner = lightest;
+        pool->workers[lightest].load += order[i].cost;
+        pool->workers[lightest].head++;
+    }
+
+    // Lay the queues out contiguously, each still sorted from
+    // most to least expensive.
+    int offset = 0;
+    for (int w = 0; w < nThreads; w++) {
+        POOL_WORKER *worker = &pool->workers[w];
+        int size = worker->head;
+        worker->head = offset;
+        worker->tail = offset;
+        offset += size;
+    }
+    for (int i = 0; i < count; i++) {
+        POOL_WORKER *worker = &pool->workers[order[i].owner];
+        pool->items[worker->tail++] = order[i].index;
+    }
+}
+
+/*============================================================*
+ * Parallel loop
+ *============================================================*/
+void pool_RunWeighted(POOL *pool, int count, POOL_TASK task, void *context, const float *cost) {
+    // Without room for the queues, just do it all ourselves.
+    if (!Reserve(pool, count)) {
+        eprintf("Failed to allocate pool items, running serially.\n");
+        for (int i = 0; i < count; i++) {
+            task(context, i, 0);
+        }
+        return;
+    }
+    
+    // Set up the job
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    Deal(pool, count, cost);
+    for (int w = 0; w < pool->nThreads; w++) {
+        pool->workers[w].spent = 0.0;
+    }
+    double start = Now();
+    pool->active = pool->nThreads - 1;
+    pool->round++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    // The caller helps out as worker 0
+    Drain(&pool->workers[0]);
+
+    // Wait for everyone else to finish
+    pthread_mutex_lock(&pool->lock);
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    // Anyone not running a task was waiting on someone else.
+    double elapsed = Now() - start;
+    for (int w = 0; w < pool->nThreads; w++) {
+        POOL_WORKER *worker = &pool->workers[w];
+        worker->stats.busy += worker->spent;
+        worker->stats.idle += elapsed - worker->spent;
+    }
+}
+
+/*============================================================*
+ * Timing reset
+ *============================================================*/
+void pool_ResetStatistics(POOL *pool) {
+    for (int w = 0; w < pool->nThreads; w++) {
+        POOL_STATISTICS *stats = &pool->workers[w].stats;
+        stats->busy = 0.0;
+        stats->idle = 0.0;
+        stats->tasks = 0;
+        stats->steals = 0;
+    }
+}
+
+/*============================================================*
+ * Destruction function
+ *============================================================*/
+void pool_Destroy(POOL *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->nThreads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < pool->nThreads; i++) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool->items);
+    free(pool->order);
+}
+
+/*============================================================*/
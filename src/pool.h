@@ -0,0 +1,162 @@
+/**********************************************************//**
+ * @file pool.h
+ * @brief Declaration of a fixed-size worker thread pool.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+// Standard library
+#include <stdbool.h>        // bool
+
+// External libraries
+#include <pthread.h>        // pthread_t, pthread_mutex_t
+
+/**********************************************************//**
+ * @typedef POOL_TASK
+ * @brief Runs one item of a parallel loop.
+ * @param context: User data shared by every item.
+ * @param index: The item to run, from 0 to the count - 1.
+ * @param worker: The worker running the item, from 0 to the
+ * number of threads - 1. Useful for per-worker scratch data.
+ **************************************************************/
+typedef void (*POOL_TASK)(void *context, int index, int worker);
+
+//**************************************************************
+/// Size of a cache line, used to keep workers from sharing one.
+#define CACHE_LINE 64
+
+/**********************************************************//**
+ * @struct POOL_STATISTICS
+ * @brief Accumulated timing data for one worker.
+ **************************************************************/
+typedef struct {
+    double busy;            ///< Seconds spent running tasks.
+    double idle;            ///< Seconds spent waiting for other workers.
+    long tasks;             ///< Number of items run.
+    long steals;            ///< Number of items taken from other workers.
+} POOL_STATISTICS;
+
+struct POOL;
+struct POOL_ITEM;
+
+/**********************************************************//**
+ * @struct POOL_WORKER
+ * @brief Stores one worker and its queue of items. The queue
+ * is the range [head, tail) of the pool's item array, sorted
+ * from most to least expensive. The owner takes from the head
+ * and thieves take from the tail.
+ **************************************************************/
+typedef struct {
+    struct POOL *pool;      ///< The pool this worker belongs to.
+    int id;                 ///< The worker index.
+    pthread_t thread;       ///< The thread running the worker.
+
+    // Queue
+    pthread_mutex_t lock;   ///< Guards the queue bounds.
+    int head;               ///< The next item the owner runs.
+    int tail;               ///< One past the next item a thief runs.
+    double load;            ///< Estimated cost assigned this job.
+    double spent;           ///< Seconds spent running tasks this job.
+
+    // Timing
+    POOL_STATISTICS stats;  ///< Accumulated timing data.
+    char padding[CACHE_LINE];   ///< Keeps queues on separate lines.
+} POOL_WORKER;
+
+/**********************************************************//**
+ * @struct POOL
+ * @brief Stores a set of threads that cooperatively run a
+ * parallel loop. The calling thread always acts as worker 0,
+ * so a pool with one thread runs everything serially.
+ **************************************************************/
+typedef struct POOL {
+    // Workers
+    int nThreads;           ///< Total number of workers.
+    POOL_WORKER *workers;   ///< Data for every worker.
+
+    // Current job
+    POOL_TASK task;         ///< The task being run.
+    void *context;          ///< The task user data.
+    int *items;             ///< Item indices, partitioned into queues.
+    struct POOL_ITEM *order;    ///< Scratch space to sort items by cost.
+    int capacity;           ///< The allocated size of the items array.
+
+    // Synchronization
+    pthread_mutex_t lock;   ///< Guards everything below.
+    pthread_cond_t wake;    ///< Signals a new job to workers.
+    pthread_cond_t done;    ///< Signals the job is finished.
+    unsigned round;         ///< Incremented for every new job.
+    int active;             ///< Workers still running the job.
+    bool quit;              ///< Whether the workers should exit.
+} POOL;
+
+/**********************************************************//**
+ * @brief Gets the number of processors on this machine.
+ * @return The number of online processors, at least 1.
+ **************************************************************/
+extern int pool_Processors(void);
+
+/**********************************************************//**
+ * @brief Starts up a pool of worker threads.
+ * @param pool: Storage location for the pool data.
+ * @param nThreads: The total number of workers, including the
+ * calling thread. Values below 1 are treated as 1.
+ * @return Whether the creation suceeded.
+ **************************************************************/
+extern bool pool_Create(POOL *pool, int nThreads);
+
+/**********************************************************//**
+ * @brief Runs the task for every index from 0 to count - 1
+ * and waits for all of them to finish. Items are dealt out
+ * longest-first to balance the estimated cost per worker, and
+ * idle workers steal from the others, so the order of
+ * execution is unspecified.
+ * @param pool: The worker pool.
+ * @param count: The number of items to run.
+ * @param task: The function run for each item.
+ * @param context: User data passed to every item.
+ * @param cost: The estimated relative cost of each item, or
+ * NULL if all items cost about the same.
+ **************************************************************/
+extern void pool_RunWeighted(POOL *pool, int count, POOL_TASK task, void *context, const float *cost);
+
+/**********************************************************//**
+ * @brief Runs the task for every index from 0 to count - 1
+ * and waits for all of them to finish.
+ * @param pool: The worker pool.
+ * @param count: The number of items to run.
+ * @param task: The function run for each item.
+ * @param context: User data passed to every item.
+ **************************************************************/
+static inline void pool_Run(POOL *pool, int count, POOL_TASK task, void *context) {
+    pool_RunWeighted(pool, count, task, context, NULL);
+}
+
+/**********************************************************//**
+ * @brief Gets the accumulated timing data of a worker.
+ * @param pool: The worker pool.
+ * @param worker: The worker, from 0 to nThreads - 1.
+ * @return Pointer to the timing data.
+ **************************************************************/
+static inline const POOL_STATISTICS *pool_Statistics(const POOL *pool, int worker) {
+    return &pool->workers[worker].stats;
+}
+
+/**********************************************************//**
+ * @brief Clears the accumulated timing data of every worker.
+ * @param pool: The worker pool.
+ **************************************************************/
+extern void pool_ResetStatistics(POOL *pool);
+
+/**********************************************************//**
+ * @brief Stops all the workers and destroys the pool.
+ * @param pool: The pool to get rid of.
+ **************************************************************/
+extern void pool_Destroy(POOL *pool);
+
+/*============================================================*/
+#endif // _POOL_H_
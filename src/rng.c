@@ -0,0 +1,42 @@
+/**********************************************************//**
+ * @file rng.c
+ * @brief Implementation of a small, fast random number
+ * generator with explicit state.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+// Standard library
+#include <stdint.h>         // uint64_t
+
+// This project
+#include "rng.h"            // RNG
+
+//**************************************************************
+/// Odd constant used to step the SplitMix64 sequence.
+#define GOLDEN_GAMMA 0x9E3779B97F4A7C15ull
+
+/*============================================================*
+ * Seeding
+ *============================================================*/
+void rng_Seed(RNG *rng, uint64_t seed) {
+    // Fill the state from a SplitMix64 sequence, which can
+    // never produce four zero words in a row.
+    for (int i = 0; i < 4; i++) {
+        seed += GOLDEN_GAMMA;
+        rng->state[i] = rng_Mix(seed);
+    }
+}
+
+/*============================================================*
+ * Stream derivation
+ *============================================================*/
+void rng_Derive(RNG *rng, uint64_t seed, uint64_t generation, uint64_t index) {
+    uint64_t key = rng_Mix(seed + GOLDEN_GAMMA);
+    key = rng_Mix(key ^ (generation + GOLDEN_GAMMA));
+    key = rng_Mix(key ^ (index + GOLDEN_GAMMA));
+    rng_Seed(rng, key);
+}
+
+/*============================================================*/
@@ -0,0 +1,109 @@
+/**********************************************************//**
+ * @file rng.h
+ * @brief Declaration of a small, fast random number generator
+ * with explicit state so it can be used from many threads.
+ * @version 1.0
+ * @author Rena Shinomiya
+ * @date April 2017
+ **************************************************************/
+
+#ifndef _RNG_H_
+#define _RNG_H_
+
+// Standard library
+#include <stdint.h>         // uint64_t
+
+/**********************************************************//**
+ * @struct RNG
+ * @brief Stores the state of one xoshiro256** random stream.
+ **************************************************************/
+typedef struct {
+    uint64_t state[4];      ///< The generator state, never all zero.
+} RNG;
+
+/**********************************************************//**
+ * @brief Seeds a random stream.
+ * @param rng: The stream to initialize.
+ * @param seed: Any seed value.
+ **************************************************************/
+extern void rng_Seed(RNG *rng, uint64_t seed);
+
+/**********************************************************//**
+ * @brief Seeds a random stream from a (seed, generation,
+ * index) triple. Distinct triples give independent streams,
+ * so an individual's stream does not depend on which thread
+ * happens to create it.
+ * @param rng: The stream to initialize.
+ * @param seed: The seed of the whole run.
+ * @param generation: The generation being created.
+ * @param index: The individual within the generation.
+ **************************************************************/
+extern void rng_Derive(RNG *rng, uint64_t seed, uint64_t generation, uint64_t index);
+
+/**********************************************************//**
+ * @brief Scrambles a 64-bit word using the SplitMix64
+ * finalizer, so nearby inputs give unrelated outputs.
+ * @param x: The word to scramble.
+ * @return The scrambled word.
+ **************************************************************/
+static inline uint64_t rng_Mix(uint64_t x) {
+    x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27))*0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**********************************************************//**
+ * @brief Rotates the bits of a 64-bit word left.
+ * @param x: The word to rotate.
+ * @param k: The number of bits, from 1 to 63.
+ * @return The rotated word.
+ **************************************************************/
+static inline uint64_t rng_Rotate(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/**********************************************************//**
+ * @brief Generates the next 64 random bits.
+ * @param rng: The random stream.
+ * @return Uniformly distributed random bits.
+ **************************************************************/
+static inline uint64_t rng_Next(RNG *rng) {
+    uint64_t *s = rng->state;
+    uint64_t result = rng_Rotate(s[1]*5, 7)*9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_Rotate(s[3], 45);
+    return result;
+}
+
+/**********************************************************//**
+ * @brief Generates a random integer in the given range.
+ * @param rng: The random stream.
+ * @param min: The minimum value.
+ * @param max: The maximum value. Must be at least min.
+ * @return A random integer from min to max inclusive.
+ **************************************************************/
+static inline int rng_Randint(RNG *rng, int min, int max) {
+    uint64_t range = (uint64_t)(max - min) + 1;
+    uint64_t bits = rng_Next(rng) >> 32;
+    return min + (int)((bits*range) >> 32);
+}
+
+/**********************************************************//**
+ * @brief Generates a random real number in the given range.
+ * @param rng: The random stream.
+ * @param min: The minimum value.
+ * @param max: The maximum value.
+ * @return A random number from min up to but excluding max.
+ **************************************************************/
+static inline float rng_Uniform(RNG *rng, float min, float max) {
+    float unit = (rng_Next(rng) >> 40) * (1.0f/16777216.0f);
+    return min + (max - min)*unit;
+}
+
+/*============================================================*/
+#endif // _RNG_H_